@@ -0,0 +1,350 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Ordered price -> value index with wide nodes of sorted integer keys. Leaves
+// hold 16 entries and are linked for depth walks, so a walk touches one node
+// per 16 levels instead of one per level as std::map does. It implements the
+// subset of the std::map interface OrderBook::Impl uses, so it can stand in
+// for the level maps (ORDER_BOOK_BTREE_LEVELS).
+//
+// Keys are the IEEE-754 bit patterns of the (positive) prices, which sort like
+// the prices themselves; Descending negates them. Erase removes empty leaves
+// but never merges underfull nodes, which keeps it simple and leaves the
+// height bounded by the peak size.
+template<typename V, bool Descending = false>
+class BPlusTree {
+public:
+    static constexpr int NODE_SIZE = 16;
+    using value_type = std::pair<double, V>;
+
+private:
+    static constexpr int64_t KEY_PAD = std::numeric_limits<int64_t>::max();
+
+    struct Node {
+        bool is_leaf;
+        int count{0};                  // entries in a leaf, separator keys in an inner node
+        alignas(64) int64_t keys[NODE_SIZE];
+
+        explicit Node(bool leaf) : is_leaf(leaf) {
+            for (auto& k : keys) {
+                k = KEY_PAD;
+            }
+        }
+    };
+
+    struct Leaf : Node {
+        value_type items[NODE_SIZE];
+        Leaf* prev{nullptr};
+        Leaf* next{nullptr};
+
+        Leaf() : Node(true) {}
+    };
+
+    // children[i] holds keys in [keys[i-1], keys[i]); count + 1 children
+    struct Inner : Node {
+        Node* children[NODE_SIZE + 1];
+
+        Inner() : Node(false) {}
+    };
+
+public:
+    class iterator {
+    public:
+        iterator() = default;
+        iterator(Leaf* leaf, int index) : leaf_(leaf), index_(index) {}
+
+        value_type& operator*() const { return leaf_->items[index_]; }
+        value_type* operator->() const { return &leaf_->items[index_]; }
+
+        iterator& operator++() {
+            if (++index_ == leaf_->count) {
+                leaf_ = leaf_->next; // leaves other than the root are never empty
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return leaf_ == other.leaf_ && index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BPlusTree;
+        Leaf* leaf_{nullptr};
+        int index_{0};
+    };
+
+    BPlusTree() : root_(new Leaf()) { head_ = static_cast<Leaf*>(root_); }
+    ~BPlusTree() { destroy(root_); }
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    iterator begin() const { return size_ ? iterator(head_, 0) : end(); }
+    iterator end() const { return iterator(); }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    iterator find(double price) const {
+        int64_t key = to_key(price);
+        Leaf* leaf = descend(key, nullptr, nullptr);
+        int pos = count_less(leaf->keys, key);
+        return pos < leaf->count && leaf->keys[pos] == key ? iterator(leaf, pos) : end();
+    }
+
+    V& operator[](double price) {
+        int64_t key = to_key(price);
+        Inner* path[MAX_HEIGHT];
+        int depth = 0;
+        Leaf* leaf = descend(key, path, &depth);
+        int pos = count_less(leaf->keys, key);
+        if (pos < leaf->count && leaf->keys[pos] == key) {
+            return leaf->items[pos].second;
+        }
+
+        if (leaf->count == NODE_SIZE) {
+            Leaf* right = split_leaf(leaf, path, depth);
+            if (pos > leaf->count) {
+                pos -= leaf->count;
+                leaf = right;
+            }
+        }
+        shift_right(leaf->keys, pos, leaf->count);
+        shift_right(leaf->items, pos, leaf->count);
+        leaf->keys[pos] = key;
+        leaf->items[pos] = value_type(price, V());
+        leaf->count++;
+        size_++;
+        return leaf->items[pos].second;
+    }
+
+    void erase(iterator it) {
+        Leaf* leaf = it.leaf_;
+        int64_t key = leaf->keys[it.index_];
+        shift_left(leaf->keys, it.index_, leaf->count);
+        shift_left(leaf->items, it.index_, leaf->count);
+        leaf->count--;
+        leaf->keys[leaf->count] = KEY_PAD;
+        size_--;
+
+        if (leaf->count > 0 || leaf == root_) {
+            return;
+        }
+
+        // Unlink the empty leaf and drop it from its ancestors
+        Inner* path[MAX_HEIGHT];
+        int slots[MAX_HEIGHT];
+        int depth = 0;
+        Node* node = root_;
+        while (!node->is_leaf) {
+            Inner* inner = static_cast<Inner*>(node);
+            int slot = count_less(inner->keys, key + 1);
+            path[depth] = inner;
+            slots[depth++] = slot;
+            node = inner->children[slot];
+        }
+        (leaf->prev ? leaf->prev->next : head_) = leaf->next;
+        if (leaf->next) {
+            leaf->next->prev = leaf->prev;
+        }
+        delete leaf;
+        remove_child(path, slots, depth);
+    }
+
+    void clear() {
+        destroy(root_);
+        root_ = new Leaf();
+        head_ = static_cast<Leaf*>(root_);
+        size_ = 0;
+    }
+
+    // Number of keys below `key` in a padded node; unused slots hold KEY_PAD
+    // so the whole node is compared without a length check
+    static int count_less(const int64_t* keys, int64_t key) {
+#if defined(__AVX2__)
+        __m256i target = _mm256_set1_epi64x(key);
+        int count = 0;
+        for (int i = 0; i < NODE_SIZE; i += 4) {
+            __m256i k = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i));
+            count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, k))));
+        }
+        return count;
+#else
+        int count = 0;
+        for (int i = 0; i < NODE_SIZE; ++i) {
+            count += keys[i] < key;
+        }
+        return count;
+#endif
+    }
+
+private:
+    static constexpr int MAX_HEIGHT = 32;
+
+    static int64_t to_key(double price) {
+        int64_t bits;
+        std::memcpy(&bits, &price, sizeof(bits));
+        return Descending ? -bits : bits;
+    }
+
+    template<typename T>
+    static void shift_right(T* items, int from, int count) {
+        for (int i = count; i > from; --i) {
+            items[i] = items[i - 1];
+        }
+    }
+
+    template<typename T>
+    static void shift_left(T* items, int from, int count) {
+        for (int i = from; i + 1 < count; ++i) {
+            items[i] = items[i + 1];
+        }
+    }
+
+    // Walk to the leaf that holds or would hold `key`, optionally recording
+    // the inner nodes passed on the way
+    Leaf* descend(int64_t key, Inner** path, int* depth) const {
+        Node* node = root_;
+        while (!node->is_leaf) {
+            Inner* inner = static_cast<Inner*>(node);
+            if (path) {
+                path[(*depth)++] = inner;
+            }
+            node = inner->children[count_less(inner->keys, key + 1)];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    Leaf* split_leaf(Leaf* leaf, Inner** path, int depth) {
+        Leaf* right = new Leaf();
+        int keep = NODE_SIZE / 2;
+        for (int i = keep; i < NODE_SIZE; ++i) {
+            right->keys[i - keep] = leaf->keys[i];
+            right->items[i - keep] = leaf->items[i];
+            leaf->keys[i] = KEY_PAD;
+        }
+        right->count = NODE_SIZE - keep;
+        leaf->count = keep;
+
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next) {
+            leaf->next->prev = right;
+        }
+        leaf->next = right;
+
+        insert_separator(right->keys[0], leaf, right, path, depth);
+        return right;
+    }
+
+    // Add `right` after `left` under the deepest inner node of the path,
+    // splitting upwards as needed
+    void insert_separator(int64_t key, Node* left, Node* right, Inner** path, int depth) {
+        while (true) {
+            if (depth == 0) {
+                Inner* root = new Inner();
+                root->keys[0] = key;
+                root->children[0] = left;
+                root->children[1] = right;
+                root->count = 1;
+                root_ = root;
+                return;
+            }
+
+            Inner* parent = path[--depth];
+            int slot = count_less(parent->keys, key);
+            if (parent->count < NODE_SIZE) {
+                shift_right(parent->keys, slot, parent->count);
+                shift_right(parent->children, slot + 1, parent->count + 1);
+                parent->keys[slot] = key;
+                parent->children[slot + 1] = right;
+                parent->count++;
+                return;
+            }
+
+            // Split a full inner node around its middle separator
+            int64_t keys[NODE_SIZE + 1];
+            Node* children[NODE_SIZE + 2];
+            for (int i = 0, j = 0; i <= NODE_SIZE; ++i) {
+                keys[i] = i == slot ? key : parent->keys[j++];
+            }
+            for (int i = 0, j = 0; i <= NODE_SIZE + 1; ++i) {
+                children[i] = i == slot + 1 ? right : parent->children[j++];
+            }
+
+            int mid = (NODE_SIZE + 1) / 2;
+            Inner* sibling = new Inner();
+            for (int i = 0; i < NODE_SIZE; ++i) {
+                parent->keys[i] = KEY_PAD;
+            }
+            for (int i = 0; i < mid; ++i) {
+                parent->keys[i] = keys[i];
+                parent->children[i] = children[i];
+            }
+            parent->children[mid] = children[mid];
+            parent->count = mid;
+            for (int i = mid + 1; i <= NODE_SIZE; ++i) {
+                sibling->keys[i - mid - 1] = keys[i];
+                sibling->children[i - mid - 1] = children[i];
+            }
+            sibling->children[NODE_SIZE - mid] = children[NODE_SIZE + 1];
+            sibling->count = NODE_SIZE - mid;
+
+            key = keys[mid];
+            left = parent;
+            right = sibling;
+        }
+    }
+
+    // Remove child slots[depth-1] of path[depth-1]; an inner node left without
+    // children is removed from its own parent in turn
+    void remove_child(Inner** path, int* slots, int depth) {
+        while (depth > 0) {
+            Inner* parent = path[--depth];
+            int slot = slots[depth];
+            if (parent->count > 0) {
+                int key_slot = slot == 0 ? 0 : slot - 1;
+                shift_left(parent->keys, key_slot, parent->count);
+                shift_left(parent->children, slot, parent->count + 1);
+                parent->count--;
+                parent->keys[parent->count] = KEY_PAD;
+                break;
+            }
+            if (parent == root_) {
+                // Last leaf gone: start over with an empty root leaf
+                delete parent;
+                root_ = head_ = new Leaf();
+                return;
+            }
+            delete parent;
+        }
+
+        // Collapse single-child roots
+        while (!root_->is_leaf && root_->count == 0) {
+            Inner* old = static_cast<Inner*>(root_);
+            root_ = old->children[0];
+            delete old;
+        }
+    }
+
+    static void destroy(Node* node) {
+        if (node->is_leaf) {
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        for (int i = 0; i <= inner->count; ++i) {
+            destroy(inner->children[i]);
+        }
+        delete inner;
+    }
+
+    Node* root_;
+    Leaf* head_;
+    size_t size_{0};
+};
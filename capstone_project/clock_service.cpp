@@ -0,0 +1,49 @@
+#include "clock_service.hpp"
+#include <iostream>
+
+ClockService::ClockService(ClockSource source) : source_(source) {
+    if (source_ == ClockSource::Tsc) {
+        if (ORDER_BOOK_HAS_TSC) {
+            calibrate();
+        } else {
+            std::cerr << "Warning: TSC not available, using CLOCK_REALTIME\n";
+            source_ = ClockSource::Realtime;
+        }
+    }
+    refresh();
+}
+
+void ClockService::calibrate(uint64_t window_ns) {
+    // Bracket each TSC read between two realtime reads and keep the tightest
+    // pair so vDSO latency does not leak into the anchor
+    auto anchor = [](uint64_t& tsc, uint64_t& ns) {
+        uint64_t best_gap = ~uint64_t{0};
+        for (int i = 0; i < 16; ++i) {
+            uint64_t before = realtime_ns();
+            uint64_t t = read_tsc();
+            uint64_t after = realtime_ns();
+            if (after - before < best_gap) {
+                best_gap = after - before;
+                tsc = t;
+                ns = before + (after - before) / 2;
+            }
+        }
+    };
+
+    uint64_t start_tsc = 0, start_ns = 0, end_tsc = 0, end_ns = 0;
+    anchor(start_tsc, start_ns);
+    while (realtime_ns() - start_ns < window_ns) {
+    }
+    anchor(end_tsc, end_ns);
+
+    if (end_tsc <= start_tsc || end_ns <= start_ns) {
+        std::cerr << "Warning: TSC calibration failed, using CLOCK_REALTIME\n";
+        source_ = ClockSource::Realtime;
+        return;
+    }
+
+    ticks_per_ns_ = static_cast<double>(end_tsc - start_tsc) / static_cast<double>(end_ns - start_ns);
+    ns_per_tick_fixed_ = static_cast<uint64_t>((1.0 / ticks_per_ns_) * static_cast<double>(1ull << SCALE_SHIFT));
+    base_tsc_ = end_tsc;
+    base_ns_ = end_ns;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "order_book.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ORDER_BOOK_HAS_TSC 1
+#else
+#define ORDER_BOOK_HAS_TSC 0
+#endif
+
+enum class ClockSource {
+    Tsc,      // rdtsc scaled by a calibrated multiplier; falls back to Realtime without a TSC
+    Cached,   // value captured by refresh(), typically once per event-loop iteration
+    Realtime  // clock_gettime(CLOCK_REALTIME) on every call
+};
+
+// Wall-clock nanosecond timestamps for orders and events. The TSC source turns
+// a timestamp into rdtsc plus a multiply and shift; the cached source makes it
+// a load. Both stay on the CLOCK_REALTIME epoch so values remain comparable
+// with timestamps taken elsewhere.
+class ClockService {
+public:
+    explicit ClockService(ClockSource source = ClockSource::Tsc);
+
+    ClockSource source() const { return source_; }
+
+    uint64_t now_ns() const {
+        switch (source_) {
+        case ClockSource::Tsc:
+            return tsc_to_ns(read_tsc());
+        case ClockSource::Cached:
+            return cached_ns_;
+        case ClockSource::Realtime:
+        default:
+            return realtime_ns();
+        }
+    }
+
+    // Capture the current time for the cached source
+    void refresh() { cached_ns_ = source_ == ClockSource::Cached ? realtime_ns() : now_ns(); }
+
+    // Stamp a batch of orders with a single clock read
+    void stamp(Order* orders, size_t count) const {
+        uint64_t ts = now_ns();
+        for (size_t i = 0; i < count; ++i) {
+            orders[i].timestamp_ns = ts;
+        }
+    }
+
+    // Re-anchor the TSC conversion to CLOCK_REALTIME to bound drift; measures
+    // the tick rate over roughly `window_ns`
+    void calibrate(uint64_t window_ns = 10000000);
+
+    double ticks_per_ns() const { return ticks_per_ns_; }
+
+    static uint64_t realtime_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    static uint64_t read_tsc() {
+#if ORDER_BOOK_HAS_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+private:
+    static constexpr int SCALE_SHIFT = 32;
+
+    uint64_t tsc_to_ns(uint64_t tsc) const {
+        if (tsc < base_tsc_) {
+            return base_ns_;
+        }
+        __extension__ typedef unsigned __int128 u128;   // quiet under -pedantic
+        u128 delta = static_cast<u128>(tsc - base_tsc_) * ns_per_tick_fixed_;
+        return base_ns_ + static_cast<uint64_t>(delta >> SCALE_SHIFT);
+    }
+
+    ClockSource source_;
+    uint64_t base_tsc_{0};
+    uint64_t base_ns_{0};
+    uint64_t ns_per_tick_fixed_{0}; // nanoseconds per tick, 32.32 fixed point
+    double ticks_per_ns_{0.0};
+    uint64_t cached_ns_{0};
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// Epoch-based reclamation for one writer thread and a bounded set of readers.
+/// Readers announce the global epoch while they hold pointers into the
+/// structure; the writer frees retired nodes only once every active reader has
+/// moved past the epoch in which the node was unlinked.
+class EpochReclaimer {
+public:
+    static constexpr size_t MAX_READERS = 64;
+    static constexpr uint64_t IDLE = ~uint64_t{0};
+
+    EpochReclaimer() = default;
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    ~EpochReclaimer() {
+        for (auto& r : retired_) {
+            r.deleter(r.ptr);
+        }
+    }
+
+    /// Claim a reader slot. Returns MAX_READERS if all slots are taken.
+    size_t register_reader() {
+        for (size_t i = 0; i < MAX_READERS; ++i) {
+            bool expected = false;
+            if (slots_[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return i;
+            }
+        }
+        return MAX_READERS;
+    }
+
+    void unregister_reader(size_t slot) {
+        assert(slot < MAX_READERS);
+        slots_[slot].epoch.store(IDLE, std::memory_order_release);
+        slots_[slot].in_use.store(false, std::memory_order_release);
+    }
+
+    void enter(size_t slot) {
+        slots_[slot].epoch.store(global_epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // Pairs with the fence in reclaim(): either the writer sees this
+        // announcement or this reader sees the unlink that preceded it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void exit(size_t slot) {
+        slots_[slot].epoch.store(IDLE, std::memory_order_release);
+    }
+
+    /// Writer only: hand over an unlinked object for deferred destruction.
+    void retire(void* ptr, void (*deleter)(void*)) {
+        retired_.push_back({ptr, deleter, global_epoch_.load(std::memory_order_relaxed)});
+        if (retired_.size() >= RECLAIM_THRESHOLD) {
+            reclaim();
+        }
+    }
+
+    /// Writer only: advance the epoch and free everything no reader can reach.
+    void reclaim() {
+        uint64_t current = global_epoch_.load(std::memory_order_relaxed) + 1;
+        global_epoch_.store(current, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        uint64_t min_active = current;
+        for (const auto& slot : slots_) {
+            uint64_t e = slot.epoch.load(std::memory_order_acquire);
+            if (e < min_active) {
+                min_active = e;
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < retired_.size(); ++i) {
+            if (retired_[i].epoch < min_active) {
+                retired_[i].deleter(retired_[i].ptr);
+            } else {
+                retired_[kept++] = retired_[i];
+            }
+        }
+        retired_.resize(kept);
+    }
+
+    size_t pending() const { return retired_.size(); }
+
+private:
+    static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> in_use{false};
+    };
+
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    alignas(64) std::atomic<uint64_t> global_epoch_{0};
+    ReaderSlot slots_[MAX_READERS];
+    std::vector<Retired> retired_;
+};
+
+/// Skiplist node for one price level. Quantity fields are written by the
+/// matching thread and read without locks by depth walkers.
+struct ConcurrentLevelNode {
+    static constexpr int MAX_HEIGHT = 12;
+
+    double price;
+    std::atomic<uint64_t> total_quantity{0};
+    std::atomic<uint32_t> order_count{0};
+    int height{1};
+    std::atomic<ConcurrentLevelNode*> next[MAX_HEIGHT];
+
+    ConcurrentLevelNode(double p, int h) : price(p), height(h) {
+        for (auto& n : next) {
+            n.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+};
+
+/// Lock-free skiplist of price levels: one writer (the matching thread) and
+/// many readers walking full depth concurrently. Nodes are published with
+/// release stores and unlinked nodes are reclaimed through EpochReclaimer.
+template<typename Compare>
+class ConcurrentLevelIndex {
+public:
+    using Node = ConcurrentLevelNode;
+    static constexpr int MAX_HEIGHT = Node::MAX_HEIGHT;
+
+    /// RAII reader registration; one per reader thread.
+    class Reader {
+    public:
+        explicit Reader(const ConcurrentLevelIndex& index)
+            : index_(index), slot_(index.reclaimer_.register_reader()) {}
+        ~Reader() {
+            if (valid()) {
+                index_.reclaimer_.unregister_reader(slot_);
+            }
+        }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        bool valid() const { return slot_ < EpochReclaimer::MAX_READERS; }
+
+        /// Visit up to `depth` levels from the touch outwards. The callback
+        /// receives (price, total_quantity, order_count). Returns levels visited.
+        template<typename Fn>
+        size_t walk(size_t depth, Fn&& fn) const {
+            if (!valid()) {
+                return 0;
+            }
+            index_.reclaimer_.enter(slot_);
+            size_t visited = 0;
+            Node* n = index_.head_.next[0].load(std::memory_order_acquire);
+            while (n && visited < depth) {
+                fn(n->price, n->total_quantity.load(std::memory_order_relaxed),
+                   n->order_count.load(std::memory_order_relaxed));
+                ++visited;
+                n = n->next[0].load(std::memory_order_acquire);
+            }
+            index_.reclaimer_.exit(slot_);
+            return visited;
+        }
+
+    private:
+        const ConcurrentLevelIndex& index_;
+        size_t slot_;
+    };
+
+    ConcurrentLevelIndex() : head_(0.0, MAX_HEIGHT) {}
+
+    ~ConcurrentLevelIndex() {
+        Node* n = head_.next[0].load(std::memory_order_relaxed);
+        while (n) {
+            Node* next = n->next[0].load(std::memory_order_relaxed);
+            delete n;
+            n = next;
+        }
+    }
+
+    ConcurrentLevelIndex(const ConcurrentLevelIndex&) = delete;
+    ConcurrentLevelIndex& operator=(const ConcurrentLevelIndex&) = delete;
+
+    /// Writer only: insert a level and return its node so that later quantity
+    /// updates are a plain atomic store without another search.
+    Node* insert(double price) {
+        Node* preds[MAX_HEIGHT];
+        Node* found = find(price, preds);
+        if (found) {
+            return found;
+        }
+
+        int height = random_height();
+        Node* node = new Node(price, height);
+        for (int i = 0; i < height; ++i) {
+            node->next[i].store(preds[i]->next[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        // Link bottom-up so a reader never reaches the node at level i
+        // without it already being reachable at level 0.
+        for (int i = 0; i < height; ++i) {
+            preds[i]->next[i].store(node, std::memory_order_release);
+        }
+        ++size_;
+        return node;
+    }
+
+    /// Writer only: publish a level's aggregate quantity.
+    static void update(Node* node, uint64_t total_quantity, size_t order_count) {
+        node->total_quantity.store(total_quantity, std::memory_order_relaxed);
+        node->order_count.store(static_cast<uint32_t>(order_count), std::memory_order_relaxed);
+    }
+
+    /// Writer only: unlink a level; the node is freed once no reader can see it.
+    bool erase(double price) {
+        Node* preds[MAX_HEIGHT];
+        Node* node = find(price, preds);
+        if (!node) {
+            return false;
+        }
+
+        for (int i = node->height - 1; i >= 0; --i) {
+            preds[i]->next[i].store(node->next[i].load(std::memory_order_relaxed), std::memory_order_release);
+        }
+        --size_;
+        reclaimer_.retire(node, [](void* p) { delete static_cast<Node*>(p); });
+        return true;
+    }
+
+    /// Writer only: force reclamation of retired nodes.
+    void reclaim() { reclaimer_.reclaim(); }
+
+    size_t size() const { return size_; }
+
+private:
+    Node* find(double price, Node** preds) {
+        Node* x = &head_;
+        for (int i = MAX_HEIGHT - 1; i >= 0; --i) {
+            Node* next = x->next[i].load(std::memory_order_relaxed);
+            while (next && comp_(next->price, price)) {
+                x = next;
+                next = x->next[i].load(std::memory_order_relaxed);
+            }
+            preds[i] = x;
+        }
+        Node* candidate = x->next[0].load(std::memory_order_relaxed);
+        return (candidate && candidate->price == price) ? candidate : nullptr;
+    }
+
+    int random_height() {
+        // xorshift64; each extra level with probability 1/4
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        int height = 1;
+        uint64_t bits = rng_;
+        while (height < MAX_HEIGHT && (bits & 3) == 0) {
+            ++height;
+            bits >>= 2;
+        }
+        return height;
+    }
+
+    Node head_;
+    Compare comp_{};
+    size_t size_{0};
+    uint64_t rng_{0x9E3779B97F4A7C15ull};
+    mutable EpochReclaimer reclaimer_;
+};
+
+using ConcurrentBidIndex = ConcurrentLevelIndex<std::greater<double>>;
+using ConcurrentAskIndex = ConcurrentLevelIndex<std::less<double>>;
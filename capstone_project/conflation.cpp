@@ -0,0 +1,155 @@
+#include "conflation.hpp"
+#include <cstring>
+#include <iostream>
+
+class ConflationListener : public BookListener {
+public:
+    ConflationListener(ConflatingPublisher& publisher, uint32_t symbol) : publisher_(publisher), symbol_(symbol) {}
+
+    void on_level_update(bool is_buy, double price, uint64_t /*total_quantity*/) override {
+        publisher_.on_level_update(symbol_, is_buy, price);
+    }
+
+    void on_operation_complete() override {
+        publisher_.on_operation_complete(symbol_);
+    }
+
+private:
+    ConflatingPublisher& publisher_;
+    uint32_t symbol_;
+};
+
+ConflatingPublisher::ConflatingPublisher(size_t max_symbols)
+    : max_symbols_(max_symbols), slots_(std::make_unique<Slot[]>(max_symbols)) {
+    symbols_.resize(max_symbols);
+    scratch_bids_.reserve(CONFLATED_DEPTH);
+    scratch_asks_.reserve(CONFLATED_DEPTH);
+    for (size_t i = 0; i < max_symbols; ++i) {
+        for (auto& word : slots_[i].words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+    size_t capacity = 1;
+    while (capacity < max_symbols) {
+        capacity <<= 1;
+    }
+    dirty_queue_ = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+    dirty_mask_ = capacity - 1;
+}
+
+ConflatingPublisher::~ConflatingPublisher() {
+    for (size_t i = 0; i < symbol_count_; ++i) {
+        symbols_[i].book->remove_listener(symbols_[i].listener.get());
+    }
+}
+
+uint32_t ConflatingPublisher::attach(OrderBook& book) {
+    if (symbol_count_ == max_symbols_) {
+        std::cerr << "Error: Conflation table full (" << max_symbols_ << " symbols)\n";
+        return UINT32_MAX;
+    }
+
+    uint32_t id = static_cast<uint32_t>(symbol_count_++);
+    Symbol& symbol = symbols_[id];
+    symbol.book = &book;
+    symbol.listener = std::make_unique<ConflationListener>(*this, id);
+    book.add_listener(symbol.listener.get());
+    publish(id);
+    return id;
+}
+
+void ConflatingPublisher::on_level_update(uint32_t id, bool is_buy, double price) {
+    Symbol& symbol = symbols_[id];
+    if (symbol.touched) {
+        return;
+    }
+    // Levels below a full top-N cannot change what the consumer sees
+    const ConflatedBook& latest = symbol.latest;
+    if (is_buy) {
+        symbol.touched = latest.bid_count < CONFLATED_DEPTH || price >= latest.bids[CONFLATED_DEPTH - 1].price;
+    } else {
+        symbol.touched = latest.ask_count < CONFLATED_DEPTH || price <= latest.asks[CONFLATED_DEPTH - 1].price;
+    }
+}
+
+void ConflatingPublisher::on_operation_complete(uint32_t id) {
+    if (symbols_[id].touched) {
+        symbols_[id].touched = false;
+        publish(id);
+    }
+}
+
+void ConflatingPublisher::publish(uint32_t id) {
+    Symbol& symbol = symbols_[id];
+    std::vector<PriceLevel>& bids = scratch_bids_;
+    std::vector<PriceLevel>& asks = scratch_asks_;
+    symbol.book->get_snapshot(CONFLATED_DEPTH, bids, asks);   // within the reserved capacity
+
+    ConflatedBook& state = symbol.latest;
+    state.version = symbol.book->get_version();
+    state.publish_count++;
+    state.bid_count = static_cast<uint32_t>(bids.size());
+    state.ask_count = static_cast<uint32_t>(asks.size());
+    for (size_t i = 0; i < CONFLATED_DEPTH; ++i) {
+        state.bids[i] = i < bids.size() ? bids[i] : PriceLevel();
+        state.asks[i] = i < asks.size() ? asks[i] : PriceLevel();
+    }
+    write_slot(slots_[id], state);
+
+    // The exchange orders the slot write before the flag; if the consumer
+    // cleared the flag first it will see this write, otherwise it is queued again
+    if (!slots_[id].dirty.exchange(true, std::memory_order_acq_rel)) {
+        size_t tail = dirty_tail_.load(std::memory_order_relaxed);
+        dirty_queue_[tail & dirty_mask_].store(id, std::memory_order_relaxed);
+        dirty_tail_.store(tail + 1, std::memory_order_release);
+    }
+}
+
+bool ConflatingPublisher::poll(uint32_t& symbol, ConflatedBook& state) {
+    size_t head = dirty_head_.load(std::memory_order_relaxed);
+    if (head == dirty_tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    symbol = dirty_queue_[head & dirty_mask_].load(std::memory_order_relaxed);
+    dirty_head_.store(head + 1, std::memory_order_release);
+
+    // Clear before reading so that a write racing this read marks it dirty again
+    slots_[symbol].dirty.exchange(false, std::memory_order_acq_rel);
+    read_slot(slots_[symbol], state);
+    return true;
+}
+
+void ConflatingPublisher::read(uint32_t symbol, ConflatedBook& state) const {
+    read_slot(slots_[symbol], state);
+}
+
+void ConflatingPublisher::write_slot(Slot& slot, const ConflatedBook& state) {
+    uint64_t words[SLOT_WORDS] = {};
+    std::memcpy(words, &state, sizeof(state));
+
+    uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < SLOT_WORDS; ++i) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(seq + 2, std::memory_order_release);
+}
+
+void ConflatingPublisher::read_slot(const Slot& slot, ConflatedBook& state) const {
+    uint64_t words[SLOT_WORDS];
+    while (true) {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        for (size_t i = 0; i < SLOT_WORDS; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    std::memcpy(&state, words, sizeof(state));
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "order_book.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+constexpr size_t CONFLATED_DEPTH = 5;
+
+// Latest top-N state of one symbol as seen by a conflated consumer
+struct ConflatedBook {
+    uint64_t version{0};       // OrderBook::get_version() when captured
+    uint64_t publish_count{0}; // states written for this symbol so far
+    uint32_t bid_count{0};
+    uint32_t ask_count{0};
+    PriceLevel bids[CONFLATED_DEPTH];
+    PriceLevel asks[CONFLATED_DEPTH];
+};
+
+// Decouples a slow consumer (GUI, risk) from the matching thread. The
+// producer side listens to OrderBooks and, once per book operation that
+// touched the top CONFLATED_DEPTH levels, overwrites that symbol's slot under
+// a seqlock. A symbol id goes into the dirty queue only on its first change
+// since the consumer last read it, so the queue never holds more entries than
+// there are symbols and memory stays bounded whatever the update rate. The
+// consumer drains at its own pace and always reads the latest state.
+//
+// One producer thread (the one mutating the attached books) and one consumer
+// thread; use one publisher per consumer.
+class ConflatingPublisher {
+public:
+    explicit ConflatingPublisher(size_t max_symbols);
+    ~ConflatingPublisher();
+    ConflatingPublisher(const ConflatingPublisher&) = delete;
+    ConflatingPublisher& operator=(const ConflatingPublisher&) = delete;
+
+    // Producer side: subscribe to a book and publish its current state;
+    // returns the symbol id, or UINT32_MAX when the table is full
+    uint32_t attach(OrderBook& book);
+
+    // Consumer side: take the next symbol that changed since it was last
+    // polled, with its latest state. False when nothing is dirty.
+    bool poll(uint32_t& symbol, ConflatedBook& state);
+
+    // Consumer side: latest state of a symbol regardless of the dirty queue
+    void read(uint32_t symbol, ConflatedBook& state) const;
+
+    size_t symbol_count() const { return symbol_count_; }
+
+private:
+    static constexpr size_t SLOT_WORDS = (sizeof(ConflatedBook) + 7) / 8;
+
+    // The state is copied word by word through relaxed atomics so that a read
+    // racing a write is well defined; the sequence number says whether to retry
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0}; // odd while a write is in progress
+        std::atomic<uint64_t> words[SLOT_WORDS];
+        std::atomic<bool> dirty{false};
+    };
+
+    struct Symbol {
+        OrderBook* book{nullptr};
+        std::unique_ptr<BookListener> listener;
+        ConflatedBook latest;   // producer-private copy of the last published state
+        bool touched{false};    // a top-N level changed during the current operation
+    };
+
+    friend class ConflationListener;
+    void on_level_update(uint32_t symbol, bool is_buy, double price);
+    void on_operation_complete(uint32_t symbol);
+    void publish(uint32_t symbol);
+
+    void write_slot(Slot& slot, const ConflatedBook& state);
+    void read_slot(const Slot& slot, ConflatedBook& state) const;
+
+    size_t max_symbols_;
+    size_t symbol_count_{0};
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<Symbol> symbols_;
+    std::vector<PriceLevel> scratch_bids_;  // publish() buffers, reserved to CONFLATED_DEPTH once
+    std::vector<PriceLevel> scratch_asks_;
+
+    // SPSC queue of dirty symbol ids; capacity >= max_symbols so a push never fails
+    std::unique_ptr<std::atomic<uint32_t>[]> dirty_queue_;
+    size_t dirty_mask_;
+    alignas(64) std::atomic<size_t> dirty_head_{0}; // consumer position
+    alignas(64) std::atomic<size_t> dirty_tail_{0}; // producer position
+};
@@ -0,0 +1,198 @@
+#include "consolidated_book.hpp"
+#include <iostream>
+#include <limits>
+
+namespace {
+
+class VenueListener : public BookListener {
+public:
+    VenueListener(ConsolidatedBook& parent, size_t venue) : parent_(parent), venue_(venue) {}
+
+    void on_level_update(bool is_buy, double price, uint64_t total_quantity) override {
+        parent_.on_level_update(venue_, is_buy, price, total_quantity);
+    }
+
+private:
+    ConsolidatedBook& parent_;
+    size_t venue_;
+};
+
+// Set or erase a level and return the quantity it replaced
+template<typename Levels>
+uint64_t exchange_level(Levels& levels, double price, uint64_t total_quantity) {
+    auto it = levels.find(price);
+    uint64_t old_quantity = (it != levels.end()) ? it->second : 0;
+    if (total_quantity == 0) {
+        if (it != levels.end()) {
+            levels.erase(it);
+        }
+    } else if (it != levels.end()) {
+        it->second = total_quantity;
+    } else {
+        levels.emplace(price, total_quantity);
+    }
+    return old_quantity;
+}
+
+template<typename Levels>
+void apply_delta(Levels& levels, double price, uint64_t old_quantity, uint64_t new_quantity) {
+    if (old_quantity == new_quantity) {
+        return;
+    }
+    uint64_t& merged = levels[price];
+    merged = merged - old_quantity + new_quantity;
+    if (merged == 0) {
+        levels.erase(price);
+    }
+}
+
+} // namespace
+
+ConsolidatedBook::BestTree::BestTree(size_t venues, bool is_buy)
+    : is_buy_(is_buy),
+      empty_(is_buy ? 0.0 : std::numeric_limits<double>::max()),
+      leaves_(1) {
+    while (leaves_ < venues) {
+        leaves_ <<= 1;
+    }
+    prices_.assign(leaves_, empty_);
+    nodes_.assign(2 * leaves_, 0);
+    for (size_t i = 0; i < leaves_; ++i) {
+        nodes_[leaves_ + i] = i;
+    }
+    for (size_t n = leaves_ - 1; n >= 1; --n) {
+        nodes_[n] = nodes_[2 * n];
+    }
+}
+
+bool ConsolidatedBook::BestTree::better(size_t a, size_t b) const {
+    if (prices_[a] == prices_[b]) {
+        return a < b;
+    }
+    return is_buy_ ? prices_[a] > prices_[b] : prices_[a] < prices_[b];
+}
+
+void ConsolidatedBook::BestTree::update(size_t venue, double price) {
+    prices_[venue] = price;
+    for (size_t n = (leaves_ + venue) / 2; n >= 1; n /= 2) {
+        size_t l = nodes_[2 * n];
+        size_t r = nodes_[2 * n + 1];
+        nodes_[n] = better(l, r) ? l : r;
+    }
+}
+
+ConsolidatedBook::ConsolidatedBook(size_t venue_count)
+    : venue_count_(venue_count),
+      venues_(venue_count),
+      best_bids_(venue_count, true),
+      best_asks_(venue_count, false) {}
+
+ConsolidatedBook::~ConsolidatedBook() {
+    for (size_t v = 0; v < venue_count_; ++v) {
+        detach(v);
+    }
+}
+
+void ConsolidatedBook::attach(size_t venue, OrderBook& book) {
+    if (venue >= venue_count_) {
+        std::cerr << "Error: Invalid venue: " << venue << "\n";
+        return;
+    }
+    detach(venue);
+
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(std::numeric_limits<size_t>::max(), bids, asks);
+    for (const auto& level : bids) {
+        on_level_update(venue, true, level.price, level.total_quantity);
+    }
+    for (const auto& level : asks) {
+        on_level_update(venue, false, level.price, level.total_quantity);
+    }
+
+    Venue& v = venues_[venue];
+    v.book = &book;
+    v.listener = std::make_unique<VenueListener>(*this, venue);
+    book.add_listener(v.listener.get());
+}
+
+void ConsolidatedBook::detach(size_t venue) {
+    if (venue >= venue_count_) {
+        return;
+    }
+    Venue& v = venues_[venue];
+    if (v.book) {
+        v.book->remove_listener(v.listener.get());
+        v.book = nullptr;
+        v.listener.reset();
+    }
+
+    // Withdraw the venue's liquidity from the merged view
+    while (!v.bids.empty()) {
+        on_level_update(venue, true, v.bids.begin()->first, 0);
+    }
+    while (!v.asks.empty()) {
+        on_level_update(venue, false, v.asks.begin()->first, 0);
+    }
+}
+
+void ConsolidatedBook::on_level_update(size_t venue, bool is_buy, double price, uint64_t total_quantity) {
+    Venue& v = venues_[venue];
+    if (is_buy) {
+        uint64_t old_quantity = exchange_level(v.bids, price, total_quantity);
+        apply_delta(bids_, price, old_quantity, total_quantity);
+        double best = v.bids.empty() ? best_bids_.empty_price() : v.bids.begin()->first;
+        if (best != best_bids_.price(venue)) {
+            best_bids_.update(venue, best);
+        }
+    } else {
+        uint64_t old_quantity = exchange_level(v.asks, price, total_quantity);
+        apply_delta(asks_, price, old_quantity, total_quantity);
+        double best = v.asks.empty() ? best_asks_.empty_price() : v.asks.begin()->first;
+        if (best != best_asks_.price(venue)) {
+            best_asks_.update(venue, best);
+        }
+    }
+}
+
+ConsolidatedBBO ConsolidatedBook::get_bbo() const {
+    ConsolidatedBBO bbo;
+    bbo.ask_price = best_asks_.empty_price();
+
+    size_t bid_venue = best_bids_.best_venue();
+    if (best_bids_.price(bid_venue) != best_bids_.empty_price()) {
+        bbo.bid_venue = bid_venue;
+        bbo.bid_price = best_bids_.price(bid_venue);
+        bbo.bid_quantity = bids_.at(bbo.bid_price);
+    }
+
+    size_t ask_venue = best_asks_.best_venue();
+    if (best_asks_.price(ask_venue) != best_asks_.empty_price()) {
+        bbo.ask_venue = ask_venue;
+        bbo.ask_price = best_asks_.price(ask_venue);
+        bbo.ask_quantity = asks_.at(bbo.ask_price);
+    }
+    return bbo;
+}
+
+void ConsolidatedBook::get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const {
+    bids.clear();
+    asks.clear();
+
+    auto bid_it = bids_.begin();
+    for (size_t i = 0; i < depth && bid_it != bids_.end(); ++i, ++bid_it) {
+        bids.emplace_back(bid_it->first, bid_it->second);
+    }
+
+    auto ask_it = asks_.begin();
+    for (size_t i = 0; i < depth && ask_it != asks_.end(); ++i, ++ask_it) {
+        asks.emplace_back(ask_it->first, ask_it->second);
+    }
+}
+
+double ConsolidatedBook::get_venue_best_bid(size_t venue) const {
+    return best_bids_.price(venue);
+}
+
+double ConsolidatedBook::get_venue_best_ask(size_t venue) const {
+    return best_asks_.price(venue);
+}
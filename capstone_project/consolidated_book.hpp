@@ -0,0 +1,77 @@
+#pragma once
+#include "order_book.hpp"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct ConsolidatedBBO {
+    double bid_price{0.0};
+    uint64_t bid_quantity{0};     // Total across all venues at bid_price
+    size_t bid_venue{SIZE_MAX};   // Venue holding the best bid (lowest index on ties)
+    double ask_price{0.0};
+    uint64_t ask_quantity{0};
+    size_t ask_venue{SIZE_MAX};
+};
+
+// Merged view of the same instrument traded on several venues, each modelled
+// by its own OrderBook. Maintained incrementally from the books' level deltas:
+// the merged ladder is adjusted by each delta and the national best bid/offer
+// comes from a tournament tree over the venues' best prices, so a change at
+// one venue's touch costs O(log venues).
+class ConsolidatedBook {
+public:
+    explicit ConsolidatedBook(size_t venue_count);
+    ~ConsolidatedBook();
+    ConsolidatedBook(const ConsolidatedBook&) = delete;
+    ConsolidatedBook& operator=(const ConsolidatedBook&) = delete;
+
+    // Subscribe to a venue's book, seeding from its current depth once
+    void attach(size_t venue, OrderBook& book);
+    void detach(size_t venue);
+
+    // Apply one level delta from a venue (also usable with external feeds)
+    void on_level_update(size_t venue, bool is_buy, double price, uint64_t total_quantity);
+
+    ConsolidatedBBO get_bbo() const;
+    void get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const;
+
+    double get_venue_best_bid(size_t venue) const;
+    double get_venue_best_ask(size_t venue) const;
+    size_t venue_count() const { return venue_count_; }
+
+private:
+    // Winner tree over per-venue best prices
+    class BestTree {
+    public:
+        BestTree(size_t venues, bool is_buy);
+        void update(size_t venue, double price);
+        size_t best_venue() const { return nodes_[1]; }
+        double price(size_t venue) const { return prices_[venue]; }
+        double empty_price() const { return empty_; }
+
+    private:
+        bool better(size_t a, size_t b) const;
+
+        bool is_buy_;
+        double empty_;
+        size_t leaves_;
+        std::vector<double> prices_;
+        std::vector<size_t> nodes_;
+    };
+
+    struct Venue {
+        std::map<double, uint64_t, std::greater<double>> bids;
+        std::map<double, uint64_t> asks;
+        OrderBook* book{nullptr};
+        std::unique_ptr<BookListener> listener;
+    };
+
+    size_t venue_count_;
+    std::vector<Venue> venues_;
+    std::map<double, uint64_t, std::greater<double>> bids_;
+    std::map<double, uint64_t> asks_;
+    BestTree best_bids_;
+    BestTree best_asks_;
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+// Fixed-point decimal text conversion: ASCII <-> integers counted in units of
+// 10^-scale (price ticks, or whole quantities at scale 0). No allocation, no
+// locale, no stream state, and exact: "100.07" at scale 2 is 10007, where
+// strtod gives 100.06999... Scales run from 0 to MAX_SCALE.
+namespace decimal {
+
+constexpr int MAX_SCALE = 9;
+constexpr int MAX_DIGITS = 18;         // significant digits that always fit int64_t
+constexpr size_t FORMAT_MAX = 24;      // buffer size that fits any format() result
+
+constexpr int64_t POW10[MAX_DIGITS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000,
+    1000000000000000, 10000000000000000, 100000000000000000, 1000000000000000000};
+
+constexpr char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Parse [-]digits[.digits] (or [-].digits) from [s, s + len) at `scale`.
+// Fraction digits beyond the scale round half away from zero. Returns the
+// characters consumed, or 0 when there is no number or it has more than
+// MAX_DIGITS digits.
+inline size_t parse(const char* s, size_t len, int scale, int64_t& value) {
+    const char* p = s;
+    const char* end = s + len;
+    bool negative = p < end && *p == '-';
+    p += negative;
+
+    uint64_t v = 0;
+    const char* int_start = p;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+        v = v * 10 + static_cast<unsigned>(*p - '0');
+        ++p;
+    }
+    int digits = static_cast<int>(p - int_start);
+
+    int fraction = 0;
+    unsigned round = 0;
+    if (p < end && *p == '.') {
+        const char* frac_start = ++p;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            unsigned d = static_cast<unsigned>(*p - '0');
+            if (fraction < scale) {
+                v = v * 10 + d;
+                fraction++;
+            } else if (p == frac_start + scale) {
+                round = d >= 5;
+            }
+            ++p;
+        }
+        if (digits == 0 && p == frac_start) {
+            return 0;
+        }
+    } else if (digits == 0) {
+        return 0;
+    }
+    if (digits + scale > MAX_DIGITS) {
+        return 0;
+    }
+
+    v = v * static_cast<uint64_t>(POW10[scale - fraction]) + round;
+    value = negative ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+    return static_cast<size_t>(p - s);
+}
+
+// Write the digits of `v`, at least `min_digits` of them, backwards so that
+// they end just before `end`; returns the first digit
+inline char* write_digits(uint64_t v, int min_digits, char* end) {
+    char* p = end;
+    // Two digits per division
+    while (v >= 100) {
+        uint64_t pair = v % 100;
+        v /= 100;
+        p -= 2;
+        std::memcpy(p, DIGIT_PAIRS + pair * 2, 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        std::memcpy(p, DIGIT_PAIRS + v * 2, 2);
+    } else {
+        *--p = static_cast<char>('0' + v);
+    }
+    while (end - p < min_digits) {
+        *--p = '0';
+    }
+    return p;
+}
+
+// Write `value` as [-]digits.fraction with exactly `scale` fraction digits
+// (no point at scale 0). Returns the length; `out` needs FORMAT_MAX bytes.
+inline size_t format(int64_t value, int scale, char* out) {
+    char digits[FORMAT_MAX];
+    char* end = digits + FORMAT_MAX;
+    uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    char* p = write_digits(v, scale + 1, end);
+
+    char* o = out;
+    *o = '-';
+    o += value < 0;
+    size_t int_len = static_cast<size_t>(end - p - scale);
+    std::memcpy(o, p, int_len);
+    o += int_len;
+    if (scale > 0) {
+        *o++ = '.';
+        std::memcpy(o, end - scale, static_cast<size_t>(scale));
+        o += scale;
+    }
+    return static_cast<size_t>(o - out);
+}
+
+// Full-range unsigned integer (order ids, counters); `out` needs FORMAT_MAX bytes
+inline size_t format_unsigned(uint64_t value, char* out) {
+    char digits[FORMAT_MAX];
+    char* end = digits + FORMAT_MAX;
+    char* p = write_digits(value, 1, end);
+    std::memcpy(out, p, static_cast<size_t>(end - p));
+    return static_cast<size_t>(end - p);
+}
+
+// format(), right-aligned in `width` characters; returns the length written
+inline size_t format_padded(int64_t value, int scale, size_t width, char* out) {
+    char buffer[FORMAT_MAX];
+    size_t len = format(value, scale, buffer);
+    size_t pad = len < width ? width - len : 0;
+    std::memset(out, ' ', pad);
+    std::memcpy(out + pad, buffer, len);
+    return pad + len;
+}
+
+// Nearest tick count for a binary price, and back
+inline int64_t to_units(double value, int scale) {
+    return std::llround(value * static_cast<double>(POW10[scale]));
+}
+
+inline double from_units(int64_t units, int scale) {
+    return static_cast<double>(units) / static_cast<double>(POW10[scale]);
+}
+
+} // namespace decimal
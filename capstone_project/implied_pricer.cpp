@@ -0,0 +1,178 @@
+#include "implied_pricer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+class InstrumentListener : public BookListener {
+public:
+    InstrumentListener(ImpliedPricer& pricer, size_t instrument) : pricer_(pricer), instrument_(instrument) {}
+
+    void on_top_of_book(const TopOfBook& top) override {
+        pricer_.on_top_of_book(instrument_, top);
+    }
+
+private:
+    ImpliedPricer& pricer_;
+    size_t instrument_;
+};
+
+bool has_bid(const TopOfBook& top) { return top.bid_quantity > 0; }
+bool has_ask(const TopOfBook& top) { return top.ask_quantity > 0; }
+bool has_bid(const ImpliedQuote& q) { return q.bid_quantity > 0; }
+bool has_ask(const ImpliedQuote& q) { return q.ask_quantity > 0; }
+
+// Prices derived by subtraction differ in the last bits; compare in ticks
+bool same_price(double a, double b) {
+    return std::fabs(a - b) < 1e-9;
+}
+
+void add_unique(std::vector<size_t>& ids, size_t id) {
+    if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+        ids.push_back(id);
+    }
+}
+
+// Merge one implied contribution into the best quote for an outright
+void merge_bid(ImpliedQuote& q, double price, uint64_t quantity) {
+    if (!has_bid(q) || price > q.bid_price + 1e-9) {
+        q.bid_price = price;
+        q.bid_quantity = quantity;
+    } else if (same_price(price, q.bid_price)) {
+        q.bid_quantity += quantity;
+    }
+}
+
+void merge_ask(ImpliedQuote& q, double price, uint64_t quantity) {
+    if (!has_ask(q) || price < q.ask_price - 1e-9) {
+        q.ask_price = price;
+        q.ask_quantity = quantity;
+    } else if (same_price(price, q.ask_price)) {
+        q.ask_quantity += quantity;
+    }
+}
+
+} // namespace
+
+ImpliedPricer::~ImpliedPricer() {
+    for (auto& instrument : instruments_) {
+        if (instrument.book) {
+            instrument.book->remove_listener(instrument.listener.get());
+        }
+    }
+}
+
+size_t ImpliedPricer::add_outright() {
+    instruments_.emplace_back();
+    return instruments_.size() - 1;
+}
+
+size_t ImpliedPricer::add_spread(size_t near, size_t far) {
+    if (near >= instruments_.size() || far >= instruments_.size() || near == far ||
+        instruments_[near].is_spread || instruments_[far].is_spread) {
+        std::cerr << "Error: Spread legs must be two distinct outrights\n";
+        return SIZE_MAX;
+    }
+
+    size_t id = instruments_.size();
+    instruments_.emplace_back();
+    Instrument& spread = instruments_[id];
+    spread.is_spread = true;
+    spread.near = near;
+    spread.far = far;
+    spread.affected_outrights = {near, far};
+
+    for (size_t leg : {near, far}) {
+        instruments_[leg].spreads.push_back(id);
+        instruments_[leg].affected_spreads.push_back(id);
+    }
+    add_unique(instruments_[near].affected_outrights, far);
+    add_unique(instruments_[far].affected_outrights, near);
+    return id;
+}
+
+void ImpliedPricer::attach(size_t instrument, OrderBook& book) {
+    Instrument& inst = instruments_[instrument];
+    if (inst.book) {
+        inst.book->remove_listener(inst.listener.get());
+    }
+    inst.book = &book;
+    inst.listener = std::make_unique<InstrumentListener>(*this, instrument);
+    book.add_listener(inst.listener.get());
+    on_top_of_book(instrument, book.get_top_of_book());
+}
+
+void ImpliedPricer::on_top_of_book(size_t instrument, const TopOfBook& top) {
+    Instrument& inst = instruments_[instrument];
+    inst.top = top;
+    if (!incremental_) {
+        recompute_all();
+        return;
+    }
+    for (size_t spread : inst.affected_spreads) {
+        recompute_spread(spread);
+    }
+    for (size_t outright : inst.affected_outrights) {
+        recompute_outright(outright);
+    }
+}
+
+void ImpliedPricer::recompute_all() {
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        if (instruments_[i].is_spread) {
+            recompute_spread(i);
+        } else {
+            recompute_outright(i);
+        }
+    }
+}
+
+void ImpliedPricer::recompute_spread(size_t spread) {
+    Instrument& s = instruments_[spread];
+    const TopOfBook& near = instruments_[s.near].top;
+    const TopOfBook& far = instruments_[s.far].top;
+
+    ImpliedQuote q;
+    if (has_bid(near) && has_ask(far)) {
+        q.bid_price = near.bid_price - far.ask_price;
+        q.bid_quantity = std::min(near.bid_quantity, far.ask_quantity);
+    }
+    if (has_ask(near) && has_bid(far)) {
+        q.ask_price = near.ask_price - far.bid_price;
+        q.ask_quantity = std::min(near.ask_quantity, far.bid_quantity);
+    }
+    s.implied = q;
+    ++recomputations_;
+}
+
+void ImpliedPricer::recompute_outright(size_t outright) {
+    Instrument& o = instruments_[outright];
+
+    ImpliedQuote q;
+    for (size_t spread : o.spreads) {
+        const Instrument& s = instruments_[spread];
+        const TopOfBook& st = s.top;
+        if (s.near == outright) {
+            // Buy near = buy spread + buy far
+            const TopOfBook& far = instruments_[s.far].top;
+            if (has_bid(st) && has_bid(far)) {
+                merge_bid(q, st.bid_price + far.bid_price, std::min(st.bid_quantity, far.bid_quantity));
+            }
+            if (has_ask(st) && has_ask(far)) {
+                merge_ask(q, st.ask_price + far.ask_price, std::min(st.ask_quantity, far.ask_quantity));
+            }
+        } else {
+            // Buy far = buy near + sell spread
+            const TopOfBook& near = instruments_[s.near].top;
+            if (has_bid(near) && has_ask(st)) {
+                merge_bid(q, near.bid_price - st.ask_price, std::min(near.bid_quantity, st.ask_quantity));
+            }
+            if (has_ask(near) && has_bid(st)) {
+                merge_ask(q, near.ask_price - st.bid_price, std::min(near.ask_quantity, st.bid_quantity));
+            }
+        }
+    }
+    o.implied = q;
+    ++recomputations_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "order_book.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// First-generation implied prices for a futures strip. Outright books feed
+// implied-out spread prices (near bid - far ask, ...) and spread books plus
+// one outright feed implied-in outright prices. Each instrument keeps the list
+// of implied quotes that depend on it, so a top-of-book change recomputes only
+// those instead of the whole strip.
+struct ImpliedQuote {
+    double bid_price{0.0};
+    uint64_t bid_quantity{0};  // 0 = no implied bid
+    double ask_price{0.0};
+    uint64_t ask_quantity{0};  // 0 = no implied ask
+};
+
+class ImpliedPricer {
+public:
+    ImpliedPricer() = default;
+    ~ImpliedPricer();
+    ImpliedPricer(const ImpliedPricer&) = delete;
+    ImpliedPricer& operator=(const ImpliedPricer&) = delete;
+
+    // Register instruments; returns the instrument id used by the other calls.
+    // A spread is bought as buy `near` / sell `far`.
+    size_t add_outright();
+    size_t add_spread(size_t near, size_t far);
+
+    // Subscribe to an instrument's OrderBook top-of-book changes
+    void attach(size_t instrument, OrderBook& book);
+
+    // Apply a top-of-book change and recompute the implied quotes it feeds
+    void on_top_of_book(size_t instrument, const TopOfBook& top);
+
+    // Recompute every implied quote from scratch
+    void recompute_all();
+
+    // With incremental mode off every update recomputes the whole strip
+    // (benchmark baseline)
+    void set_incremental(bool incremental) { incremental_ = incremental; }
+
+    // Implied-in quote for an outright, implied-out quote for a spread
+    const ImpliedQuote& implied(size_t instrument) const { return instruments_[instrument].implied; }
+    uint64_t recomputations() const { return recomputations_; }
+    size_t instrument_count() const { return instruments_.size(); }
+
+private:
+    struct Instrument {
+        bool is_spread{false};
+        size_t near{0};
+        size_t far{0};
+        TopOfBook top;
+        ImpliedQuote implied;
+        std::vector<size_t> spreads;            // Spreads with this outright as a leg
+        std::vector<size_t> affected_spreads;   // Implied-out quotes fed by this instrument
+        std::vector<size_t> affected_outrights; // Implied-in quotes fed by this instrument
+        OrderBook* book{nullptr};
+        std::unique_ptr<BookListener> listener;
+    };
+
+    void recompute_spread(size_t spread);
+    void recompute_outright(size_t outright);
+
+    std::vector<Instrument> instruments_;
+    uint64_t recomputations_{0};
+    bool incremental_{true};
+};
@@ -0,0 +1,382 @@
+#include "instrument_master.hpp"
+#include "decimal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t TABLE_MAGIC = 0x5254534d54534e49ull;   // "INSTMSTR"
+constexpr uint32_t TABLE_VERSION = 1;
+constexpr size_t TABLE_HEADER_SIZE = 64;
+constexpr int PARAM_SCALE = 9;                // price fields parse exactly to 1e-9
+constexpr uint32_t MAX_SEED_TRIES = 1u << 20;
+
+struct TableHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t count;
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t source_size;       // the text master this table was compiled from
+    int64_t source_mtime_ns;
+};
+static_assert(sizeof(TableHeader) <= TABLE_HEADER_SIZE, "table header too large");
+static_assert(std::is_trivially_copyable<InstrumentRecord>::value, "records are used in place from the mapping");
+
+// FNV-1a picks the bucket; each bucket's seed remixes the same hash into a
+// slot, so a lookup hashes the symbol bytes once
+uint64_t symbol_hash(const char* s, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; ++i) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint32_t bucket_of(uint64_t hash, uint32_t mask) {
+    return static_cast<uint32_t>(hash >> 40) & mask;
+}
+
+uint32_t slot_of(uint64_t hash, uint32_t seed, uint32_t mask) {
+    uint64_t z = hash + (seed + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<uint32_t>(z ^ (z >> 31)) & mask;
+}
+
+uint32_t next_power_of_two(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+size_t slots_offset(uint32_t bucket_count) {
+    return TABLE_HEADER_SIZE + bucket_count * sizeof(uint32_t);
+}
+
+size_t records_offset(uint32_t bucket_count, uint32_t slot_count) {
+    return (slots_offset(bucket_count) + slot_count * sizeof(uint32_t) + 7) & ~size_t(7);
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool read_file(const std::string& path, std::vector<char>& data, struct stat& st) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open instrument master " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    bool ok = ::fstat(fd, &st) == 0;
+    if (ok) {
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (ok && done < data.size()) {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            done += ok ? static_cast<size_t>(n) : 0;
+        }
+    }
+    ::close(fd);
+    if (!ok) {
+        std::cerr << "Error: Failed to read instrument master " << path << "\n";
+    }
+    return ok;
+}
+
+// One comma-separated number at `scale`, which must span the whole field
+bool parse_field(const char*& p, const char* end, int scale, int64_t& value) {
+    const char* field_end = static_cast<const char*>(std::memchr(p, ',', static_cast<size_t>(end - p)));
+    if (!field_end) field_end = end;
+    size_t length = static_cast<size_t>(field_end - p);
+    if (length == 0 || decimal::parse(p, length, scale, value) != length || value < 0) {
+        return false;
+    }
+    p = field_end == end ? end : field_end + 1;
+    return true;
+}
+
+bool parse_line(const char* p, const char* end, InstrumentRecord& record) {
+    const char* comma = static_cast<const char*>(std::memchr(p, ',', static_cast<size_t>(end - p)));
+    if (!comma || comma == p || comma - p > static_cast<ptrdiff_t>(INSTRUMENT_SYMBOL_MAX)) {
+        return false;
+    }
+    record = InstrumentRecord{};
+    std::memcpy(record.symbol, p, static_cast<size_t>(comma - p));
+    p = comma + 1;
+
+    int64_t tick, lot, min_price, max_price, max_quantity;
+    if (!parse_field(p, end, PARAM_SCALE, tick) || !parse_field(p, end, 0, lot) ||
+        !parse_field(p, end, PARAM_SCALE, min_price) || !parse_field(p, end, PARAM_SCALE, max_price) ||
+        !parse_field(p, end, 0, max_quantity) || p != end) {
+        return false;
+    }
+    InstrumentParams& params = record.params;
+    params.tick_size = decimal::from_units(tick, PARAM_SCALE);
+    params.lot_size = static_cast<uint64_t>(lot);
+    params.min_price = decimal::from_units(min_price, PARAM_SCALE);
+    params.max_price = decimal::from_units(max_price, PARAM_SCALE);
+    params.max_quantity = static_cast<uint64_t>(max_quantity);
+    return valid_instrument_params(params);
+}
+
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+bool compile_instrument_master(const std::string& text_path, const std::string& table_path) {
+    std::vector<char> text;
+    struct stat source{};
+    if (!read_file(text_path, text, source)) {
+        return false;
+    }
+
+    std::vector<InstrumentRecord> records;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    for (size_t line = 1; p < end; ++line) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        const char* line_end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+        if (line_end != p && *p != '#') {
+            records.emplace_back();
+            if (!parse_line(p, line_end, records.back())) {
+                std::cerr << "Error: " << text_path << ":" << line << ": invalid instrument line\n";
+                return false;
+            }
+        }
+        p = eol == end ? end : eol + 1;
+    }
+    if (records.size() >= InstrumentTable::INVALID_ID) {
+        std::cerr << "Error: Too many instruments in " << text_path << "\n";
+        return false;
+    }
+
+    // Duplicate symbols would make the seed search below fail, so reject them first
+    const uint32_t count = static_cast<uint32_t>(records.size());
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return std::strcmp(records[a].symbol, records[b].symbol) < 0;
+    });
+    for (uint32_t i = 1; i < count; ++i) {
+        if (std::strcmp(records[order[i - 1]].symbol, records[order[i]].symbol) == 0) {
+            std::cerr << "Error: Duplicate instrument symbol " << records[order[i]].symbol << "\n";
+            return false;
+        }
+    }
+
+    // Hash and displace: about four symbols per bucket, 80% slot load at most.
+    // Buckets are placed largest first, each trying seeds until all of its
+    // symbols land on distinct free slots.
+    const uint32_t bucket_count = next_power_of_two(std::max(1u, count / 4));
+    const uint32_t slot_count = next_power_of_two(std::max(1u, count + count / 4));
+    std::vector<uint64_t> hashes(count);
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t i = 0; i < count; ++i) {
+        hashes[i] = symbol_hash(records[i].symbol, std::strlen(records[i].symbol));
+        buckets[bucket_of(hashes[i], bucket_count - 1)].push_back(i);
+    }
+    std::vector<uint32_t> by_size(bucket_count);
+    for (uint32_t b = 0; b < bucket_count; ++b) by_size[b] = b;
+    std::stable_sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint32_t> seeds(bucket_count, 0);
+    std::vector<uint32_t> slots(slot_count, InstrumentTable::INVALID_ID);
+    std::vector<uint32_t> placed;
+    for (uint32_t b : by_size) {
+        if (buckets[b].empty()) {
+            break;
+        }
+        uint32_t seed = 0;
+        for (; seed < MAX_SEED_TRIES; ++seed) {
+            placed.clear();
+            bool fits = true;
+            for (uint32_t id : buckets[b]) {
+                uint32_t slot = slot_of(hashes[id], seed, slot_count - 1);
+                if (slots[slot] != InstrumentTable::INVALID_ID ||
+                    std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                    fits = false;
+                    break;
+                }
+                placed.push_back(slot);
+            }
+            if (fits) break;
+        }
+        if (seed == MAX_SEED_TRIES) {
+            std::cerr << "Error: Cannot build perfect hash for " << text_path << "\n";
+            return false;
+        }
+        seeds[b] = seed;
+        for (size_t k = 0; k < placed.size(); ++k) {
+            slots[placed[k]] = buckets[b][k];
+        }
+    }
+
+    TableHeader header{};
+    header.magic = TABLE_MAGIC;
+    header.version = TABLE_VERSION;
+    header.record_size = sizeof(InstrumentRecord);
+    header.count = count;
+    header.bucket_count = bucket_count;
+    header.slot_count = slot_count;
+    header.source_size = static_cast<uint64_t>(source.st_size);
+    header.source_mtime_ns = mtime_ns(source);
+
+    std::vector<char> image(records_offset(bucket_count, slot_count) + count * sizeof(InstrumentRecord), 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + TABLE_HEADER_SIZE, seeds.data(), bucket_count * sizeof(uint32_t));
+    std::memcpy(image.data() + slots_offset(bucket_count), slots.data(), slot_count * sizeof(uint32_t));
+    if (count) {
+        std::memcpy(image.data() + records_offset(bucket_count, slot_count), records.data(),
+                    count * sizeof(InstrumentRecord));
+    }
+
+    std::string tmp_path = table_path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open instrument table " << tmp_path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    bool ok = write_all(fd, image.data(), image.size());
+    ok = (::close(fd) == 0) && ok;
+    if (ok) {
+        ok = std::rename(tmp_path.c_str(), table_path.c_str()) == 0;
+    }
+    if (!ok) {
+        std::cerr << "Error: Failed to write instrument table " << table_path << "\n";
+        std::remove(tmp_path.c_str());
+    }
+    return ok;
+}
+
+InstrumentTable::~InstrumentTable() {
+    close();
+}
+
+bool InstrumentTable::open(const std::string& table_path) {
+    if (base_) {
+        std::cerr << "Error: Instrument table already open\n";
+        return false;
+    }
+    int fd = ::open(table_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open instrument table " << table_path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st{};
+    void* addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= TABLE_HEADER_SIZE) {
+        // Prefault: every page is read during startup anyway
+        addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: Cannot map instrument table " << table_path << "\n";
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    TableHeader header;
+    std::memcpy(&header, addr, sizeof(header));
+    bool valid = header.magic == TABLE_MAGIC && header.version == TABLE_VERSION &&
+                 header.record_size == sizeof(InstrumentRecord) && header.bucket_count > 0 &&
+                 (header.bucket_count & (header.bucket_count - 1)) == 0 && header.slot_count > 0 &&
+                 (header.slot_count & (header.slot_count - 1)) == 0 &&
+                 size == records_offset(header.bucket_count, header.slot_count) +
+                         header.count * sizeof(InstrumentRecord);
+    if (valid) {
+        // find() indexes the records with these ids unchecked
+        const uint32_t* slots = reinterpret_cast<const uint32_t*>(static_cast<char*>(addr) + slots_offset(header.bucket_count));
+        for (uint32_t i = 0; valid && i < header.slot_count; ++i) {
+            valid = slots[i] == INVALID_ID || slots[i] < header.count;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Error: " << table_path << " is not an instrument table\n";
+        munmap(addr, size);
+        return false;
+    }
+
+    base_ = static_cast<char*>(addr);
+    mapped_size_ = size;
+    count_ = header.count;
+    bucket_mask_ = header.bucket_count - 1;
+    slot_mask_ = header.slot_count - 1;
+    seeds_ = reinterpret_cast<const uint32_t*>(base_ + TABLE_HEADER_SIZE);
+    slots_ = reinterpret_cast<const uint32_t*>(base_ + slots_offset(header.bucket_count));
+    records_ = reinterpret_cast<const InstrumentRecord*>(base_ + records_offset(header.bucket_count, header.slot_count));
+    return true;
+}
+
+bool InstrumentTable::matches_source(const std::string& text_path) const {
+    struct stat st{};
+    if (::stat(text_path.c_str(), &st) != 0) {
+        return false;
+    }
+    TableHeader header;
+    std::memcpy(&header, base_, sizeof(header));
+    return header.source_size == static_cast<uint64_t>(st.st_size) && header.source_mtime_ns == mtime_ns(st);
+}
+
+bool InstrumentTable::open_or_build(const std::string& text_path, const std::string& table_path) {
+    if (::access(table_path.c_str(), F_OK) == 0 && open(table_path)) {
+        if (matches_source(text_path)) {
+            return true;
+        }
+        close();
+    }
+    return compile_instrument_master(text_path, table_path) && open(table_path);
+}
+
+void InstrumentTable::close() {
+    if (base_) {
+        munmap(base_, mapped_size_);
+    }
+    base_ = nullptr;
+    mapped_size_ = 0;
+    count_ = 0;
+    seeds_ = slots_ = nullptr;
+    records_ = nullptr;
+}
+
+uint32_t InstrumentTable::find(const char* symbol, size_t length) const {
+    if (!base_ || length == 0 || length > INSTRUMENT_SYMBOL_MAX || count_ == 0) {
+        return INVALID_ID;
+    }
+    uint64_t hash = symbol_hash(symbol, length);
+    uint32_t id = slots_[slot_of(hash, seeds_[bucket_of(hash, bucket_mask_)], slot_mask_)];
+    if (id == INVALID_ID) {
+        return INVALID_ID;
+    }
+    // The hash is perfect only over known symbols: confirm the match
+    const char* stored = records_[id].symbol;
+    return std::memcmp(stored, symbol, length) == 0 && (length == INSTRUMENT_SYMBOL_MAX || stored[length] == '\0')
+               ? id : INVALID_ID;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "order_book.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Instrument reference data for startup. The security master is a text file
+// of lines
+//
+//   symbol,tick_size,lot_size,min_price,max_price,max_quantity
+//
+// (blank lines and lines starting with '#' are skipped). Parsing 100k of
+// those on every boot is slow, so compile_instrument_master() converts the
+// file once into a binary table that InstrumentTable maps read-only and uses
+// in place: a perfect hash from symbol to instrument id (one probe per lookup)
+// and an array of InstrumentParams indexed by id, ready for
+// OrderBook::set_instrument.
+// The table records the size and mtime of the text it came from, so
+// open_or_build() recompiles only when the master file changed.
+constexpr size_t INSTRUMENT_SYMBOL_MAX = 15;
+
+struct InstrumentRecord {
+    char symbol[INSTRUMENT_SYMBOL_MAX + 1];    // NUL-padded
+    InstrumentParams params;
+};
+
+// Parse the text master and write the binary table (via a temporary file and
+// rename, so readers never map a partial table)
+bool compile_instrument_master(const std::string& text_path, const std::string& table_path);
+
+class InstrumentTable {
+public:
+    static constexpr uint32_t INVALID_ID = UINT32_MAX;
+
+    InstrumentTable() = default;
+    ~InstrumentTable();
+    InstrumentTable(const InstrumentTable&) = delete;
+    InstrumentTable& operator=(const InstrumentTable&) = delete;
+
+    // Map a compiled table
+    bool open(const std::string& table_path);
+    // Map table_path, recompiling it first if it is missing or older than text_path
+    bool open_or_build(const std::string& text_path, const std::string& table_path);
+    void close();
+
+    size_t size() const { return count_; }
+
+    // Instrument id of a symbol, INVALID_ID if unknown; one hash, one probe
+    uint32_t find(const char* symbol, size_t length) const;
+    uint32_t find(const std::string& symbol) const { return find(symbol.data(), symbol.size()); }
+
+    const InstrumentRecord& operator[](uint32_t id) const { return records_[id]; }
+    const InstrumentParams& params(uint32_t id) const { return records_[id].params; }
+
+private:
+    bool matches_source(const std::string& text_path) const;
+
+    char* base_{nullptr};
+    size_t mapped_size_{0};
+    uint32_t count_{0};
+    uint32_t bucket_mask_{0};
+    uint32_t slot_mask_{0};
+    const uint32_t* seeds_{nullptr};
+    const uint32_t* slots_{nullptr};
+    const InstrumentRecord* records_{nullptr};
+};
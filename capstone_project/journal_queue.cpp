@@ -0,0 +1,335 @@
+#include "journal_queue.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr uint32_t JOURNAL_MAGIC = 0x314C4E4A; // "JNL1"
+constexpr uint32_t ROLL_MARKER = 0xFFFFFFFF;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t file;
+    uint64_t file_size;
+};
+
+static_assert(sizeof(FileHeader) <= journal::HEADER_SIZE, "file header too large");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == 4,
+              "record lengths are shared through the mapping");
+
+std::atomic<uint32_t>* length_at(char* base, uint32_t offset) {
+    return reinterpret_cast<std::atomic<uint32_t>*>(base + offset);
+}
+
+uint32_t record_size(uint32_t payload) {
+    return (sizeof(uint32_t) + payload + 7) & ~uint32_t{7};
+}
+
+// Lowest or highest file index present in `dir`; false when there is none
+bool find_file(const std::string& dir, bool highest, uint32_t& file) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return false;
+    }
+    bool found = false;
+    while (dirent* entry = readdir(d)) {
+        char* end;
+        unsigned long index = std::strtoul(entry->d_name, &end, 10);
+        if (end == entry->d_name || std::strcmp(end, ".journal") != 0) {
+            continue;
+        }
+        if (!found || (highest ? index > file : index < file)) {
+            file = static_cast<uint32_t>(index);
+            found = true;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+// Map a whole journal file, checking its header; null if it does not exist yet
+char* map_existing(const std::string& path, uint32_t file, bool writable, size_t& size) {
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > journal::HEADER_SIZE) {
+        size = static_cast<size_t>(st.st_size);
+        addr = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: Cannot map journal file " << path << "\n";
+        return nullptr;
+    }
+    FileHeader header;
+    std::memcpy(&header, addr, sizeof(header));
+    if (header.magic != JOURNAL_MAGIC || header.file != file || header.file_size != size) {
+        std::cerr << "Error: " << path << " is not a journal file\n";
+        munmap(addr, size);
+        return nullptr;
+    }
+    return static_cast<char*>(addr);
+}
+
+} // namespace
+
+std::string journal::file_path(const std::string& dir, uint32_t file) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%08u.journal", file);
+    return dir + name;
+}
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const std::string& dir, size_t file_size) {
+    if (base_) {
+        std::cerr << "Error: Journal writer already open\n";
+        return false;
+    }
+    if (file_size % 8 != 0 || file_size < journal::HEADER_SIZE + 64 || file_size > UINT32_MAX) {
+        std::cerr << "Error: Invalid journal file size " << file_size << "\n";
+        return false;
+    }
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        std::cerr << "Error: Cannot open journal directory " << dir << "\n";
+        return false;
+    }
+    dir_ = dir;
+    file_size_ = file_size;
+    messages_ = 0;
+
+    uint32_t last;
+    if (!find_file(dir, true, last)) {
+        return map_file(0, true);
+    }
+    if (!map_file(last, false)) {
+        return false;
+    }
+
+    // Resume after the last complete record; a record whose length was never
+    // stored was not appended
+    while (offset_ + sizeof(uint32_t) <= mapped_size_) {
+        uint32_t length = length_at(base_, offset_)->load(std::memory_order_acquire);
+        if (length == 0) {
+            break;
+        }
+        if (length == ROLL_MARKER) {
+            // The next file was removed after the roll; start it again
+            offset_ = static_cast<uint32_t>(mapped_size_);
+            break;
+        }
+        offset_ += record_size(length);
+    }
+    return true;
+}
+
+void JournalWriter::close() {
+    if (base_) {
+        munmap(base_, mapped_size_);
+        base_ = nullptr;
+    }
+}
+
+bool JournalWriter::map_file(uint32_t file, bool create) {
+    std::string path = journal::file_path(dir_, file);
+    if (!create) {
+        char* base = map_existing(path, file, true, mapped_size_);
+        if (!base) {
+            return false;
+        }
+        base_ = base;
+        file_ = file;
+        offset_ = journal::HEADER_SIZE;
+        return true;
+    }
+
+    // Build the file under a temporary name so readers never map it half made
+    std::string tmp = dir_ + "/.next.journal";
+    int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create journal file " << tmp << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(file_size_)) == 0) {
+        addr = mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: Cannot map journal file " << tmp << ": " << std::strerror(errno) << "\n";
+        unlink(tmp.c_str());
+        return false;
+    }
+    FileHeader header{JOURNAL_MAGIC, file, file_size_};
+    std::memcpy(addr, &header, sizeof(header));
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Cannot publish journal file " << path << ": " << std::strerror(errno) << "\n";
+        munmap(addr, file_size_);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    base_ = static_cast<char*>(addr);
+    mapped_size_ = file_size_;
+    file_ = file;
+    offset_ = journal::HEADER_SIZE;
+    return true;
+}
+
+bool JournalWriter::roll() {
+    char* old_base = base_;
+    size_t old_size = mapped_size_;
+    uint32_t old_offset = offset_;
+    if (!map_file(file_ + 1, true)) {
+        return false;
+    }
+    // The next file exists before the marker, so a reader that sees the
+    // marker can always open it
+    if (old_offset + sizeof(uint32_t) <= old_size) {
+        length_at(old_base, old_offset)->store(ROLL_MARKER, std::memory_order_release);
+    }
+    munmap(old_base, old_size);
+    return true;
+}
+
+bool JournalWriter::append(const void* data, uint32_t size) {
+    if (!base_) {
+        std::cerr << "Error: Journal writer not open\n";
+        return false;
+    }
+    if (size == 0 || record_size(size) > file_size_ - journal::HEADER_SIZE) {
+        std::cerr << "Error: Journal message of " << size << " bytes does not fit a file\n";
+        return false;
+    }
+    if (offset_ + record_size(size) > mapped_size_ && !roll()) {
+        return false;
+    }
+
+    std::memcpy(base_ + offset_ + sizeof(uint32_t), data, size);
+    length_at(base_, offset_)->store(size, std::memory_order_release);
+    offset_ += record_size(size);
+    messages_++;
+    return true;
+}
+
+bool JournalWriter::sync() {
+    if (base_ && msync(base_, mapped_size_, MS_SYNC) != 0) {
+        std::cerr << "Error: Cannot sync journal file: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+JournalReader::~JournalReader() {
+    close();
+}
+
+bool JournalReader::open(const std::string& dir, const std::string& name) {
+    if (!dir_.empty()) {
+        std::cerr << "Error: Journal reader already open\n";
+        return false;
+    }
+    dir_ = dir;
+    file_ = 0;
+    find_file(dir, false, file_);
+    offset_ = journal::HEADER_SIZE;
+
+    if (!name.empty()) {
+        std::string path = dir + "/" + name + ".position";
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        void* addr = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd, sizeof(uint64_t)) == 0) {
+            addr = mmap(nullptr, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (addr == MAP_FAILED) {
+            std::cerr << "Error: Cannot open reader position " << path << ": " << std::strerror(errno) << "\n";
+            dir_.clear();
+            return false;
+        }
+        saved_position_ = static_cast<uint64_t*>(addr);
+        if (*saved_position_ != 0) {
+            file_ = journal::file_of(*saved_position_);
+            offset_ = journal::offset_of(*saved_position_);
+        }
+    }
+    return true;
+}
+
+void JournalReader::close() {
+    unmap();
+    if (saved_position_) {
+        munmap(saved_position_, sizeof(uint64_t));
+        saved_position_ = nullptr;
+    }
+    dir_.clear();
+}
+
+void JournalReader::unmap() {
+    if (base_) {
+        munmap(base_, mapped_size_);
+        base_ = nullptr;
+    }
+}
+
+bool JournalReader::map_file(uint32_t file) {
+    size_t size;
+    char* base = map_existing(journal::file_path(dir_, file), file, false, size);
+    if (!base) {
+        return false;
+    }
+    unmap();
+    base_ = base;
+    mapped_size_ = size;
+    file_ = file;
+    return true;
+}
+
+bool JournalReader::read(const char*& data, uint32_t& size) {
+    if (dir_.empty()) {
+        return false;
+    }
+    if (saved_position_) {
+        *saved_position_ = position();
+    }
+    if (!base_ && (access(journal::file_path(dir_, file_).c_str(), F_OK) != 0 || !map_file(file_))) {
+        return false;
+    }
+
+    while (true) {
+        uint32_t length = offset_ + sizeof(uint32_t) <= mapped_size_
+            ? length_at(base_, offset_)->load(std::memory_order_acquire)
+            : ROLL_MARKER;
+        if (length == 0) {
+            return false;
+        }
+        if (length != ROLL_MARKER) {
+            data = base_ + offset_ + sizeof(uint32_t);
+            size = length;
+            offset_ += record_size(length);
+            return true;
+        }
+        // A full file without room for a marker rolls only once the next exists
+        if (access(journal::file_path(dir_, file_ + 1).c_str(), F_OK) != 0 || !map_file(file_ + 1)) {
+            return false;
+        }
+        offset_ = journal::HEADER_SIZE;
+    }
+}
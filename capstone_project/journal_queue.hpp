@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Append-only message queue in memory-mapped files that serves as both the
+// durable journal and the cross-process transport. One writer copies each
+// message straight into the page cache; readers in any process map the same
+// files and tail them, so a message is persisted and delivered by a single
+// memcpy.
+//
+// A directory holds fixed-size files 00000000.journal, 00000001.journal, ...
+// Each record is a 4-byte length followed by the payload, padded to 8 bytes.
+// The length is stored last with release semantics, so a reader (or a
+// restarted writer after a crash) never sees a partial record. When a record
+// does not fit, the writer creates the next file and leaves a roll marker.
+//
+// A position is (file index << 32) | byte offset within the file.
+namespace journal {
+
+constexpr size_t HEADER_SIZE = 64;
+
+inline uint64_t make_position(uint32_t file, uint32_t offset) {
+    return (static_cast<uint64_t>(file) << 32) | offset;
+}
+inline uint32_t file_of(uint64_t position) { return static_cast<uint32_t>(position >> 32); }
+inline uint32_t offset_of(uint64_t position) { return static_cast<uint32_t>(position); }
+
+std::string file_path(const std::string& dir, uint32_t file);
+
+} // namespace journal
+
+class JournalWriter {
+public:
+    JournalWriter() = default;
+    ~JournalWriter();
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // Open the queue in an existing directory, resuming after the last
+    // complete record. file_size applies to files created from now on.
+    bool open(const std::string& dir, size_t file_size = 64 << 20);
+    void close();
+
+    bool append(const void* data, uint32_t size);
+
+    // Flush mapped pages of the current file to disk (msync); appends are
+    // already visible to readers and survive a process crash without it
+    bool sync();
+
+    uint64_t position() const { return journal::make_position(file_, offset_); }
+    uint64_t messages() const { return messages_; }
+    uint32_t files() const { return file_ + 1; }
+
+private:
+    bool map_file(uint32_t file, bool create);
+    bool roll();
+
+    std::string dir_;
+    size_t file_size_{0};
+    char* base_{nullptr};
+    size_t mapped_size_{0};
+    uint32_t file_{0};
+    uint32_t offset_{0};
+    uint64_t messages_{0};
+};
+
+class JournalReader {
+public:
+    JournalReader() = default;
+    ~JournalReader();
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // Tail the queue in `dir`. A named reader keeps its position in
+    // <dir>/<name>.position and resumes from it; an unnamed one starts at the
+    // first file.
+    bool open(const std::string& dir, const std::string& name = "");
+    void close();
+
+    // Next message, pointing into the mapped file; valid until the next call.
+    // False when the reader has caught up with the writer. Reaching read()
+    // again acknowledges the previous message, so a named reader that crashes
+    // sees the last message again after restart.
+    bool read(const char*& data, uint32_t& size);
+
+    uint64_t position() const { return journal::make_position(file_, offset_); }
+
+private:
+    bool map_file(uint32_t file);
+    void unmap();
+
+    std::string dir_;
+    char* base_{nullptr};
+    size_t mapped_size_{0};
+    uint32_t file_{0};
+    uint32_t offset_{0};
+    uint64_t* saved_position_{nullptr}; // mapped <name>.position, or null
+};
@@ -1,9 +1,40 @@
 #include "order_book.hpp"
+#include "snapshot.hpp"
+#include "small_order_book.hpp"
+#include "consolidated_book.hpp"
+#include "implied_pricer.hpp"
+#include "clock_service.hpp"
+#include "bplus_tree.hpp"
+#include "conflation.hpp"
+#include "recovery.hpp"
+#include "market_data_publisher.hpp"
+#include "journal_queue.hpp"
+#include "decimal.hpp"
+#include "message_slab.hpp"
+#include "session_gateway.hpp"
+#include "stream_publisher.hpp"
+#include "instrument_master.hpp"
+#include "position_keeper.hpp"
+#include <map>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <chrono>
 #include <random>
+#include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <thread>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 void test_basic_functionality() {
     std::cout << "=== BASIC FUNCTIONALITY TEST ===\n";
@@ -157,10 +188,1999 @@ void test_edge_cases() {
     std::cout << "\nEdge cases test completed!\n";
 }
 
+void test_concurrent_depth() {
+    std::cout << "\n=== CONCURRENT DEPTH TEST ===\n";
+
+    OrderBook book;
+    book.add_order({1, true, 99.00, 100, 1000});
+    book.add_order({2, false, 101.00, 100, 1001});
+    book.enable_concurrent_depth();
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> walks{0};
+    std::atomic<bool> ordered{true};
+
+    std::thread reader([&] {
+        ConcurrentBidIndex::Reader bid_reader(*book.concurrent_bids());
+        ConcurrentAskIndex::Reader ask_reader(*book.concurrent_asks());
+        while (!done.load(std::memory_order_acquire)) {
+            double last_bid = std::numeric_limits<double>::max();
+            bid_reader.walk(SIZE_MAX, [&](double price, uint64_t, uint32_t) {
+                if (price >= last_bid) ordered = false;
+                last_bid = price;
+            });
+            double last_ask = 0.0;
+            ask_reader.walk(SIZE_MAX, [&](double price, uint64_t, uint32_t) {
+                if (price <= last_ask) ordered = false;
+                last_ask = price;
+            });
+            walks++;
+        }
+    });
+
+    while (walks.load() == 0) {
+        std::this_thread::yield();
+    }
+
+    std::cout << "Churning levels while a reader walks full depth...\n";
+    for (uint64_t i = 3; i < 20000; ++i) {
+        bool is_buy = i % 2 == 0;
+        double price = is_buy ? 90.0 + (i % 80) * 0.1 : 101.0 + (i % 80) * 0.1;
+        book.add_order({i, is_buy, price, 10, i});
+        if (i > 500) {
+            book.cancel_order(i - 500);
+        }
+    }
+
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(SIZE_MAX, bids, asks);
+
+    std::vector<PriceLevel> mirrored;
+    ConcurrentBidIndex::Reader bid_reader(*book.concurrent_bids());
+    bid_reader.walk(SIZE_MAX, [&](double price, uint64_t qty, uint32_t) {
+        mirrored.emplace_back(price, qty);
+    });
+
+    assert(ordered.load());
+    assert(mirrored.size() == bids.size());
+    for (size_t i = 0; i < bids.size(); ++i) {
+        assert(mirrored[i].price == bids[i].price);
+        assert(mirrored[i].total_quantity == bids[i].total_quantity);
+    }
+
+    std::cout << "Reader completed " << walks.load() << " full-depth walks\n";
+    std::cout << "Mirrored bid levels: " << mirrored.size() << " (book: " << bids.size() << ")\n";
+    std::cout << "\nConcurrent depth test completed!\n";
+}
+
+void test_fork_snapshot() {
+    std::cout << "\n=== FORK SNAPSHOT TEST ===\n";
+
+    const std::string path = "order_book_snapshot.bin";
+    std::vector<std::unique_ptr<OrderBook>> books;
+    std::vector<const OrderBook*> views;
+    uint64_t next_id = 1;
+    for (int b = 0; b < 4; ++b) {
+        books.push_back(std::make_unique<OrderBook>());
+        for (int i = 0; i < 2000; ++i, ++next_id) {
+            bool is_buy = i % 2 == 0;
+            double price = is_buy ? 99.0 - (i % 50) * 0.01 : 101.0 + (i % 50) * 0.01;
+            books.back()->add_order({next_id, is_buy, price, 10, next_id});
+        }
+        views.push_back(books.back().get());
+    }
+
+    std::vector<std::vector<PriceLevel>> expected_bids(books.size()), expected_asks(books.size());
+    for (size_t b = 0; b < books.size(); ++b) {
+        books[b]->get_snapshot(SIZE_MAX, expected_bids[b], expected_asks[b]);
+    }
+
+    ForkSnapshotter snapshotter;
+    const uint64_t sequence = next_id;
+    [[maybe_unused]] bool started = snapshotter.start(views, path, sequence);
+    assert(started);
+
+    std::cout << "Parent keeps matching while the child writes the snapshot...\n";
+    uint64_t processed = 0;
+    while (!snapshotter.poll()) {
+        OrderBook& book = *books[processed % books.size()];
+        bool is_buy = processed % 2 == 0;
+        double price = is_buy ? 98.0 + (processed % 100) * 0.01 : 102.0 + (processed % 100) * 0.01;
+        book.add_order({next_id, is_buy, price, 5, next_id});
+        ++next_id;
+        ++processed;
+    }
+    assert(snapshotter.stats().success);
+
+    std::vector<std::unique_ptr<OrderBook>> restored;
+    uint64_t restored_sequence = 0;
+    [[maybe_unused]] bool loaded = read_snapshot_file(path, restored, restored_sequence);
+    assert(loaded);
+    assert(restored_sequence == sequence);
+    assert(restored.size() == books.size());
+    for (size_t b = 0; b < restored.size(); ++b) {
+        std::vector<PriceLevel> bids, asks;
+        restored[b]->get_snapshot(SIZE_MAX, bids, asks);
+        assert(bids.size() == expected_bids[b].size() && asks.size() == expected_asks[b].size());
+        for (size_t i = 0; i < bids.size(); ++i) {
+            assert(bids[i].price == expected_bids[b][i].price);
+            assert(bids[i].total_quantity == expected_bids[b][i].total_quantity);
+        }
+    }
+    std::remove(path.c_str());
+
+    std::cout << "Corrupt records are rejected and leave the book empty...\n";
+    std::vector<char> image;
+    books[0]->save_snapshot(image);
+    const size_t header_size = 32;   // SnapshotHeader; no quoters registered
+    const size_t record_size = (image.size() - header_size) / books[0]->get_order_count();
+    OrderBook target;
+    auto* old_cerr = std::cerr.rdbuf(nullptr);
+    for (int corruption = 0; corruption < 2; ++corruption) {
+        std::vector<char> bad = image;
+        char* record = bad.data() + header_size + 1000 * record_size;   // past 1000 good records
+        if (corruption == 0) {
+            record[33] = 9;                                              // peg_type beyond PegType
+        } else {
+            double price = -5.0;
+            std::memcpy(record + 8, &price, sizeof(price));
+        }
+        [[maybe_unused]] bool bad_loaded = target.load_snapshot(bad.data(), bad.size());
+        assert(!bad_loaded && target.get_order_count() == 0);
+        assert(target.get_bid_levels() == 0 && target.get_ask_levels() == 0);
+    }
+    std::cerr.rdbuf(old_cerr);
+    loaded = target.load_snapshot(image.data(), image.size());   // the failed loads left it retryable
+    assert(loaded && target.get_order_count() == books[0]->get_order_count());
+
+    const auto& stats = snapshotter.stats();
+    std::cout << "Parent pause (fork): " << stats.pause_us << " us\n";
+    std::cout << "Snapshot duration: " << stats.child_duration_ms << " ms\n";
+    std::cout << "Parent minor faults during snapshot (COW): " << stats.parent_minor_faults << "\n";
+    std::cout << "Orders processed by parent meanwhile: " << processed << "\n";
+    std::cout << "Restored " << restored.size() << " books at sequence " << restored_sequence << "\n";
+    std::cout << "\nFork snapshot test completed!\n";
+}
+
+void test_small_order_book() {
+    std::cout << "\n=== SMALL ORDER BOOK TEST ===\n";
+
+    SmallOrderBook<4, 16> small;
+    OrderBook full;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> tick_dist(0, 3);
+    std::uniform_int_distribution<> qty_dist(1, 50);
+    std::uniform_int_distribution<> op_dist(0, 9);
+
+    [[maybe_unused]] auto same_state = [&]() {
+        std::vector<PriceLevel> sb, sa, fb, fa;
+        small.get_snapshot(SIZE_MAX, sb, sa);
+        full.get_snapshot(SIZE_MAX, fb, fa);
+        if (sb.size() != fb.size() || sa.size() != fa.size()) return false;
+        for (size_t i = 0; i < sb.size(); ++i) {
+            if (sb[i].price != fb[i].price || sb[i].total_quantity != fb[i].total_quantity) return false;
+        }
+        for (size_t i = 0; i < sa.size(); ++i) {
+            if (sa[i].price != fa[i].price || sa[i].total_quantity != fa[i].total_quantity) return false;
+        }
+        return small.get_order_count() == full.get_order_count();
+    };
+
+    std::cout << "Replaying the same thin-book flow into SmallOrderBook and OrderBook...\n";
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    uint64_t next_id = 1;
+    std::vector<uint64_t> live;
+    for (int step = 0; step < 400 && !small.is_spilled(); ++step) {
+        int op = op_dist(gen);
+        if (op >= 8 && !live.empty()) {
+            uint64_t id = live[gen() % live.size()];
+            bool is_buy = gen() % 2 == 0;
+            double price = is_buy ? 99.96 + tick_dist(gen) * 0.01 : 100.01 + tick_dist(gen) * 0.01;
+            uint64_t qty = qty_dist(gen);
+            [[maybe_unused]] bool small_ok = small.amend_order(id, price, qty);
+            [[maybe_unused]] bool full_ok = full.amend_order(id, price, qty);
+            assert(small_ok == full_ok);
+        } else if (op < 5 || live.empty()) {
+            bool is_buy = gen() % 2 == 0;
+            double price = is_buy ? 99.96 + tick_dist(gen) * 0.01 : 100.01 + tick_dist(gen) * 0.01;
+            uint64_t qty = qty_dist(gen);
+            small.add_order({next_id, is_buy, price, qty, next_id});
+            full.add_order({next_id, is_buy, price, qty, next_id});
+            live.push_back(next_id++);
+        } else {
+            size_t pick = gen() % live.size();
+            uint64_t id = live[pick];
+            live.erase(live.begin() + pick);
+            [[maybe_unused]] bool small_ok = small.cancel_order(id);
+            [[maybe_unused]] bool full_ok = full.cancel_order(id);
+            assert(small_ok == full_ok);
+        }
+        assert(same_state());
+    }
+    std::cout.rdbuf(saved);
+
+    std::cout << "Inline state matched the full book at every step (orders: "
+              << small.get_order_count() << ", spilled: " << (small.is_spilled() ? "yes" : "no") << ")\n";
+
+    SmallOrderBook<4, 16> overflow;
+    for (uint64_t i = 1; i <= 5; ++i) {
+        overflow.add_order({i, true, 100.0 - i * 0.01, 10, i});
+    }
+    assert(overflow.is_spilled());
+    assert(overflow.get_bid_levels() == 5);
+    assert(overflow.get_best_bid() == 99.99);
+    std::cout << "Fifth bid level spilled into a full OrderBook as expected\n";
+
+    {
+        // Same validation as OrderBook, before and after a spill
+        SmallOrderBook<2, 16> checked;
+        InstrumentParams params;
+        params.tick_size = 0.05;
+        params.lot_size = 10;
+        [[maybe_unused]] bool configured = checked.set_instrument(params);
+        assert(configured);
+        auto* old_cerr = std::cerr.rdbuf(nullptr);
+        checked.add_order({QUOTE_ORDER_ID_FLAG | 1, true, 100.0, 10, 1});   // reserved for quotes
+        checked.add_order({2, true, 100.03, 10, 2});                        // off tick
+        checked.add_order({3, true, 100.05, 15, 3});                        // odd lot
+        assert(checked.get_order_count() == 0);
+        for (uint64_t i = 1; i <= 3; ++i) {
+            checked.add_order({10 + i, true, 100.0 - i * 0.05, 10, 10 + i});
+        }
+        assert(checked.is_spilled() && checked.get_order_count() == 3);
+        assert(checked.get_instrument().tick_size == 0.05);
+        checked.add_order({20, true, 99.01, 10, 20});                       // still off tick
+        std::cerr.rdbuf(old_cerr);
+        assert(checked.get_order_count() == 3);
+        std::cout << "Quote IDs, tick and lot checks match OrderBook before and after spilling\n";
+    }
+
+    std::cout << "sizeof(SmallOrderBook<4, 16>): " << sizeof(SmallOrderBook<4, 16>) << " bytes (no heap)\n";
+    std::cout << "OrderBook order pool block alone: " << 1024 * sizeof(Order) << " bytes per book\n";
+    std::cout << "\nSmall order book test completed!\n";
+}
+
+void test_consolidated_book() {
+    std::cout << "\n=== CONSOLIDATED BOOK TEST ===\n";
+
+    const size_t venue_count = 3;
+    std::vector<std::unique_ptr<OrderBook>> venues;
+    ConsolidatedBook consolidated(venue_count);
+    for (size_t v = 0; v < venue_count; ++v) {
+        venues.push_back(std::make_unique<OrderBook>());
+        venues[v]->add_order({1, true, 99.90, 100, 1});
+        consolidated.attach(v, *venues[v]);
+    }
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> tick_dist(0, 20);
+    std::uniform_int_distribution<> qty_dist(1, 100);
+    std::vector<std::vector<uint64_t>> live(venue_count);
+    uint64_t next_id = 2;
+
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    for (int step = 0; step < 3000; ++step) {
+        size_t v = gen() % venue_count;
+        if (gen() % 3 != 0 || live[v].empty()) {
+            bool is_buy = gen() % 2 == 0;
+            double price = 99.90 + tick_dist(gen) * 0.01;
+            venues[v]->add_order({next_id, is_buy, price, static_cast<uint64_t>(qty_dist(gen)), next_id});
+            live[v].push_back(next_id++);
+        } else {
+            size_t pick = gen() % live[v].size();
+            venues[v]->cancel_order(live[v][pick]);
+            live[v].erase(live[v].begin() + pick);
+        }
+    }
+    std::cout.rdbuf(saved);
+
+    // Reference: merge full-depth snapshots from scratch
+    std::map<double, uint64_t, std::greater<double>> ref_bids;
+    std::map<double, uint64_t> ref_asks;
+    double best_bid = 0.0, best_ask = std::numeric_limits<double>::max();
+    for (const auto& book : venues) {
+        std::vector<PriceLevel> bids, asks;
+        book->get_snapshot(SIZE_MAX, bids, asks);
+        for (const auto& l : bids) ref_bids[l.price] += l.total_quantity;
+        for (const auto& l : asks) ref_asks[l.price] += l.total_quantity;
+        best_bid = std::max(best_bid, book->get_best_bid());
+        best_ask = std::min(best_ask, book->get_best_ask());
+    }
+
+    std::vector<PriceLevel> bids, asks;
+    consolidated.get_snapshot(SIZE_MAX, bids, asks);
+    assert(bids.size() == ref_bids.size() && asks.size() == ref_asks.size());
+    size_t i = 0;
+    for ([[maybe_unused]] const auto& [price, qty] : ref_bids) {
+        assert(bids[i].price == price && bids[i].total_quantity == qty);
+        ++i;
+    }
+
+    ConsolidatedBBO bbo = consolidated.get_bbo();
+    assert(bbo.bid_price == best_bid && bbo.ask_price == best_ask);
+    assert(bbo.bid_quantity == ref_bids[best_bid]);
+    assert(consolidated.get_venue_best_bid(bbo.bid_venue) == best_bid);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "NBBO: " << bbo.bid_quantity << " @ " << bbo.bid_price << " (venue " << bbo.bid_venue << ") / "
+              << bbo.ask_quantity << " @ " << bbo.ask_price << " (venue " << bbo.ask_venue << ")\n";
+    std::cout << "Merged ladder matches a from-scratch merge: " << bids.size() << " bid levels, "
+              << asks.size() << " ask levels\n";
+
+    consolidated.detach(0);
+    venues[0]->add_order({next_id, true, 50.00, 1, next_id});
+    assert(consolidated.get_venue_best_bid(0) == 0.0);
+    std::cout << "\nConsolidated book test completed!\n";
+}
+
+void test_implied_pricer() {
+    std::cout << "\n=== IMPLIED PRICER TEST ===\n";
+
+    OrderBook front, back, calendar;
+    ImpliedPricer pricer;
+    size_t o1 = pricer.add_outright();
+    size_t o2 = pricer.add_outright();
+    size_t s12 = pricer.add_spread(o1, o2);
+    pricer.attach(o1, front);
+    pricer.attach(o2, back);
+    pricer.attach(s12, calendar);
+
+    front.add_order({1, true, 100.00, 10, 1});
+    front.add_order({2, false, 100.10, 5, 2});
+    back.add_order({3, true, 99.00, 7, 3});
+    back.add_order({4, false, 99.20, 3, 4});
+
+    const ImpliedQuote& implied_spread = pricer.implied(s12);
+    assert(std::fabs(implied_spread.bid_price - 0.80) < 1e-9 && implied_spread.bid_quantity == 3);
+    assert(std::fabs(implied_spread.ask_price - 1.10) < 1e-9 && implied_spread.ask_quantity == 5);
+
+    calendar.add_order({5, true, 0.90, 4, 5});
+    assert(std::fabs(pricer.implied(o1).bid_price - 99.90) < 1e-9 && pricer.implied(o1).bid_quantity == 4);
+    assert(std::fabs(pricer.implied(o2).ask_price - 99.20) < 1e-9 && pricer.implied(o2).ask_quantity == 4);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Implied-out spread: " << implied_spread.bid_price << " / " << implied_spread.ask_price << "\n";
+    std::cout << "Implied-in front bid: " << pricer.implied(o1).bid_price
+              << ", back ask: " << pricer.implied(o2).ask_price << "\n";
+
+    std::cout << "\nBenchmark: strip of 12 outrights + 11 calendar spreads\n";
+    const int updates = 1000000;
+    for (bool incremental : {false, true}) {
+        ImpliedPricer strip;
+        std::vector<size_t> outrights;
+        for (int m = 0; m < 12; ++m) outrights.push_back(strip.add_outright());
+        for (int m = 0; m + 1 < 12; ++m) strip.add_spread(outrights[m], outrights[m + 1]);
+        strip.set_incremental(incremental);
+
+        std::mt19937 gen(11);
+        std::vector<TopOfBook> tops(4096);
+        for (auto& t : tops) {
+            t.bid_price = 100.0 + (gen() % 100) * 0.01;
+            t.ask_price = t.bid_price + 0.01 * (1 + gen() % 3);
+            t.bid_quantity = 1 + gen() % 50;
+            t.ask_quantity = 1 + gen() % 50;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < updates; ++i) {
+            strip.on_top_of_book(i % strip.instrument_count(), tops[i & 4095]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / updates;
+        std::cout << (incremental ? "Incremental:  " : "From scratch: ") << ns << " ns/update, "
+                  << static_cast<double>(strip.recomputations()) / updates << " quotes recomputed/update\n";
+
+        std::vector<ImpliedQuote> before;
+        for (size_t i = 0; i < strip.instrument_count(); ++i) before.push_back(strip.implied(i));
+        strip.recompute_all();
+        for (size_t i = 0; i < strip.instrument_count(); ++i) {
+            assert(before[i].bid_quantity == strip.implied(i).bid_quantity);
+            assert(before[i].bid_price == strip.implied(i).bid_price);
+            assert(before[i].ask_price == strip.implied(i).ask_price);
+        }
+    }
+
+    std::cout << "\nImplied pricer test completed!\n";
+}
+
+void test_clock_service() {
+    std::cout << "\n=== CLOCK SERVICE TEST ===\n";
+
+    ClockService tsc(ClockSource::Tsc);
+    ClockService cached(ClockSource::Cached);
+    ClockService realtime(ClockSource::Realtime);
+
+    uint64_t reference = ClockService::realtime_ns();
+    uint64_t from_tsc = tsc.now_ns();
+    int64_t skew = static_cast<int64_t>(from_tsc) - static_cast<int64_t>(reference);
+    assert(skew > -1000000 && skew < 1000000);
+
+    [[maybe_unused]] uint64_t last = 0;
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t t = tsc.now_ns();
+        assert(t >= last);
+        last = t;
+    }
+
+    [[maybe_unused]] uint64_t held = cached.now_ns();
+    assert(cached.now_ns() == held);
+    cached.refresh();
+    assert(cached.now_ns() >= held);
+
+    Order batch[64];
+    tsc.stamp(batch, 64);
+    assert(batch[0].timestamp_ns == batch[63].timestamp_ns && batch[0].timestamp_ns != 0);
+
+    std::cout << "TSC rate: " << std::fixed << std::setprecision(3) << tsc.ticks_per_ns() << " ticks/ns, skew vs CLOCK_REALTIME: "
+              << skew << " ns\n";
+
+    const int calls = 2000000;
+    auto bench = [&](const char* name, auto&& read) {
+        volatile uint64_t sink = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < calls; ++i) {
+            sink = read();
+        }
+        (void)sink;
+        auto end = std::chrono::high_resolution_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+        std::cout << std::setw(22) << std::left << name << std::right << std::setprecision(2) << ns << " ns/stamp\n";
+    };
+
+    bench("high_resolution_clock", [] {
+        return static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    });
+    bench("Realtime", [&] { return realtime.now_ns(); });
+    bench("Tsc", [&] { return tsc.now_ns(); });
+    bench("Cached", [&] { return cached.now_ns(); });
+
+    std::vector<Order> orders(calls / 32 * 16);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < orders.size(); i += 16) {
+        tsc.stamp(&orders[i], 16);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << std::setw(22) << std::left << "Tsc batch of 16" << std::right
+              << std::chrono::duration<double, std::nano>(end - start).count() / orders.size() << " ns/stamp\n";
+
+    std::cout << "\nClock service test completed!\n";
+}
+
+void test_amend_priority() {
+    std::cout << "\n=== AMEND PRIORITY TEST ===\n";
+
+    OrderBook book;
+    book.add_order({1, true, 100.00, 100, 1000});
+    book.add_order({2, true, 100.00, 200, 1001});
+    book.add_order({3, true, 100.00, 150, 1002});
+
+    std::cout << "Reducing order 1 keeps its place at the front...\n";
+    book.amend_order(1, 100.00, 50);
+    book.add_order({4, false, 100.00, 60, 1003});   // fills 1 (50) then 10 of 2
+    assert(book.get_order_count() == 2);
+
+    std::cout << "Increasing order 2 sends it behind order 3...\n";
+    book.amend_order(2, 100.00, 250);
+    book.add_order({5, false, 100.00, 100, 1004});  // fills 100 of 3, not of 2
+    book.cancel_order(3);
+
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(1, bids, asks);
+    assert(book.get_order_count() == 1);
+    assert(bids.size() == 1 && bids[0].total_quantity == 250);
+
+    std::cout << "Repricing through the ask trades at the resting price...\n";
+    book.add_order({6, false, 100.50, 100, 1005});
+    book.amend_order(2, 101.00, 20);                // MATCH: 20 @ 100.50
+    book.get_snapshot(1, bids, asks);
+    assert(bids.empty() && asks.size() == 1 && asks[0].total_quantity == 80);
+
+    book.print_book();
+    std::cout << "\nAmend priority test completed!\n";
+}
+
+void benchmark_amend() {
+    std::cout << "\n=== AMEND BENCHMARK ===\n";
+
+    OrderBook book;
+    const uint64_t resting = 10000;
+    for (uint64_t i = 1; i <= resting; ++i) {
+        bool is_buy = i % 2 == 0;
+        double price = is_buy ? 99.99 - (i % 100) * 0.01 : 100.01 + (i % 100) * 0.01;
+        book.add_order({i, is_buy, price, 100, i});
+    }
+
+    std::mt19937 gen(3);
+    std::vector<uint64_t> ids(1 << 16);
+    for (auto& id : ids) id = 1 + gen() % resting;
+    std::vector<uint64_t> quantity(resting + 1, 100);
+    std::vector<double> price(resting + 1);
+    for (uint64_t i = 1; i <= resting; ++i) {
+        price[i] = i % 2 == 0 ? 99.99 - (i % 100) * 0.01 : 100.01 + (i % 100) * 0.01;
+    }
+
+    const int amends = 1000000;
+    auto run = [&](const char* name, auto&& next) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < amends; ++i) {
+            uint64_t id = ids[i & 0xFFFF];
+            next(id);
+            book.amend_order(id, price[id], quantity[id]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << std::setw(24) << std::left << name << std::right << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / amends << " ns/amend\n";
+    };
+
+    run("Reduce (in place)", [&](uint64_t id) { quantity[id] = quantity[id] > 1 ? quantity[id] - 1 : 1; });
+    run("Increase (requeue)", [&](uint64_t id) { quantity[id] += 1; });
+    run("Price change", [&](uint64_t id) {
+        bool is_buy = id % 2 == 0;
+        price[id] = is_buy ? 99.99 - (gen() % 100) * 0.01 : 100.01 + (gen() % 100) * 0.01;
+    });
+
+    assert(book.get_order_count() == resting);
+    std::cout << "\nAmend benchmark completed!\n";
+}
+
+void test_mass_quote() {
+    std::cout << "\n=== MASS QUOTE TEST ===\n";
+
+    OrderBook book;
+    uint32_t mm = book.register_quoter(5);
+
+    std::vector<QuoteEntry> quotes;
+    for (int i = 0; i < 5; ++i) {
+        quotes.push_back({99.99 - i * 0.01, 100, 100.01 + i * 0.01, 100});
+    }
+    [[maybe_unused]] bool ok = book.mass_quote(mm, quotes, 1);
+    assert(ok);
+    assert(book.get_order_count() == 10 && book.get_bid_levels() == 5 && book.get_ask_levels() == 5);
+
+    std::cout << "Requoting with one changed size per side...\n";
+    [[maybe_unused]] uint64_t version = book.get_version();
+    quotes[0].bid_quantity = 50;
+    quotes[4].ask_quantity = 300;
+    book.mass_quote(mm, quotes, 2);
+    assert(book.get_version() == version + 1);
+
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(5, bids, asks);
+    assert(bids[0].total_quantity == 50 && asks[4].total_quantity == 300);
+
+    std::cout << "A fill frees the slot; the next refresh re-posts it...\n";
+    book.add_order({1, false, 99.99, 50, 3});
+    assert(book.get_order_count() == 9);
+    book.mass_quote(mm, quotes, 4);
+    assert(book.get_order_count() == 10);
+
+    std::cout << "Shrinking the quote set pulls the remaining levels...\n";
+    quotes.resize(2);
+    book.mass_quote(mm, quotes, 5);
+    assert(book.get_order_count() == 4);
+    book.cancel_quotes(mm);
+    assert(book.get_order_count() == 0);
+
+    std::cout << "Rejecting a quote set with an invalid price leaves the book unchanged...\n";
+    book.mass_quote(mm, quotes, 6);
+    quotes[1].ask_price = -1.0;
+    [[maybe_unused]] bool accepted = book.mass_quote(mm, quotes, 7);
+    assert(!accepted);
+    assert(book.get_order_count() == 4);
+
+    std::cout << "Restored quote orders keep their slots across a snapshot...\n";
+    std::vector<char> image;
+    book.save_snapshot(image);
+    OrderBook restored;
+    [[maybe_unused]] bool loaded = restored.load_snapshot(image.data(), image.size());
+    assert(loaded && restored.get_order_count() == 4);
+    quotes[1].ask_price = 100.05;
+    [[maybe_unused]] bool requoted = restored.mass_quote(mm, quotes, 8);   // updates the restored orders in place
+    assert(requoted && restored.get_order_count() == 4 && restored.get_ask_levels() == 2);
+    [[maybe_unused]] bool pulled = restored.cancel_quotes(mm);
+    assert(pulled && restored.get_order_count() == 0);
+    assert(restored.get_bid_levels() == 0 && restored.get_ask_levels() == 0);
+
+    std::cout << "\nBenchmark: refresh 10 two-sided levels per tick\n";
+    const int ticks = 100000;
+    const int levels = 10;
+    std::mt19937 gen(5);
+    std::vector<int> moves(1024);
+    for (auto& m : moves) m = static_cast<int>(gen() % 3);
+
+    {
+        OrderBook quoted;
+        uint32_t q = quoted.register_quoter(levels);
+        std::vector<QuoteEntry> set(levels);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int t = 0; t < ticks; ++t) {
+            double mid = 100.0 + moves[t & 1023] * 0.01;
+            for (int i = 0; i < levels; ++i) {
+                set[i] = {mid - 0.05 - i * 0.01, static_cast<uint64_t>(100 + (t + i) % 7),
+                          mid + 0.05 + i * 0.01, static_cast<uint64_t>(100 + (t + i) % 5)};
+            }
+            quoted.mass_quote(q, set, static_cast<uint64_t>(t));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "mass_quote:          " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / ticks << " ns/tick\n";
+    }
+    {
+        OrderBook quoted;
+        for (int i = 0; i < levels; ++i) {
+            quoted.add_order({static_cast<uint64_t>(2 * i + 1), true, 99.95 - i * 0.01, 100, 0});
+            quoted.add_order({static_cast<uint64_t>(2 * i + 2), false, 100.05 + i * 0.01, 100, 0});
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int t = 0; t < ticks; ++t) {
+            double mid = 100.0 + moves[t & 1023] * 0.01;
+            for (int i = 0; i < levels; ++i) {
+                quoted.amend_order(2 * i + 1, mid - 0.05 - i * 0.01, 100 + (t + i) % 7);
+                quoted.amend_order(2 * i + 2, mid + 0.05 + i * 0.01, 100 + (t + i) % 5);
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "amend_order per side: "
+                  << std::chrono::duration<double, std::nano>(end - start).count() / ticks << " ns/tick\n";
+    }
+
+    std::cout << "\nMass quote test completed!\n";
+}
+
+void test_pegged_orders() {
+    std::cout << "\n=== PEGGED ORDERS TEST ===\n";
+
+    OrderBook book;
+    book.add_order({1, true, 99.90, 100, 1});
+    book.add_order({2, false, 100.10, 100, 2});
+
+    std::cout << "Midpoint buy and sell pegs cross each other at the mid...\n";
+    book.add_pegged_order({10, true, 0.0, 50, 3}, PegType::Midpoint);
+    book.add_pegged_order({11, false, 0.0, 30, 4}, PegType::Midpoint);   // MATCH: 30 @ 100.00
+    assert(book.get_order_count() == 3);
+
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(5, bids, asks);
+    assert(bids.size() == 1 && bids[0].price == 99.90 && bids[0].total_quantity == 100);
+
+    std::cout << "Pegs stay hidden and reprice lazily as the BBO moves...\n";
+    book.add_pegged_order({12, false, 0.0, 10, 5}, PegType::Primary, 0.05);
+    book.add_pegged_order({13, true, 100.05, 40, 6}, PegType::Market);   // capped below the ask
+    assert(book.get_order_count() == 5 && book.get_best_ask() == 100.10);
+
+    book.add_order({20, false, 100.05, 25, 7});                           // MATCH: 25 @ 100.05 vs peg 13
+    assert(book.get_order_count() == 5);
+    assert(book.get_best_ask() == 100.10);
+
+    std::cout << "Cancelling the lit bid leaves pegs without a midpoint...\n";
+    book.cancel_order(1);
+    book.add_order({21, false, 100.08, 5, 8});                            // above the market peg cap, rests
+    assert(book.get_order_count() == 5);
+
+    std::cout << "Derived peg prices stay on the tick grid...\n";
+    OrderBook ticked;
+    InstrumentParams params;
+    params.tick_size = 0.05;
+    [[maybe_unused]] bool configured = ticked.set_instrument(params);
+    assert(configured);
+    ticked.add_order({1, true, 99.90, 100, 1});
+    ticked.add_order({2, false, 100.05, 100, 2});
+    ticked.add_pegged_order({30, true, 0.0, 10, 3}, PegType::Midpoint);    // mid 99.975 -> 99.95
+    ticked.add_pegged_order({31, false, 0.0, 10, 4}, PegType::Midpoint);   // mid 99.975 -> 100.00, no cross
+    assert(ticked.get_order_count() == 4);
+
+    std::cout << "Pegs with different caps share a group; emptied groups are freed...\n";
+    ticked.cancel_order(30);
+    ticked.cancel_order(31);
+    ticked.add_pegged_order({32, true, 100.00, 10, 5}, PegType::Market);
+    ticked.add_pegged_order({33, true, 99.95, 10, 6}, PegType::Market);
+    ticked.add_order({40, false, 100.00, 15, 7});   // MATCH: 10 vs peg 32; peg 33 is capped below
+    assert(ticked.get_order_count() == 4);
+    [[maybe_unused]] bool amended = ticked.amend_order(33, 99.95, 2);
+    uint64_t ahead = 1;
+    [[maybe_unused]] bool queued = ticked.get_queue_position(33, ahead);
+    assert(amended && queued && ahead == 0);
+
+    std::cout << "Amending a peg's price to 0 removes its cap...\n";
+    auto* old_cerr = std::cerr.rdbuf(nullptr);
+    [[maybe_unused]] bool limit_uncapped = ticked.amend_order(40, 0.0, 5);   // a limit order still needs a valid price
+    std::cerr.rdbuf(old_cerr);
+    [[maybe_unused]] size_t before_uncap = ticked.get_order_count();
+    [[maybe_unused]] bool uncapped = ticked.amend_order(33, 0.0, 2);          // MATCH: peg 33 now follows the ask to 100.00
+    assert(!limit_uncapped && uncapped && ticked.get_order_count() == before_uncap - 1);
+
+    std::cout << "Pegged orders survive a snapshot round trip...\n";
+    std::vector<char> image;
+    book.save_snapshot(image);
+    OrderBook restored;
+    restored.load_snapshot(image.data(), image.size());
+    assert(restored.get_order_count() == book.get_order_count());
+
+    std::cout << "\nBenchmark: cost of a BBO move vs number of resting pegs\n";
+    for (uint64_t pegs : {0, 1000, 10000}) {
+        OrderBook pegged;
+        pegged.add_order({1, true, 99.90, 100, 1});
+        pegged.add_order({2, false, 100.10, 100, 2});
+        for (uint64_t i = 0; i < pegs; ++i) {
+            pegged.add_pegged_order({100 + i, true, 0.0, 10, 3 + i}, PegType::Midpoint, 0.01 * (1 + i % 4));
+        }
+
+        const int moves = 200000;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int m = 0; m < moves; ++m) {
+            uint64_t id = 1000000 + m;
+            pegged.add_order({id, true, 99.95, 10, id});
+            pegged.cancel_order(id);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << std::setw(6) << pegs << " pegs (4 groups): " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / (2 * moves) << " ns per BBO move\n";
+    }
+
+    std::cout << "\nPegged orders test completed!\n";
+}
+
+void test_lazy_cancel() {
+    std::cout << "\n=== LAZY CANCEL TEST ===\n";
+
+    OrderBook book;
+    book.set_lazy_cancel(true);
+    book.add_order({1, false, 100.00, 10, 1});
+    book.add_order({2, false, 100.00, 20, 2});
+    book.add_order({3, false, 100.00, 30, 3});
+    book.cancel_order(1);
+    book.cancel_order(2);
+    assert(book.get_pending_cancel_count() == 2);
+    assert(book.get_top_of_book().ask_quantity == 30 && book.get_order_count() == 1);
+
+    std::cout << "Aggressor skips the flagged orders at the head of the queue...\n";
+    book.add_order({4, true, 100.00, 5, 4});     // MATCH: 5 @ 100.00 vs order 3
+    assert(book.get_pending_cancel_count() == 0);
+    assert(book.get_top_of_book().ask_quantity == 25);
+
+    book.add_order({5, false, 100.00, 10, 5});
+    book.cancel_order(5);
+    [[maybe_unused]] size_t swept = book.sweep_cancelled_orders();
+    assert(swept == 1 && book.get_pending_cancel_count() == 0);
+
+    std::cout << "A level holding only cancelled orders is hidden until the sweep...\n";
+    std::streambuf* saved_err = std::cerr.rdbuf(nullptr);
+    book.add_order({6, false, 100.05, 10, 6});
+    book.cancel_order(6);
+    [[maybe_unused]] bool cancelled_twice = book.cancel_order(6);
+    uint64_t ahead = 0;
+    [[maybe_unused]] bool queued = book.get_queue_position(6, ahead);
+    std::cerr.rdbuf(saved_err);
+    assert(!cancelled_twice && !queued);
+    assert(book.get_ask_levels() == 1 && book.get_order_count() == 1);
+    book.add_order({6, false, 100.05, 20, 7});   // the id is free again, as with eager cancel
+    assert(book.get_ask_levels() == 2 && book.get_order_count() == 2 && book.get_pending_cancel_count() == 1);
+    swept = book.sweep_cancelled_orders();
+    assert(swept == 1 && book.get_order_count() == 2);
+    book.cancel_order(6);
+    swept = book.sweep_cancelled_orders();
+    assert(swept == 1 && book.get_ask_levels() == 1 && book.get_order_count() == 1);
+
+    std::cout << "Replaying the same flow into lazy and eager books...\n";
+    OrderBook lazy, eager;
+    lazy.set_lazy_cancel(true);
+    std::mt19937 gen(13);
+    std::uniform_int_distribution<> tick_dist(0, 9);
+    std::uniform_int_distribution<> qty_dist(1, 100);
+    std::uniform_int_distribution<> op_dist(0, 9);
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    uint64_t next_id = 1;
+    std::vector<uint64_t> live;
+    std::vector<char> lazy_image, eager_image;
+    for (int step = 0; step < 5000; ++step) {
+        int op = op_dist(gen);
+        if (op < 5 || live.empty()) {
+            bool is_buy = gen() % 2 == 0;
+            double price = is_buy ? 99.95 + tick_dist(gen) * 0.01 : 100.00 + tick_dist(gen) * 0.01;
+            uint64_t qty = qty_dist(gen);
+            lazy.add_order({next_id, is_buy, price, qty, next_id});
+            eager.add_order({next_id, is_buy, price, qty, next_id});
+            live.push_back(next_id++);
+        } else if (op < 9) {
+            size_t pick = gen() % live.size();
+            uint64_t id = live[pick];
+            live.erase(live.begin() + pick);
+            [[maybe_unused]] bool lazy_ok = lazy.cancel_order(id);
+            [[maybe_unused]] bool eager_ok = eager.cancel_order(id);
+            assert(lazy_ok == eager_ok);
+        } else {
+            uint64_t id = live[gen() % live.size()];
+            double price = 99.95 + tick_dist(gen) * 0.01;
+            uint64_t qty = qty_dist(gen);
+            lazy.amend_order(id, price, qty);
+            eager.amend_order(id, price, qty);
+        }
+        if (step % 64 == 0) {
+            lazy.sweep_cancelled_orders(8);
+        }
+        lazy.save_snapshot(lazy_image);
+        eager.save_snapshot(eager_image);
+        assert(lazy_image == eager_image);
+    }
+    std::cout.rdbuf(saved);
+    std::cout << "Snapshots matched at every step (" << lazy.get_order_count() << " orders, "
+              << lazy.get_pending_cancel_count() << " cancels pending)\n";
+    lazy.set_lazy_cancel(false);
+    assert(lazy.get_pending_cancel_count() == 0);
+
+    std::cout << "\nBenchmark: cancelling 100000 resting orders in random order\n";
+    const uint64_t resting = 100000;
+    std::vector<uint64_t> order(resting);
+    for (uint64_t i = 0; i < resting; ++i) order[i] = i + 1;
+    std::shuffle(order.begin(), order.end(), gen);
+    for (bool lazy_mode : {false, true}) {
+        OrderBook bench;
+        bench.set_lazy_cancel(lazy_mode);
+        for (uint64_t i = 1; i <= resting; ++i) {
+            bool is_buy = i % 2 == 0;
+            bench.add_order({i, is_buy, is_buy ? 99.99 - (i % 50) * 0.01 : 100.01 + (i % 50) * 0.01, 100, i});
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < resting - 100; ++i) {
+            bench.cancel_order(order[i]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        size_t swept = bench.sweep_cancelled_orders();
+        auto swept_at = std::chrono::high_resolution_clock::now();
+        std::cout << std::setw(6) << (lazy_mode ? "Lazy" : "Eager") << ": " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / (resting - 100) << " ns/cancel";
+        if (lazy_mode) {
+            std::cout << ", sweep of " << swept << " orders " 
+                      << std::chrono::duration<double, std::micro>(swept_at - end).count() << " us";
+        }
+        std::cout << "\n";
+        assert(bench.get_order_count() == 100);
+    }
+
+    std::cout << "\nLazy cancel test completed!\n";
+}
+
+void test_level_queues() {
+    std::cout << "\n=== LEVEL QUEUE TEST ===\n";
+    std::cout << "Level queue representation: "
+              << (ORDER_BOOK_CONTIGUOUS_LEVELS ? "contiguous vector" : "linked list") << "\n";
+
+    OrderBook book;
+    for (uint64_t i = 1; i <= 5; ++i) {
+        book.add_order({i, true, 100.00, i * 10, i});
+    }
+    uint64_t ahead = 0;
+    assert(book.get_queue_position(5, ahead) && ahead == 100);
+    book.cancel_order(2);
+    assert(book.get_queue_position(5, ahead) && ahead == 80);
+    book.amend_order(1, 100.00, 5);                  // reduction keeps its place
+    assert(book.get_queue_position(3, ahead) && ahead == 5);
+    book.amend_order(3, 100.00, 40);                 // increase goes to the tail
+    assert(book.get_queue_position(3, ahead) && ahead == 95);
+    assert(book.get_queue_position(1, ahead) && ahead == 0);
+
+    book.set_lazy_cancel(true);
+    book.cancel_order(4);
+    assert(book.get_queue_position(3, ahead) && ahead == 55);
+    book.add_order({6, false, 100.00, 60, 6});       // MATCH: 5 + 50 + 5 @ 100.00
+    assert(book.get_queue_position(3, ahead) && ahead == 0);
+    assert(book.get_top_of_book().bid_quantity == 35);
+
+    std::cout << "\nBenchmark: 5000-order levels built round-robin across 16 prices\n";
+    const uint64_t per_level = 5000;
+    const uint64_t levels = 16;
+    OrderBook deep;
+    for (uint64_t i = 0; i < per_level * levels; ++i) {
+        deep.add_order({i + 1, true, 90.00 + (i % levels) * 0.01, 10, i + 1});
+    }
+    std::vector<uint64_t> ids(per_level * levels);
+    for (uint64_t i = 0; i < ids.size(); ++i) ids[i] = i + 1;
+    std::mt19937 gen(17);
+    std::shuffle(ids.begin(), ids.end() - levels, gen);
+    for (uint64_t i = 0; i < ids.size() / 2; ++i) {
+        deep.cancel_order(ids[i]);
+    }
+
+    uint64_t last_id = per_level * levels;
+    const int scans = 200;
+    uint64_t total_ahead = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < scans; ++i) {
+        deep.get_queue_position(last_id - (i % levels), ahead);
+        total_ahead += ahead;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Queue position of the last order: " << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::micro>(end - start).count() / scans << " us/scan\n";
+
+    size_t resting = deep.get_order_count();
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    start = std::chrono::high_resolution_clock::now();
+    deep.add_order({last_id + 1, false, 90.00, resting * 10, last_id + 1});
+    end = std::chrono::high_resolution_clock::now();
+    std::cout.rdbuf(saved);
+    std::cout << "Sweeping " << resting << " resting orders: " << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::nano>(end - start).count() / resting << " ns/fill\n";
+    assert(deep.get_bid_levels() == 0 && total_ahead > 0);
+
+    std::cout << "\nLevel queue test completed!\n";
+}
+
+void test_bplus_tree() {
+    std::cout << "\n=== B+TREE LEVEL INDEX TEST ===\n";
+
+    // Sparse prices: log-uniform over the whole valid range, on a 0.01 grid
+    std::mt19937 gen(19);
+    std::uniform_real_distribution<> exponent(-2.0, 6.0);
+    auto sparse_price = [&]() { return std::max(0.01, std::round(std::pow(10.0, exponent(gen)) * 100.0) / 100.0); };
+
+    std::cout << "Replaying random inserts and erases into BPlusTree and std::map...\n";
+    BPlusTree<uint64_t, true> tree;
+    std::map<double, uint64_t, std::greater<double>> ref;
+    for (int step = 0; step < 200000; ++step) {
+        double price = sparse_price();
+        if (gen() % 3 != 0) {
+            tree[price] = step;
+            ref[price] = step;
+        } else if (!ref.empty()) {
+            // Erase the best level or a looked-up one, as the book does
+            auto victim = ref.begin();
+            if (gen() % 2) {
+                victim = ref.lower_bound(price);
+                if (victim == ref.end()) victim = ref.begin();
+            }
+            auto it = victim == ref.begin() ? tree.begin() : tree.find(victim->first);
+            assert(it != tree.end() && it->first == victim->first);
+            tree.erase(it);
+            ref.erase(victim);
+        }
+        assert(tree.size() == ref.size());
+        assert((tree.find(price) == tree.end()) == (ref.find(price) == ref.end()));
+    }
+    auto rit = ref.begin();
+    for ([[maybe_unused]] const auto& [price, value] : tree) {
+        assert(rit != ref.end() && rit->first == price && rit->second == value);
+        ++rit;
+    }
+    assert(rit == ref.end());
+    std::cout << "Contents and order matched (" << tree.size() << " levels)\n";
+
+    std::cout << "\nBenchmark: 100000 sparse levels\n";
+    const size_t level_count = 100000;
+    std::vector<double> prices;
+    std::map<double, int> unique;
+    while (unique.size() < level_count) {
+        unique[sparse_price()] = 0;
+    }
+    for (const auto& [price, unused] : unique) prices.push_back(price);
+    std::shuffle(prices.begin(), prices.end(), gen);
+
+    auto bench = [&](const char* name, auto& index) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (double p : prices) index[p] = 1;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        uint64_t found = 0;
+        for (int r = 0; r < 10; ++r) {
+            for (double p : prices) found += index.find(p) != index.end();
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        uint64_t walked = 0;
+        for (int r = 0; r < 10; ++r) {
+            for (const auto& entry : index) walked += entry.second;
+        }
+        auto t3 = std::chrono::high_resolution_clock::now();
+        // Touch flicker: the best level empties and comes back
+        for (int r = 0; r < 1000000; ++r) {
+            double best = index.begin()->first;
+            index.erase(index.begin());
+            index[best] = 1;
+        }
+        auto t4 = std::chrono::high_resolution_clock::now();
+        assert(found == 10 * level_count && walked == 10 * level_count);
+        auto ns = [](auto a, auto b) { return std::chrono::duration<double, std::nano>(b - a).count(); };
+        std::cout << std::setw(10) << std::left << name << std::right << std::fixed << std::setprecision(1)
+                  << " insert " << std::setw(6) << ns(t0, t1) / level_count << " ns"
+                  << "  find " << std::setw(6) << ns(t1, t2) / (10 * level_count) << " ns"
+                  << "  walk " << std::setw(5) << ns(t2, t3) / (10 * level_count) << " ns/level"
+                  << "  touch churn " << std::setw(5) << ns(t3, t4) / 1000000 << " ns"
+                  << "  (checksum " << found + walked << ")\n";   // keeps find and walk live under NDEBUG
+    };
+    {
+        std::map<double, uint64_t, std::greater<double>> map_index;
+        bench("std::map", map_index);
+    }
+    {
+        BPlusTree<uint64_t, true> tree_index;
+        bench("BPlusTree", tree_index);
+    }
+
+    std::cout << "\nB+tree level index test completed!\n";
+}
+
+void test_level_retention() {
+    std::cout << "\n=== LEVEL RETENTION TEST ===\n";
+
+    OrderBook book;
+    book.set_level_retention(2);
+    book.add_order({1, true, 99.99, 10, 1});
+    book.add_order({2, true, 100.00, 10, 2});
+    book.cancel_order(2);                       // 100.00 retained but hidden
+    assert(book.get_best_bid() == 99.99 && book.get_bid_levels() == 1);
+    book.add_order({3, true, 100.00, 15, 3});   // reuses the retained level
+    assert(book.get_best_bid() == 100.00 && book.get_top_of_book().bid_quantity == 15);
+    book.add_order({4, false, 100.00, 15, 4});  // MATCH: 15 @ 100.00, level retained again
+    assert(book.get_best_bid() == 99.99 && book.get_bid_levels() == 1 && book.get_ask_levels() == 0);
+
+    std::cout << "Replaying the same flow with and without retention...\n";
+    OrderBook retained, plain;
+    retained.set_level_retention(4);
+    std::mt19937 gen(23);
+    std::uniform_int_distribution<> tick_dist(0, 7);
+    std::uniform_int_distribution<> qty_dist(1, 50);
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    uint64_t next_id = 1;
+    std::vector<uint64_t> live;
+    std::vector<char> retained_image, plain_image;
+    for (int step = 0; step < 5000; ++step) {
+        if (gen() % 2 == 0 || live.empty()) {
+            bool is_buy = gen() % 2 == 0;
+            double price = is_buy ? 99.97 + tick_dist(gen) * 0.01 : 100.00 + tick_dist(gen) * 0.01;
+            uint64_t qty = qty_dist(gen);
+            retained.add_order({next_id, is_buy, price, qty, next_id});
+            plain.add_order({next_id, is_buy, price, qty, next_id});
+            live.push_back(next_id++);
+        } else {
+            size_t pick = gen() % live.size();
+            uint64_t id = live[pick];
+            live.erase(live.begin() + pick);
+            retained.cancel_order(id);
+            plain.cancel_order(id);
+        }
+        std::vector<PriceLevel> rb, ra, pb, pa;
+        retained.get_snapshot(SIZE_MAX, rb, ra);
+        plain.get_snapshot(SIZE_MAX, pb, pa);
+        assert(rb.size() == pb.size() && ra.size() == pa.size());
+        for (size_t i = 0; i < rb.size(); ++i) {
+            assert(rb[i].price == pb[i].price && rb[i].total_quantity == pb[i].total_quantity);
+        }
+        for (size_t i = 0; i < ra.size(); ++i) {
+            assert(ra[i].price == pa[i].price && ra[i].total_quantity == pa[i].total_quantity);
+        }
+        assert(retained.get_top_of_book() == plain.get_top_of_book());
+        assert(retained.get_bid_levels() == plain.get_bid_levels() && retained.get_ask_levels() == plain.get_ask_levels());
+        retained.save_snapshot(retained_image);
+        plain.save_snapshot(plain_image);
+        assert(retained_image == plain_image);
+    }
+    std::cout.rdbuf(saved);
+    std::cout << "Displayed state matched at every step\n";
+
+    std::cout << "\nBenchmark: new best bid that is placed and cancelled, 500 levels per side\n";
+    for (size_t retention : {0, 4}) {
+        OrderBook flicker;
+        flicker.set_level_retention(retention);
+        for (uint64_t i = 1; i <= 500; ++i) {
+            flicker.add_order({i, true, 99.99 - i * 0.01, 10, i});
+            flicker.add_order({1000 + i, false, 100.01 + i * 0.01, 10, 1000 + i});
+        }
+        const int cycles = 1000000;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int c = 0; c < cycles; ++c) {
+            uint64_t id = 10000 + c;
+            flicker.add_order({id, true, 100.00, 10, id});
+            flicker.cancel_order(id);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Retention " << retention << ": " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / cycles << " ns per add+cancel\n";
+    }
+
+    std::cout << "\nLevel retention test completed!\n";
+}
+
+void test_conflation() {
+    std::cout << "\n=== CONFLATION TEST ===\n";
+
+    const size_t symbols = 8;
+    std::vector<std::unique_ptr<OrderBook>> books;
+    ConflatingPublisher publisher(symbols);
+    for (size_t i = 0; i < symbols; ++i) {
+        books.push_back(std::make_unique<OrderBook>());
+        [[maybe_unused]] uint32_t id = publisher.attach(*books.back());
+        assert(id == i);
+    }
+
+    uint32_t symbol;
+    ConflatedBook state;
+    size_t initial = 0;
+    while (publisher.poll(symbol, state)) {
+        initial++;
+    }
+    assert(initial == symbols);
+
+    std::cout << "Deep levels outside the top " << CONFLATED_DEPTH << " do not publish...\n";
+    for (uint64_t i = 1; i <= CONFLATED_DEPTH; ++i) {
+        books[0]->add_order({i, true, 100.00 - i * 0.01, 10, i});
+    }
+    [[maybe_unused]] bool polled = publisher.poll(symbol, state);
+    assert(polled && symbol == 0 && state.bid_count == CONFLATED_DEPTH);
+    polled = publisher.poll(symbol, state);
+    assert(!polled);                            // five operations, one dirty entry
+    books[0]->add_order({100, true, 90.00, 10, 100});
+    polled = publisher.poll(symbol, state);
+    assert(!polled);
+
+    std::cout << "Slow consumer drains while the producer runs flat out...\n";
+    std::atomic<bool> done{false};
+    uint64_t consumed = 0;
+    bool consistent = true;
+    std::thread consumer([&]() {
+        uint32_t id;
+        ConflatedBook latest;
+        while (true) {
+            bool finished = done.load(std::memory_order_acquire);
+            bool got = false;
+            while (publisher.poll(id, latest)) {
+                got = true;
+                consumed++;
+                // Every state is a settled book: sorted and never crossed
+                for (uint32_t l = 1; l < latest.bid_count; ++l) consistent &= latest.bids[l].price < latest.bids[l - 1].price;
+                for (uint32_t l = 1; l < latest.ask_count; ++l) consistent &= latest.asks[l].price > latest.asks[l - 1].price;
+                if (latest.bid_count && latest.ask_count) consistent &= latest.bids[0].price < latest.asks[0].price;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            if (finished && !got) {
+                break;
+            }
+        }
+    });
+
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    std::mt19937 gen(29);
+    std::uniform_int_distribution<> tick_dist(0, 9);
+    std::uniform_int_distribution<> qty_dist(1, 100);
+    const int operations = 200000;
+    uint64_t next_id = 1000;
+    for (int op = 0; op < operations; ++op) {
+        OrderBook& book = *books[gen() % symbols];
+        bool is_buy = gen() % 2 == 0;
+        double price = is_buy ? 99.95 + tick_dist(gen) * 0.01 : 100.00 + tick_dist(gen) * 0.01;
+        book.add_order({next_id, is_buy, price, static_cast<uint64_t>(qty_dist(gen)), next_id});
+        next_id++;
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    std::cout.rdbuf(saved);
+
+    uint64_t published = 0;
+    for (size_t i = 0; i < symbols; ++i) {
+        publisher.read(static_cast<uint32_t>(i), state);
+        published += state.publish_count;
+        std::vector<PriceLevel> bids, asks;
+        books[i]->get_snapshot(CONFLATED_DEPTH, bids, asks);
+        assert(state.version <= books[i]->get_version() && state.bid_count == bids.size() && state.ask_count == asks.size());
+        for (size_t l = 0; l < bids.size(); ++l) {
+            assert(state.bids[l].price == bids[l].price && state.bids[l].total_quantity == bids[l].total_quantity);
+        }
+        for (size_t l = 0; l < asks.size(); ++l) {
+            assert(state.asks[l].price == asks[l].price && state.asks[l].total_quantity == asks[l].total_quantity);
+        }
+    }
+    assert(consistent);
+    std::cout << operations << " operations, " << published << " states published, "
+              << consumed << " delivered to the slow consumer\n";
+    std::cout << "Final conflated state matches every book\n";
+    std::cout << "\nConflation test completed!\n";
+}
+
+// Random add/cancel/amend flow around 100.00; `between` runs after every
+// operation, where an event loop would do its other work
+template<typename Between>
+static void run_random_flow(OrderBook& book, std::mt19937& gen, uint64_t& next_id, int operations, Between&& between) {
+    std::uniform_int_distribution<> tick_dist(0, 19);
+    std::uniform_int_distribution<> qty_dist(1, 100);
+    for (int op = 0; op < operations; ++op) {
+        int action = gen() % 10;
+        if (action < 6 || next_id < 1100) {
+            bool is_buy = gen() % 2 == 0;
+            double price = is_buy ? 99.90 + tick_dist(gen) * 0.01 : 100.00 + tick_dist(gen) * 0.01;
+            book.add_order({next_id, is_buy, price, static_cast<uint64_t>(qty_dist(gen)), next_id});
+            next_id++;
+        } else if (action < 9) {
+            book.cancel_order(1000 + gen() % (next_id - 1000));
+        } else {
+            uint64_t id = 1000 + gen() % (next_id - 1000);
+            double price = 99.95 + tick_dist(gen) * 0.005;
+            book.amend_order(id, price, static_cast<uint64_t>(qty_dist(gen)));
+        }
+        between();
+    }
+}
+
+[[maybe_unused]] static bool levels_match(const OrderBook& book, const std::vector<PriceLevel>& client_bids,
+                         const std::vector<PriceLevel>& client_asks) {
+    std::vector<PriceLevel> bids, asks;
+    book.get_snapshot(SIZE_MAX, bids, asks);
+    if (bids.size() != client_bids.size() || asks.size() != client_asks.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bids.size(); ++i) {
+        if (bids[i].price != client_bids[i].price || bids[i].total_quantity != client_bids[i].total_quantity) return false;
+    }
+    for (size_t i = 0; i < asks.size(); ++i) {
+        if (asks[i].price != client_asks[i].price || asks[i].total_quantity != client_asks[i].total_quantity) return false;
+    }
+    return true;
+}
+
+void test_recovery() {
+    std::cout << "\n=== SNAPSHOT RECOVERY TEST ===\n";
+
+    const std::string name = "/order_book_recovery_" + std::to_string(getpid());
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    std::streambuf* saved_err = std::cerr.rdbuf(nullptr); // random cancels of filled ids
+
+    RecoveryClient missing;
+    [[maybe_unused]] bool opened = missing.open(name);
+    assert(!opened);
+
+    for (size_t ring : {size_t(1) << 16, size_t(64)}) {
+        bool slow = ring == 64;
+        OrderBook book;
+        RecoveryServer server;
+        opened = server.open(name, book, ring);
+        assert(opened);
+
+        std::mt19937 gen(31);
+        uint64_t next_id = 1000;
+        run_random_flow(book, gen, next_id, 5000, [&]() { server.poll(); });
+
+        // Late joiner: attaches mid-stream on its own thread and follows it
+        std::atomic<bool> done{false};
+        std::atomic<uint64_t> final_sequence{0};
+        RecoveryClient client;
+        opened = client.open(name);
+        assert(opened);
+        std::thread follower([&]() {
+            while (true) {
+                client.poll();
+                uint64_t target = final_sequence.load(std::memory_order_acquire);
+                if (done.load(std::memory_order_acquire) && client.is_live() && client.sequence() == target) {
+                    break;
+                }
+                if (slow) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            }
+        });
+
+        run_random_flow(book, gen, next_id, 20000, [&]() { server.poll(); });
+        final_sequence.store(server.sequence(), std::memory_order_release);
+        done.store(true, std::memory_order_release);
+        // Keep serving snapshot requests until the follower has caught up
+        while (!(client.is_live() && client.sequence() == server.sequence())) {
+            server.poll();
+            std::this_thread::yield();
+        }
+        follower.join();
+
+        std::cout.rdbuf(saved);
+        std::vector<PriceLevel> bids, asks;
+        client.get_snapshot(SIZE_MAX, bids, asks);
+        assert(levels_match(book, bids, asks));
+        if (slow) {
+            assert(client.gaps() > 0 && client.recoveries() == client.gaps() + 1);
+        } else {
+            assert(client.recoveries() == 1 && client.gaps() == 0);
+        }
+        std::cout << (slow ? "Slow follower on a 64-delta ring: " : "Late joiner on a 64K-delta ring: ")
+                  << server.sequence() << " deltas, " << client.recoveries() << " recoveries, "
+                  << client.gaps() << " gaps, " << server.snapshots_served() << " snapshots served\n";
+        std::cout.rdbuf(nullptr);
+    }
+
+    std::cout.rdbuf(saved);
+    std::cerr.rdbuf(saved_err);
+    std::cout << "Recovered views match the book level for level\n";
+
+    std::cout << "Snapshot images aggregate to the book's levels without a book...\n";
+    OrderBook book;
+    book.add_order({1, true, 99.90, 10, 1});
+    book.add_order({2, true, 99.90, 15, 2});
+    book.add_order({3, true, 99.80, 5, 3});
+    book.add_order({4, false, 100.10, 7, 4});
+    book.add_order({5, false, 100.20, 8, 5});
+    book.add_pegged_order({6, true, 0.0, 20, 6}, PegType::Primary);   // not displayed
+    std::vector<char> image;
+    book.save_snapshot(image);
+    std::vector<PriceLevel> bids, asks;
+    [[maybe_unused]] bool aggregated = OrderBook::snapshot_levels(image.data(), image.size(), bids, asks);
+    assert(aggregated && bids.size() == 2 && asks.size() == 2);
+    assert(bids[0].price == 99.90 && bids[0].total_quantity == 25 && asks[1].total_quantity == 8);
+    assert(levels_match(book, bids, asks));
+    std::cout << "\nSnapshot recovery test completed!\n";
+}
+
+void test_market_data_publisher() {
+    std::cout << "\n=== MICRO-BATCHED PUBLISHER TEST ===\n";
+
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    std::streambuf* saved_err = std::cerr.rdbuf(nullptr);
+
+    MarketDataReceiver receiver;
+    [[maybe_unused]] bool opened = receiver.open();
+    assert(opened);
+    std::vector<DeltaMessage> received;
+
+    // A lone update waits for the deadline rather than a full packet
+    {
+        OrderBook book;
+        MarketDataPublisher publisher;
+        PublisherConfig config;
+        config.flush_interval_ns = 1000000;
+        opened = publisher.open(book, receiver.port(), config);
+        assert(opened);
+        book.add_order({1, true, 99.00, 10, 1});
+        receiver.receive(received);
+        assert(received.empty() && publisher.stats().packets == 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        publisher.poll();
+        receiver.receive(received);
+        assert(received.size() == 1 && received[0].sequence == 1 && received[0].price == 99.00);
+    }
+
+    struct Mode {
+        const char* name;
+        PublisherConfig config;
+    };
+    PublisherConfig single;
+    single.max_payload = sizeof(PacketHeader) + sizeof(DeltaMessage);
+    single.max_packets = 1;
+    single.flush_interval_ns = 0;
+    PublisherConfig batched;
+
+    const int operations = 50000;
+    std::vector<std::pair<std::string, PublisherStats>> results;
+    for (const Mode& mode : {Mode{"One per packet", single}, Mode{"Micro-batched", batched}}) {
+        MarketDataReceiver sink;
+        opened = sink.open();
+        assert(opened);
+        OrderBook book;
+        MarketDataPublisher publisher;
+        opened = publisher.open(book, sink.port(), mode.config);
+        assert(opened);
+
+        // Drain after every operation so the loopback queue never overflows
+        std::vector<DeltaMessage> messages;
+        std::mt19937 gen(37);
+        uint64_t next_id = 1000;
+        auto start = std::chrono::high_resolution_clock::now();
+        run_random_flow(book, gen, next_id, operations, [&]() { sink.receive(messages); });
+        publisher.flush();
+        auto end = std::chrono::high_resolution_clock::now();
+        sink.receive(messages);
+
+        const PublisherStats& stats = publisher.stats();
+        assert(sink.gaps() == 0 && stats.send_errors == 0);
+        assert(messages.size() == stats.messages && sink.packets() == stats.packets);
+
+        std::map<double, uint64_t, std::greater<double>> bid_map;
+        std::map<double, uint64_t> ask_map;
+        for (size_t i = 0; i < messages.size(); ++i) {
+            const DeltaMessage& m = messages[i];
+            assert(m.sequence == i + 1);
+            if (m.is_buy) {
+                if (m.total_quantity) bid_map[m.price] = m.total_quantity; else bid_map.erase(m.price);
+            } else {
+                if (m.total_quantity) ask_map[m.price] = m.total_quantity; else ask_map.erase(m.price);
+            }
+        }
+        std::vector<PriceLevel> bids, asks;
+        for (const auto& level : bid_map) bids.emplace_back(level.first, level.second);
+        for (const auto& level : ask_map) asks.emplace_back(level.first, level.second);
+        assert(levels_match(book, bids, asks));
+
+        std::cout.rdbuf(saved);
+        std::cout << std::setw(16) << std::left << mode.name << std::right << std::fixed << std::setprecision(1)
+                  << stats.messages << " msgs, " << stats.packets << " packets ("
+                  << double(stats.messages) / stats.packets << " msgs/packet), " << stats.syscalls << " syscalls, "
+                  << "added latency mean " << double(stats.total_latency_ns) / stats.messages / 1000.0
+                  << " us max " << stats.max_latency_ns / 1000.0 << " us, "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+        std::cout.rdbuf(nullptr);
+        results.emplace_back(mode.name, stats);
+    }
+
+    std::cout.rdbuf(saved);
+    std::cerr.rdbuf(saved_err);
+    assert(results[1].second.syscalls * 10 < results[0].second.syscalls);
+    std::cout << "Decoded stream rebuilds the book in both modes\n";
+    std::cout << "\nMicro-batched publisher test completed!\n";
+}
+
+// Journal test message: a sequence number and a payload whose length and
+// bytes are derived from it
+static uint32_t make_journal_message(uint64_t seq, char* out) {
+    uint32_t size = sizeof(seq) + seq % 200;
+    std::memcpy(out, &seq, sizeof(seq));
+    for (uint32_t i = sizeof(seq); i < size; ++i) {
+        out[i] = static_cast<char>(seq + i);
+    }
+    return size;
+}
+
+static bool check_journal_message(const char* data, uint32_t size, uint64_t expected) {
+    char buffer[256];
+    return size == make_journal_message(expected, buffer) && std::memcmp(data, buffer, size) == 0;
+}
+
+void test_journal_queue() {
+    std::cout << "\n=== JOURNAL QUEUE TEST ===\n";
+
+    const std::string dir = "order_book_journal_" + std::to_string(getpid());
+    mkdir(dir.c_str(), 0755);
+    const size_t file_size = 256 << 10;
+    const uint64_t total = 200000;
+    char buffer[256];
+
+    JournalWriter writer;
+    [[maybe_unused]] bool ok = writer.open(dir, file_size);
+    assert(ok);
+
+    std::cout << "Child process tails the queue while the parent appends...\n";
+    pid_t child = fork();
+    if (child == 0) {
+        JournalReader reader;
+        if (!reader.open(dir, "child")) _exit(2);
+        uint64_t expected = 1;
+        const char* data;
+        uint32_t size;
+        while (expected <= total) {
+            if (!reader.read(data, size)) continue;
+            if (!check_journal_message(data, size, expected++)) _exit(1);
+        }
+        _exit(0);
+    }
+    assert(child > 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint64_t seq = 1; seq <= total; ++seq) {
+        uint32_t size = make_journal_message(seq, buffer);
+        writer.append(buffer, size);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    int status = 0;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    std::cout << "Appended " << total << " messages across " << writer.files() << " files in "
+              << std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms (" << std::chrono::duration<double, std::nano>(end - start).count() / total
+              << " ns/message); child read them all in order\n";
+
+    std::cout << "Named reader resumes from its saved position...\n";
+    const char* data;
+    uint32_t size;
+    {
+        JournalReader reader;
+        ok = reader.open(dir, "resume");
+        assert(ok);
+        for (uint64_t seq = 1; seq <= 1000; ++seq) {
+            ok = reader.read(data, size);
+            assert(ok && check_journal_message(data, size, seq));
+        }
+    }
+    {
+        // Message 1000 was never acknowledged by another read(), so it comes back
+        JournalReader reader;
+        ok = reader.open(dir, "resume");
+        assert(ok);
+        ok = reader.read(data, size);
+        assert(ok && check_journal_message(data, size, 1000));
+        ok = reader.read(data, size);
+        assert(ok && check_journal_message(data, size, 1001));
+    }
+
+    std::cout << "Restarted writer continues the same journal...\n";
+    uint32_t files = writer.files();
+    writer.close();
+    ok = writer.open(dir, file_size);
+    assert(ok && writer.files() == files);
+    for (uint64_t seq = total + 1; seq <= total + 1000; ++seq) {
+        uint32_t size = make_journal_message(seq, buffer);
+        ok = writer.append(buffer, size);
+        assert(ok);
+    }
+    ok = writer.sync();
+    assert(ok);
+
+    JournalReader replay;
+    ok = replay.open(dir);
+    assert(ok);
+    uint64_t replayed = 0;
+    while (replay.read(data, size)) {
+        [[maybe_unused]] bool intact = check_journal_message(data, size, ++replayed);
+        assert(intact);
+    }
+    assert(replayed == total + 1000);
+    std::cout << "Replayed " << replayed << " messages from the start of the journal\n";
+    replay.close();
+    files = writer.files();
+    writer.close();
+
+    for (uint32_t f = 0; f < files; ++f) {
+        std::remove(journal::file_path(dir, f).c_str());
+    }
+    std::remove((dir + "/child.position").c_str());
+    std::remove((dir + "/resume.position").c_str());
+    rmdir(dir.c_str());
+    std::cout << "\nJournal queue test completed!\n";
+}
+
+void test_decimal() {
+    std::cout << "\n=== FIXED-POINT DECIMAL TEST ===\n";
+
+    [[maybe_unused]] auto parsed = [](const char* text, int scale) {
+        int64_t value = 0;
+        [[maybe_unused]] size_t used = decimal::parse(text, std::strlen(text), scale, value);
+        assert(used == std::strlen(text));
+        return value;
+    };
+    auto formatted = [](int64_t value, int scale) {
+        char buffer[decimal::FORMAT_MAX];
+        return std::string(buffer, decimal::format(value, scale, buffer));
+    };
+
+    assert(parsed("100.07", 2) == 10007);
+    assert(parsed("100", 2) == 10000 && parsed("100.", 2) == 10000 && parsed(".5", 2) == 50);
+    assert(parsed("-1.25", 2) == -125 && parsed("0.005", 2) == 1 && parsed("0.0049", 2) == 0);
+    assert(parsed("1000000", 0) == 1000000 && parsed("0.000000001", 9) == 1);
+    [[maybe_unused]] int64_t value;
+    assert(decimal::parse("abc", 3, 2, value) == 0 && decimal::parse("-", 1, 2, value) == 0);
+    assert(decimal::parse(".", 1, 2, value) == 0);
+    assert(decimal::parse("12.5|", 5, 2, value) == 4 && value == 1250);                  // stops at a delimiter
+    assert(decimal::parse("12345678901234567", 17, 2, value) == 0);                      // does not fit
+    assert(formatted(10007, 2) == "100.07" && formatted(5, 2) == "0.05" && formatted(-125, 2) == "-1.25");
+    assert(formatted(0, 2) == "0.00" && formatted(42, 0) == "42" && formatted(-7, 3) == "-0.007");
+    assert(formatted(INT64_MIN, 0) == "-9223372036854775808");
+    [[maybe_unused]] char padded[32];
+    assert(std::string(padded, decimal::format_padded(9950, 2, 8, padded)) == "   99.50");
+
+    std::mt19937_64 gen(41);
+    for (int i = 0; i < 100000; ++i) {
+        [[maybe_unused]] int scale = static_cast<int>(gen() % (decimal::MAX_SCALE + 1));
+        [[maybe_unused]] int64_t units = static_cast<int64_t>(gen() % 1000000000000ull) - 500000000000ll;
+        assert(parsed(formatted(units, scale).c_str(), scale) == units);
+    }
+    std::cout << "Round trip exact for 100000 random values at scales 0-" << decimal::MAX_SCALE << "\n";
+
+    // print_book rows match the old iostream formatting
+    PriceLevel bid(99.95, 1200), ask(100.0, 7);
+    [[maybe_unused]] char row[BOOK_ROW_MAX];
+    std::ostringstream expected;
+    expected << std::fixed << std::setprecision(2) << std::setw(8) << bid.price << " | " << std::setw(8) << bid.total_quantity
+             << " | " << std::setw(8) << ask.price << " | " << std::setw(8) << ask.total_quantity << "\n";
+    assert(std::string(row, format_book_row(&bid, &ask, row)) == expected.str());
+    [[maybe_unused]] char match[MATCH_LINE_MAX];
+    assert(std::string(match, format_match_line(50, 100.0, QUOTE_ORDER_ID_FLAG, 1, match)) ==
+           "MATCH: 50 @ 100.00 (Bid: 9223372036854775808, Ask: 1)\n");
+
+    std::cout << "Benchmark (1M prices at scale 2):\n";
+    const int count = 1000000;
+    std::vector<std::string> texts(count);
+    std::vector<int64_t> ticks(count);
+    for (int i = 0; i < count; ++i) {
+        ticks[i] = 1 + static_cast<int64_t>(gen() % 10000000);
+        texts[i] = formatted(ticks[i], 2);
+    }
+    auto report = [&](const char* name, auto&& body) {
+        auto start = std::chrono::high_resolution_clock::now();
+        int64_t sink = body();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "  " << std::setw(26) << std::left << name << std::right << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::nano>(end - start).count() / count << " ns  (" << sink % 10 << ")\n";
+    };
+    report("decimal::parse", [&]() {
+        int64_t sum = 0, v = 0;
+        for (const auto& t : texts) { decimal::parse(t.data(), t.size(), 2, v); sum += v; }
+        return sum;
+    });
+    report("strtod", [&]() {
+        int64_t sum = 0;
+        for (const auto& t : texts) sum += decimal::to_units(std::strtod(t.c_str(), nullptr), 2);
+        return sum;
+    });
+    report("istringstream >> double", [&]() {
+        int64_t sum = 0;
+        std::istringstream in;
+        for (const auto& t : texts) { double d; in.clear(); in.str(t); in >> d; sum += decimal::to_units(d, 2); }
+        return sum;
+    });
+    report("decimal::format", [&]() {
+        int64_t sum = 0;
+        char buffer[decimal::FORMAT_MAX];
+        for (int64_t t : ticks) sum += static_cast<int64_t>(decimal::format(t, 2, buffer)) + buffer[0];
+        return sum;
+    });
+    report("snprintf %.2f", [&]() {
+        int64_t sum = 0;
+        char buffer[64];
+        for (int64_t t : ticks) sum += std::snprintf(buffer, sizeof(buffer), "%.2f", decimal::from_units(t, 2)) + buffer[0];
+        return sum;
+    });
+    report("ostringstream << double", [&]() {
+        int64_t sum = 0;
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2);
+        for (int64_t t : ticks) { out.str(""); out << decimal::from_units(t, 2); sum += static_cast<int64_t>(out.str().size()); }
+        return sum;
+    });
+
+    std::cout << "\nFixed-point decimal test completed!\n";
+}
+
+void test_parallel_startup() {
+    std::cout << "\n=== PARALLEL STARTUP TEST ===\n";
+
+    // 10k instruments cycling through a few distinct books keeps the source
+    // side small; every loaded book is still built from its own image
+    const size_t instruments = 10000;
+    const size_t templates = 16;
+    std::vector<std::unique_ptr<OrderBook>> sources;
+    for (size_t t = 0; t < templates; ++t) {
+        sources.push_back(std::make_unique<OrderBook>());
+        for (uint64_t i = 1; i <= 50; ++i) {
+            bool is_buy = i % 2 == 0;
+            double price = is_buy ? 99.99 - ((i + t) % 20) * 0.01 : 100.01 + ((i + t) % 20) * 0.01;
+            sources.back()->add_order({i, is_buy, price, 10 + t, i});
+        }
+    }
+    std::vector<const OrderBook*> views;
+    for (size_t i = 0; i < instruments; ++i) {
+        views.push_back(sources[i % templates].get());
+    }
+    char dir[] = "/tmp/order_book_startup_XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cout << "Cannot create a scratch directory, skipping\n";
+        return;
+    }
+    const std::string path = std::string(dir) + "/books.bin";
+    // Removes the image (and any half-written .tmp) on every return path
+    struct ScratchDir {
+        const char* dir;
+        const std::string& path;
+        ~ScratchDir() {
+            std::remove(path.c_str());
+            std::remove((path + ".tmp").c_str());
+            rmdir(dir);
+        }
+    } scratch{dir, path};
+    [[maybe_unused]] bool written = write_snapshot_file(path, views, 77);
+    assert(written);
+
+    std::vector<std::vector<PriceLevel>> expected_bids(templates), expected_asks(templates);
+    for (size_t t = 0; t < templates; ++t) {
+        sources[t]->get_snapshot(SIZE_MAX, expected_bids[t], expected_asks[t]);
+    }
+    auto verify = [&](const std::vector<std::unique_ptr<OrderBook>>& books) {
+        assert(books.size() == instruments);
+        for (size_t i = 0; i < instruments; ++i) {
+            std::vector<PriceLevel> bids, asks;
+            books[i]->get_snapshot(SIZE_MAX, bids, asks);
+            [[maybe_unused]] const auto& eb = expected_bids[i % templates];
+            [[maybe_unused]] const auto& ea = expected_asks[i % templates];
+            assert(bids.size() == eb.size() && asks.size() == ea.size());
+            for (size_t l = 0; l < bids.size(); ++l) {
+                assert(bids[l].price == eb[l].price && bids[l].total_quantity == eb[l].total_quantity);
+            }
+            for (size_t l = 0; l < asks.size(); ++l) {
+                assert(asks[l].price == ea[l].price && asks[l].total_quantity == ea[l].total_quantity);
+            }
+        }
+    };
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> book_cpus(instruments);
+    for (size_t i = 0; i < instruments; ++i) {
+        book_cpus[i] = static_cast<int>(i % cores);
+    }
+
+    std::cout << "Rebuilding " << instruments << " books (" << instruments * 50 << " orders) on "
+              << cores << " cores:\n";
+    auto run = [&](const char* name, auto&& load) {
+        std::vector<std::unique_ptr<OrderBook>> books;
+        uint64_t sequence = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        [[maybe_unused]] bool loaded = load(books, sequence);
+        auto end = std::chrono::high_resolution_clock::now();
+        assert(loaded && sequence == 77);
+        verify(books);
+        std::cout << "  " << std::setw(28) << std::left << name << std::right << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    };
+    {
+        // Untimed first load, so every timed run starts from the same warm heap
+        std::vector<std::unique_ptr<OrderBook>> warm;
+        uint64_t seq = 0;
+        [[maybe_unused]] bool warmed = read_snapshot_file(path, warm, seq);
+        assert(warmed);
+    }
+    run("Sequential", [&](auto& books, uint64_t& seq) { return read_snapshot_file(path, books, seq); });
+    run("Parallel, shared cursor", [&](auto& books, uint64_t& seq) {
+        return read_snapshot_file_parallel(path, books, seq);
+    });
+    run("Parallel, placed per CPU", [&](auto& books, uint64_t& seq) {
+        return read_snapshot_file_parallel(path, books, seq, 0, book_cpus);
+    });
+
+    std::vector<std::unique_ptr<OrderBook>> books;
+    uint64_t sequence = 0;
+    std::cerr.setstate(std::ios::failbit);
+    [[maybe_unused]] bool mismatched = read_snapshot_file_parallel(path, books, sequence, 0, std::vector<int>(3, 0));
+    std::cerr.clear();
+    assert(!mismatched && books.empty());
+
+    std::cout << "Every loaded book matches its source\n";
+    std::cout << "\nParallel startup test completed!\n";
+}
+
+// Execution-report-sized message for the handoff comparison
+struct LargeMessage {
+    uint64_t sequence;
+    uint64_t words[511];
+};
+
+static void fill_large_message(LargeMessage& msg, uint64_t sequence) {
+    msg.sequence = sequence;
+    for (size_t i = 0; i < 511; ++i) {
+        msg.words[i] = sequence * 31 + i;
+    }
+}
+
+static uint64_t checksum_large_message(const LargeMessage& msg) {
+    uint64_t sum = msg.sequence;
+    for (size_t i = 0; i < 511; ++i) {
+        sum += msg.words[i];
+    }
+    return sum;
+}
+
+void test_message_slab() {
+    std::cout << "\n=== ZERO-COPY SLAB HANDOFF TEST ===\n";
+
+    {
+        MessageSlab<LargeMessage> slab(4);
+        uint32_t slots[4];
+        for (uint32_t& slot : slots) {
+            slot = slab.allocate();
+            assert(slot != MessageSlab<LargeMessage>::INVALID_SLOT);
+        }
+        [[maybe_unused]] uint32_t extra = slab.allocate();
+        assert(extra == MessageSlab<LargeMessage>::INVALID_SLOT);              // all in flight
+        fill_large_message(slab[slots[2]], 7);
+        slab.publish(slots[2]);
+        uint32_t received = MessageSlab<LargeMessage>::INVALID_SLOT;
+        [[maybe_unused]] bool got = slab.receive(received);
+        assert(got && received == slots[2] && slab[received].sequence == 7);
+        uint32_t none;
+        got = slab.receive(none);
+        assert(!got);
+        slab.release(received);
+        extra = slab.allocate();
+        assert(extra == slots[2]);                                             // reclaimed from the return queue
+    }
+
+    const uint64_t messages = 200000;
+    [[maybe_unused]] const uint64_t expected = [&]() {
+        uint64_t sum = 0;
+        LargeMessage msg;
+        for (uint64_t seq = 1; seq <= messages; ++seq) {
+            fill_large_message(msg, seq);
+            sum += checksum_large_message(msg);
+        }
+        return sum;
+    }();
+
+    auto report = [&](const char* name, double ms) {
+        std::cout << "  " << std::setw(24) << std::left << name << std::right << std::fixed << std::setprecision(1)
+                  << ms << " ms, " << messages * 1000.0 / ms / 1e6 << " M msgs/s ("
+                  << sizeof(LargeMessage) << "-byte messages)\n";
+    };
+
+    std::cout << "Producer thread to consumer thread, " << messages << " messages:\n";
+    {
+        // Baseline: the message is built locally, copied into the ring and copied out again
+        Fifo3<LargeMessage> fifo(64);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::thread producer([&]() {
+            LargeMessage msg;
+            for (uint64_t seq = 1; seq <= messages; ++seq) {
+                fill_large_message(msg, seq);
+                while (!fifo.push(msg)) std::this_thread::yield();
+            }
+        });
+        uint64_t sum = 0, next = 1;
+        LargeMessage msg;
+        while (next <= messages) {
+            if (!fifo.pop(msg)) {
+                std::this_thread::yield();
+                continue;
+            }
+            assert(msg.sequence == next);
+            next++;
+            sum += checksum_large_message(msg);
+        }
+        producer.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        assert(sum == expected);
+        report("Fifo3 by value", std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    {
+        MessageSlab<LargeMessage> slab(64);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::thread producer([&]() {
+            for (uint64_t seq = 1; seq <= messages; ++seq) {
+                uint32_t slot;
+                while ((slot = slab.allocate()) == MessageSlab<LargeMessage>::INVALID_SLOT) std::this_thread::yield();
+                fill_large_message(slab[slot], seq);
+                slab.publish(slot);
+            }
+        });
+        uint64_t sum = 0, next = 1;
+        while (next <= messages) {
+            uint32_t slot;
+            if (!slab.receive(slot)) {
+                std::this_thread::yield();
+                continue;
+            }
+            assert(slab[slot].sequence == next);
+            next++;
+            sum += checksum_large_message(slab[slot]);
+            slab.release(slot);
+        }
+        producer.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        assert(sum == expected);
+        report("Slab index handoff", std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::cout << "Both paths deliver every message intact and in order\n";
+    std::cout << "\nZero-copy slab handoff test completed!\n";
+}
+
+// Blocking loopback client for the gateway test: sends one batch of request
+// lines per connection and counts the answers
+static void run_gateway_clients(uint16_t port, uint32_t first_session, uint32_t sessions, uint64_t id_base,
+                                std::atomic<uint64_t>& ok, std::atomic<uint64_t>& rejected) {
+    std::vector<int> fds;
+    std::vector<size_t> expected;
+    for (uint32_t s = 0; s < sessions; ++s) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) std::abort();
+
+        // 20 non-crossing adds, cancels for half of them, and one bad line
+        std::string batch;
+        uint64_t base = id_base + (first_session + s) * 100;
+        for (uint64_t k = 0; k < 20; ++k) {
+            bool is_buy = k % 2 == 0;
+            batch += "N " + std::to_string(base + k) + (is_buy ? " B 99." : " S 101.") + std::to_string(10 + k) + " 5\n";
+        }
+        for (uint64_t k = 0; k < 20; k += 2) {
+            batch += "C " + std::to_string(base + k) + "\n";
+        }
+        batch += "N 0 B 99 5\n";
+        for (size_t sent = 0; sent < batch.size();) {
+            ssize_t n = ::send(fd, batch.data() + sent, batch.size() - sent, 0);
+            if (n <= 0) std::abort();
+            sent += static_cast<size_t>(n);
+        }
+        fds.push_back(fd);
+        expected.push_back(31);
+    }
+    for (size_t i = 0; i < fds.size(); ++i) {
+        std::string responses;
+        char buffer[1024];
+        while (static_cast<size_t>(std::count(responses.begin(), responses.end(), '\n')) < expected[i]) {
+            ssize_t n = ::read(fds[i], buffer, sizeof(buffer));
+            if (n <= 0) std::abort();
+            responses.append(buffer, static_cast<size_t>(n));
+        }
+        for (size_t pos = 0; pos < responses.size(); pos = responses.find('\n', pos) + 1) {
+            (responses.compare(pos, 3, "OK ") == 0 ? ok : rejected)++;
+        }
+        ::close(fds[i]);
+    }
+}
+
+void test_session_gateway() {
+    std::cout << "\n=== COROUTINE SESSION GATEWAY TEST ===\n";
+
+    OrderBook book;
+    Fifo3<BookCommand> commands(64);
+    SessionGateway gateway;
+    [[maybe_unused]] bool opened = gateway.open(0, commands);
+    assert(opened);
+
+    uint64_t timestamp = 1;
+    auto drain = [&]() {
+        BookCommand cmd;
+        while (commands.pop(cmd)) {
+            switch (cmd.type) {
+            case BookCommand::Add: book.add_order({cmd.order_id, cmd.is_buy, cmd.price, cmd.quantity, timestamp++}); break;
+            case BookCommand::Cancel: book.cancel_order(cmd.order_id); break;
+            case BookCommand::Amend: book.amend_order(cmd.order_id, cmd.price, cmd.quantity); break;
+            }
+        }
+    };
+
+    const uint32_t threads = 4, per_thread = 50, sessions = threads * per_thread;
+    std::atomic<uint64_t> ok{0}, rejected{0};
+    for (int round = 0; round < 2; ++round) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::atomic<uint32_t> finished{0};
+        std::vector<std::thread> clients;
+        for (uint32_t t = 0; t < threads; ++t) {
+            clients.emplace_back([&, t, round]() {
+                run_gateway_clients(gateway.port(), t * per_thread, per_thread, 1000000ull * (round + 1), ok, rejected);
+                finished++;
+            });
+        }
+        // The matching side: run the gateway and apply what it queues
+        while (finished.load() < threads || gateway.stats().sessions_active > 0) {
+            gateway.poll(1);
+            drain();
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+        drain();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Round " << round + 1 << ": " << sessions << " sessions, "
+                  << std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(end - start).count()
+                  << " ms\n";
+    }
+
+    GatewayStats stats = gateway.stats();
+    assert(stats.sessions_accepted == 2 * sessions && stats.sessions_active == 0);
+    assert(stats.commands == 2 * sessions * 30 && stats.rejects == 2 * sessions);
+    assert(ok.load() == stats.commands && rejected.load() == stats.rejects);
+    assert(book.get_order_count() == 2 * sessions * 10);
+    assert(stats.frames_reused >= sessions);   // round two runs entirely on recycled frames
+    std::cout << stats.commands << " commands queued, " << stats.rejects << " rejected, "
+              << stats.queue_waits << " waits for queue space\n";
+    std::cout << "Coroutine frames: " << stats.frames_allocated << " allocated, " << stats.frames_reused << " reused\n";
+
+    // Closing with a session parked mid-conversation destroys its frame
+    int idle = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(gateway.port());
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    [[maybe_unused]] int connected = connect(idle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    assert(connected == 0);
+    while (gateway.stats().sessions_active == 0) {
+        gateway.poll(1);
+    }
+    gateway.close();
+    char byte;
+    [[maybe_unused]] ssize_t n = ::read(idle, &byte, 1);
+    assert(n == 0);                        // server side closed
+    ::close(idle);
+
+    std::cout << "\nCoroutine session gateway test completed!\n";
+}
+
 void stress_test() {
     std::cout << "\n=== STRESS TEST ===\n";
     
     OrderBook book;
+    ClockService clock(ClockSource::Tsc);
     const int total_orders = 10000;
 
     auto start_time = std::chrono::high_resolution_clock::now();
@@ -177,8 +2197,7 @@ void stress_test() {
         bool is_buy = bool_dist(gen);
         double price = price_dist(gen);
         uint64_t qty = qty_dist(gen);
-        uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        uint64_t timestamp = clock.now_ns();
 
         book.add_order({static_cast<uint64_t>(i), is_buy, price, qty, timestamp});
 
@@ -239,6 +2258,428 @@ void demonstrate_memory_pool() {
     std::cout << "\nMemory pool demonstration completed!\n";
 }
 
+void test_instrument_master() {
+    std::cout << "\n=== INSTRUMENT MASTER TEST ===\n";
+
+    {
+        OrderBook book;
+        InstrumentParams params;
+        params.tick_size = 0.05;
+        params.lot_size = 100;
+        params.min_price = 90.0;
+        params.max_price = 110.0;
+        params.max_quantity = 10000;
+        auto* old_cerr = std::cerr.rdbuf(nullptr);
+        InstrumentParams bad = params;
+        bad.lot_size = 0;
+        [[maybe_unused]] bool configured = book.set_instrument(bad);
+        assert(!configured);
+        configured = book.set_instrument(params);
+        assert(configured);
+        book.add_order(Order(1, true, 100.03, 100, 1));    // off tick
+        book.add_order(Order(2, true, 100.05, 150, 2));    // odd lot
+        book.add_order(Order(3, true, 111.00, 100, 3));    // outside the band
+        book.add_order(Order(4, true, 100.00, 20000, 4));  // over max quantity
+        assert(book.get_order_count() == 0);
+        book.add_order(Order(5, true, 100.05, 200, 5));
+        assert(book.get_order_count() == 1);
+        [[maybe_unused]] bool amended = book.amend_order(5, 100.07, 200);
+        assert(!amended);
+        amended = book.amend_order(5, 99.95, 300);
+        assert(amended);
+        std::cerr.rdbuf(old_cerr);
+        assert(book.get_best_bid() == 99.95);
+        std::cout << "Book rejects off-tick, odd-lot, out-of-band and oversized orders\n";
+    }
+
+    const std::string text_path = "instruments_" + std::to_string(getpid()) + ".csv";
+    const std::string table_path = "instruments_" + std::to_string(getpid()) + ".bin";
+    const uint32_t count = 100000;
+    const double ticks[] = {0.01, 0.05, 0.25, 0.5};
+    auto symbol_of = [](uint32_t i) {
+        char symbol[16];
+        std::snprintf(symbol, sizeof(symbol), "%c%c%u.X", 'A' + i % 26, 'A' + i / 26 % 26, i);
+        return std::string(symbol);
+    };
+    {
+        std::string text = "# symbol,tick_size,lot_size,min_price,max_price,max_quantity\n";
+        char line[128];
+        for (uint32_t i = 0; i < count; ++i) {
+            std::snprintf(line, sizeof(line), "%s,%.2f,%u,%u.%02u,%u,%u\n", symbol_of(i).c_str(), ticks[i % 4],
+                          1u << (i % 3), 1 + i % 50, i % 100, 1000 + i % 1000, 1000 * (1 + i % 500));
+            text += line;
+        }
+        FILE* f = std::fopen(text_path.c_str(), "w");
+        assert(f);
+        std::fwrite(text.data(), 1, text.size(), f);
+        std::fclose(f);
+    }
+    auto check_all = [&](const InstrumentTable& table) {
+        assert(table.size() == count);
+        for (uint32_t i = 0; i < count; ++i) {
+            std::string symbol = symbol_of(i);
+            uint32_t id = table.find(symbol);
+            assert(id == i && symbol == table[id].symbol);
+            [[maybe_unused]] const InstrumentParams& p = table.params(id);
+            assert(p.tick_size == ticks[i % 4] && p.lot_size == (1u << (i % 3)));
+            assert(std::fabs(p.min_price - (1 + i % 50 + (i % 100) / 100.0)) < 1e-9);
+            assert(p.max_price == 1000 + i % 1000 && p.max_quantity == 1000 * (1 + i % 500));
+        }
+        assert(table.find("ZZZZ") == InstrumentTable::INVALID_ID);
+        assert(table.find("AA0") == InstrumentTable::INVALID_ID);        // prefix of "AA0.X"
+        assert(table.find("AA0.XY") == InstrumentTable::INVALID_ID);
+    };
+
+    auto time_ms = [](auto&& fn) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    struct stat built{};
+    {
+        InstrumentTable table;
+        bool ok = false;
+        double ms = time_ms([&]() { ok = table.open_or_build(text_path, table_path); });
+        assert(ok);
+        check_all(table);
+        [[maybe_unused]] int stated = ::stat(table_path.c_str(), &built);
+        assert(stated == 0);
+        std::cout << "First boot, " << count << " instruments: parse text and build table " << std::fixed
+                  << std::setprecision(2) << ms << " ms\n";
+    }
+    {
+        InstrumentTable table;
+        bool ok = false;
+        double ms = time_ms([&]() { ok = table.open_or_build(text_path, table_path); });
+        assert(ok);
+        struct stat reused{};
+        [[maybe_unused]] int stated = ::stat(table_path.c_str(), &reused);
+        assert(stated == 0 && reused.st_ino == built.st_ino);   // not rebuilt
+        std::cout << "Later boots: map compiled table " << ms << " ms ("
+                  << static_cast<double>(built.st_size) / (1 << 20) << " MB)\n";
+
+        std::vector<std::string> symbols;
+        for (uint32_t i = 0; i < count; ++i) symbols.push_back(symbol_of((i * 7919u) % count));
+        uint64_t sum = 0;
+        ms = time_ms([&]() {
+            for (const std::string& symbol : symbols) sum += table.find(symbol);
+        });
+        assert(sum == uint64_t(count) * (count - 1) / 2);
+        std::cout << "Symbol lookups: " << ms * 1e6 / count << " ns each\n";
+
+        // Configure books straight from the mapped records
+        std::vector<OrderBook> books(16);
+        for (uint32_t i = 0; i < books.size(); ++i) {
+            [[maybe_unused]] bool configured = books[i].set_instrument(table.params(table.find(symbol_of(i))));
+            assert(configured);
+        }
+        assert(books[1].get_instrument().tick_size == 0.05 && books[2].get_instrument().lot_size == 4);
+    }
+    {
+        // The master file changed: the next boot recompiles
+        FILE* f = std::fopen(text_path.c_str(), "a");
+        std::fputs("NEW.X,0.01,1,1,100,1000\n", f);
+        std::fclose(f);
+        InstrumentTable table;
+        [[maybe_unused]] bool ok = table.open_or_build(text_path, table_path);
+        assert(ok);
+        assert(table.size() == count + 1 && table.find("NEW.X") == count);
+
+        f = std::fopen(text_path.c_str(), "a");
+        std::fputs("NEW.X,0.01,1,1,100,1000\nBAD,0.01,0,1,100,1000\n", f);
+        std::fclose(f);
+        auto* old_cerr = std::cerr.rdbuf(nullptr);
+        ok = compile_instrument_master(text_path, table_path + ".dup");
+        assert(!ok);
+        std::cerr.rdbuf(old_cerr);
+    }
+    {
+        // A slot id past the record array is rejected at open, not dereferenced by find()
+        FILE* f = std::fopen(table_path.c_str(), "r+b");
+        uint32_t bucket_count = 0;
+        uint32_t bad_id = count + 5;
+        std::fseek(f, 20, SEEK_SET);   // TableHeader::bucket_count
+        size_t got = std::fread(&bucket_count, sizeof(bucket_count), 1, f);
+        std::fseek(f, 64 + bucket_count * sizeof(uint32_t), SEEK_SET);   // first slot
+        got += std::fwrite(&bad_id, sizeof(bad_id), 1, f);
+        std::fclose(f);
+        assert(got == 2);
+        InstrumentTable table;
+        auto* old_cerr = std::cerr.rdbuf(nullptr);
+        [[maybe_unused]] bool ok = table.open(table_path);
+        std::cerr.rdbuf(old_cerr);
+        assert(!ok && table.size() == 0);
+    }
+    std::remove(text_path.c_str());
+    std::remove(table_path.c_str());
+
+    std::cout << "Every symbol resolves to its id and parameters; unknown symbols miss\n";
+    std::cout << "\nInstrument master test completed!\n";
+}
+
+// Records every trade a book reports, for checking the position keeper
+// against the full log
+class TradeLog : public BookListener {
+public:
+    void on_trade(const Trade& trade) override { trades.push_back(trade); }
+    std::vector<Trade> trades;
+};
+
+void test_position_keeper() {
+    std::cout << "\n=== POSITION KEEPER TEST ===\n";
+
+    auto units = [](double price) { return decimal::to_units(price, PNL_PRICE_SCALE); };
+    {
+        OrderBook book;
+        PositionKeeper keeper(4, 2);
+        [[maybe_unused]] bool attached = keeper.attach(book, 1);
+        assert(attached);
+        auto add = [&](uint64_t id, uint32_t owner, bool is_buy, double price, uint64_t qty) {
+            keeper.assign(id, owner);
+            book.add_order(Order(id, is_buy, price, qty, id));
+        };
+        auto* old_cout = std::cout.rdbuf(nullptr);
+        add(1, 0, true, 100.0, 10);     // owner 0 buys 10 @ 100 from owner 1
+        add(2, 1, false, 100.0, 10);
+        add(3, 2, true, 99.0, 5);
+        add(4, 3, false, 101.0, 5);     // mid 100
+        add(5, 0, false, 99.0, 4);      // owner 0 sells 4 @ 99 to owner 2
+        add(6, 1, true, 101.0, 15);     // owner 1 covers 5 @ 101, 10 rest as a bid
+        std::cout.rdbuf(old_cout);
+
+        PositionView v;
+        [[maybe_unused]] bool found = keeper.read(0, 1, v);
+        assert(found && v.position == 6 && v.cost == 6 * units(100.0) && v.fills == 2);
+        assert(v.realized_pnl() == -4.0 && v.average_price() == 100.0);
+        assert(v.mark == units(100.0) && v.unrealized() == 0);     // last two-sided mid is kept
+        found = keeper.read(1, 1, v);
+        assert(found && v.position == -5 && v.realized_pnl() == -5.0 && v.average_price() == 100.0);
+        found = keeper.read(2, 1, v);
+        assert(found && v.position == 4 && v.average_price() == 99.0 && v.unrealized_pnl() == 4.0);
+        found = keeper.read(3, 1, v);
+        assert(found && v.position == -5 && v.realized == 0);
+        found = keeper.read(0, 0, v);
+        assert(found && v.position == 0 && v.fills == 0);
+        assert(keeper.unowned_fills() == 0);
+        std::cout << "Average-cost position, realized and mid-marked P&L match hand calculation\n";
+
+        // Quote orders carry generated ids; their fills go to the quoter's owner
+        uint32_t mm = book.register_quoter(1);
+        [[maybe_unused]] bool assigned = keeper.assign_quoter(1, mm, 3);
+        assert(assigned);
+        old_cout = std::cout.rdbuf(nullptr);
+        [[maybe_unused]] bool quoted = book.mass_quote(mm, {{0.0, 0, 102.0, 3}}, 7);
+        add(7, 2, true, 102.0, 3);      // owner 2 lifts owner 3's quote
+        std::cout.rdbuf(old_cout);
+        assert(quoted);
+        found = keeper.read(3, 1, v);
+        assert(found && v.position == -8 && v.fills == 2 && keeper.unowned_fills() == 0);
+        std::cout << "Mass quote fills are attributed to the quoter's owner\n";
+    }
+
+    // Random flow with a risk thread reading while fills land, checked at the
+    // end against the full trade log
+    const uint32_t owners = 8;
+    OrderBook book;
+    PositionKeeper keeper(owners, 1);
+    TradeLog log;
+    [[maybe_unused]] bool attached = keeper.attach(book, 0);
+    assert(attached);
+    book.add_listener(&log);
+
+    const int operations = 200000;
+    uint64_t next_id = 1000;
+    for (uint64_t id = next_id; id < next_id + operations; ++id) {
+        keeper.assign(id, static_cast<uint32_t>(id % owners));
+    }
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> reads{0};
+    std::thread risk([&]() {
+        PositionView v;
+        while (!done.load(std::memory_order_acquire)) {
+            for (uint32_t owner = 0; owner < owners; ++owner) {
+                keeper.read(owner, 0, v);
+                // A torn read would break the tie between position and cost
+                if ((v.position == 0) != (v.cost == 0) || (v.position > 0) != (v.cost > 0)) std::abort();
+                reads++;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    std::mt19937 gen(125);
+    auto* old_cout = std::cout.rdbuf(nullptr);
+    auto* old_cerr = std::cerr.rdbuf(nullptr);
+    auto start = std::chrono::high_resolution_clock::now();
+    run_random_flow(book, gen, next_id, operations, []() {});
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout.rdbuf(old_cout);
+    std::cerr.rdbuf(old_cerr);
+    done = true;
+    risk.join();
+    double flow_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // Recompute from the log: positions are the signed fill sums, and under
+    // average cost realized - cost equals the cash paid in
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<int64_t> position(owners, 0), cash(owners, 0);
+    std::vector<uint64_t> fills(owners, 0);
+    for (const Trade& t : log.trades) {
+        int64_t value = units(t.price) * static_cast<int64_t>(t.quantity);
+        uint32_t buyer = t.bid_order_id % owners, seller = t.ask_order_id % owners;
+        position[buyer] += static_cast<int64_t>(t.quantity);
+        cash[buyer] -= value;
+        fills[buyer]++;
+        position[seller] -= static_cast<int64_t>(t.quantity);
+        cash[seller] += value;
+        fills[seller]++;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double replay_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    int64_t net = 0;
+    for (uint32_t owner = 0; owner < owners; ++owner) {
+        PositionView v;
+        [[maybe_unused]] bool found = keeper.read(owner, 0, v);
+        assert(found);
+        assert(v.position == position[owner] && v.realized - v.cost == cash[owner] && v.fills == fills[owner]);
+        net += v.position;
+    }
+    assert(net == 0 && keeper.unowned_fills() == 0 && !log.trades.empty());
+    book.remove_listener(&log);
+
+    std::cout << log.trades.size() << " trades over " << operations << " operations ("
+              << std::fixed << std::setprecision(1) << flow_ms << " ms with the keeper attached), "
+              << reads.load() << " concurrent risk reads\n";
+    std::cout << "Recomputing from the log instead: " << replay_ms << " ms per query, growing with history\n";
+    std::cout << "Keeper agrees with the trade log for every owner\n";
+    std::cout << "\nPosition keeper test completed!\n";
+}
+
+// Loopback subscriber for the stream publisher test: accepts one connection
+// and checks that the byte stream is `record`-sized messages numbered 1, 2, ...
+static void run_stream_subscriber(int listener, size_t record, uint64_t& received, bool& in_order) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) std::abort();
+    std::vector<char> buffer(256 * 1024);
+    size_t partial = 0;
+    received = 0;
+    in_order = true;
+    for (;;) {
+        ssize_t n = ::read(fd, buffer.data() + partial, buffer.size() - partial);
+        if (n < 0) std::abort();
+        if (n == 0) break;
+        size_t available = partial + static_cast<size_t>(n);
+        size_t offset = 0;
+        for (; available - offset >= record; offset += record) {
+            uint64_t seq;
+            std::memcpy(&seq, buffer.data() + offset, sizeof(seq));
+            in_order &= seq == ++received && buffer[offset + record - 1] == static_cast<char>(seq);
+        }
+        partial = available - offset;
+        std::memmove(buffer.data(), buffer.data() + offset, partial);
+    }
+    in_order &= partial == 0;
+    ::close(fd);
+}
+
+void test_stream_publisher() {
+    std::cout << "\n=== ZERO-COPY STREAM PUBLISHER TEST ===\n";
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 4) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::cout << "Loopback TCP unavailable, skipping\n";
+        ::close(listener);
+        return;
+    }
+    uint16_t port = ntohs(addr.sin_port);
+
+    const char* mode_names[] = {"send per message", "sendmsg gather", "MSG_ZEROCOPY"};
+    auto run = [&](SendMode mode, size_t record, uint64_t messages, size_t burst, size_t slots) {
+        StreamPublisherConfig config;
+        config.mode = mode;
+        config.slot_size = record;
+        config.slots = slots;
+        uint64_t received = 0;
+        bool in_order = false;
+        std::thread subscriber(run_stream_subscriber, listener, record, std::ref(received), std::ref(in_order));
+
+        StreamPublisher publisher;
+        auto* old_cerr = std::cerr.rdbuf(nullptr);   // the zerocopy fallback warning
+        [[maybe_unused]] bool opened = publisher.open(port, config);
+        std::cerr.rdbuf(old_cerr);
+        assert(opened);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t seq = 1; seq <= messages; ++seq) {
+            char* msg = publisher.claim(static_cast<uint32_t>(record));
+            if (!msg) {
+                break;   // connection lost; the receive checks below fail
+            }
+            std::memcpy(msg, &seq, sizeof(seq));
+            std::memset(msg + sizeof(seq), 0, record - sizeof(seq) - 1);
+            msg[record - 1] = static_cast<char>(seq);
+            publisher.commit(static_cast<uint32_t>(record));
+            if (seq % burst == 0) {
+                publisher.flush();
+            }
+        }
+        StreamPublisherStats stats = publisher.stats();
+        bool zerocopy = publisher.zerocopy_active();
+        publisher.close();
+        subscriber.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        assert(in_order && received == messages);
+        assert(stats.messages == messages && stats.bytes == messages * record);
+        if (mode == SendMode::PerMessage || burst == 1) {
+            assert(stats.syscalls >= messages);
+        } else {
+            assert(stats.syscalls < messages);
+        }
+        if (zerocopy && record * burst >= config.zerocopy_threshold) {
+            assert(stats.zerocopy_sends > 0);
+        }
+        std::cout << "  " << std::setw(18) << std::left << mode_names[static_cast<int>(mode)] << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(7) << ms << " ms, "
+                  << std::setw(7) << messages * record / ms / 1e3 << " MB/s, "
+                  << stats.syscalls << " syscalls";
+        if (mode == SendMode::ZeroCopy) {
+            if (zerocopy) {
+                std::cout << ", " << stats.zerocopy_sends << " zerocopy sends (" << stats.zerocopy_copied
+                          << " copied by kernel), " << stats.completion_waits << " completion waits";
+            } else {
+                std::cout << " (SO_ZEROCOPY unsupported, copied)";
+            }
+        }
+        std::cout << "\n";
+    };
+
+    std::cout << "64-byte updates in bursts of 64, 200000 messages:\n";
+    for (SendMode mode : {SendMode::PerMessage, SendMode::Gather, SendMode::ZeroCopy}) {
+        run(mode, 64, 200000, 64, 4096);
+    }
+    std::cout << "4096-byte snapshot chunks in bursts of 32, 20000 messages:\n";
+    for (SendMode mode : {SendMode::PerMessage, SendMode::Gather, SendMode::ZeroCopy}) {
+        run(mode, 4096, 20000, 32, 64);
+    }
+    std::cout << "64 KB messages flushed one at a time, 4000 messages (above the zerocopy threshold):\n";
+    for (SendMode mode : {SendMode::PerMessage, SendMode::Gather, SendMode::ZeroCopy}) {
+        run(mode, 65536, 4000, 1, 16);
+    }
+    ::close(listener);
+
+    std::cout << "Every mode delivers the stream intact and in order\n";
+    std::cout << "\nZero-copy stream publisher test completed!\n";
+}
+
 int main() {
     std::cout << "=== ORDER BOOK COMPREHENSIVE TEST SUITE ===\n";
     std::cout << "Testing implementation against assignment requirements...\n";
@@ -249,6 +2690,31 @@ int main() {
         test_fifo_priority();
         test_edge_cases();
         demonstrate_memory_pool();
+        test_concurrent_depth();
+        test_fork_snapshot();
+        test_small_order_book();
+        test_consolidated_book();
+        test_implied_pricer();
+        test_clock_service();
+        test_amend_priority();
+        benchmark_amend();
+        test_mass_quote();
+        test_pegged_orders();
+        test_lazy_cancel();
+        test_level_queues();
+        test_bplus_tree();
+        test_level_retention();
+        test_conflation();
+        test_recovery();
+        test_market_data_publisher();
+        test_journal_queue();
+        test_decimal();
+        test_parallel_startup();
+        test_message_slab();
+        test_session_gateway();
+        test_stream_publisher();
+        test_instrument_master();
+        test_position_keeper();
         stress_test();
 
         std::cout << "\n" << std::string(60, '=') << "\n";
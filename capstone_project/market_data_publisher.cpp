@@ -0,0 +1,248 @@
+#include "market_data_publisher.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+class MarketDataPublisher::Listener : public BookListener {
+public:
+    explicit Listener(MarketDataPublisher& publisher) : publisher_(publisher) {}
+
+    void on_level_update(bool is_buy, double price, uint64_t total_quantity) override {
+        publisher_.append(is_buy, price, total_quantity);
+    }
+
+    void on_operation_complete() override {
+        publisher_.poll();
+    }
+
+private:
+    MarketDataPublisher& publisher_;
+};
+
+MarketDataPublisher::~MarketDataPublisher() {
+    close();
+}
+
+bool MarketDataPublisher::open(OrderBook& book, uint16_t port, const PublisherConfig& config) {
+    if (fd_ >= 0) {
+        std::cerr << "Error: Publisher already open\n";
+        return false;
+    }
+    if (config.max_payload < sizeof(PacketHeader) + sizeof(DeltaMessage) || config.max_packets == 0) {
+        std::cerr << "Error: Publisher payload of " << config.max_payload << " bytes cannot hold a message\n";
+        return false;
+    }
+
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+        std::cerr << "Error: Cannot create UDP socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: Cannot connect UDP socket to port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    config_ = config;
+    messages_per_packet_ = (config.max_payload - sizeof(PacketHeader)) / sizeof(DeltaMessage);
+    buffer_.assign(config.max_packets * config.max_payload, 0);
+    iov_.assign(config.max_packets, iovec{});
+    headers_.assign(config.max_packets, mmsghdr{});
+    for (size_t i = 0; i < config.max_packets; ++i) {
+        iov_[i].iov_base = buffer_.data() + i * config.max_payload;
+        headers_[i].msg_hdr.msg_iov = &iov_[i];
+        headers_[i].msg_hdr.msg_iovlen = 1;
+    }
+    full_packets_ = 0;
+    open_count_ = 0;
+    pending_ = 0;
+    stats_ = PublisherStats();
+
+    book_ = &book;
+    listener_ = std::make_unique<Listener>(*this);
+    book.add_listener(listener_.get());
+    return true;
+}
+
+void MarketDataPublisher::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    flush();
+    book_->remove_listener(listener_.get());
+    listener_.reset();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void MarketDataPublisher::append(bool is_buy, double price, uint64_t total_quantity) {
+    uint64_t now = clock_.now_ns();
+    if (pending_ == 0) {
+        oldest_ns_ = now;
+    }
+    pending_++;
+    pending_ts_sum_ += now;
+
+    char* packet = buffer_.data() + full_packets_ * config_.max_payload;
+    DeltaMessage msg{};
+    msg.sequence = ++sequence_;
+    msg.price = price;
+    msg.total_quantity = total_quantity;
+    msg.is_buy = is_buy ? 1 : 0;
+    std::memcpy(packet + sizeof(PacketHeader) + open_count_ * sizeof(DeltaMessage), &msg, sizeof(msg));
+
+    if (++open_count_ == messages_per_packet_) {
+        close_packet();
+        if (full_packets_ == config_.max_packets) {
+            flush();
+        }
+    }
+}
+
+void MarketDataPublisher::close_packet() {
+    char* packet = buffer_.data() + full_packets_ * config_.max_payload;
+    PacketHeader header{};
+    header.packet_sequence = ++packet_sequence_;
+    header.first_sequence = sequence_ - open_count_ + 1;
+    header.message_count = open_count_;
+    std::memcpy(packet, &header, sizeof(header));
+    iov_[full_packets_].iov_len = sizeof(PacketHeader) + open_count_ * sizeof(DeltaMessage);
+    full_packets_++;
+    open_count_ = 0;
+}
+
+void MarketDataPublisher::poll() {
+    if (pending_ && clock_.now_ns() - oldest_ns_ >= config_.flush_interval_ns) {
+        flush();
+    }
+}
+
+void MarketDataPublisher::flush() {
+    if (open_count_) {
+        close_packet();
+    }
+    if (full_packets_ == 0) {
+        return;
+    }
+
+    size_t sent = 0;
+    while (sent < full_packets_) {
+        int n = sendmmsg(fd_, headers_.data() + sent, static_cast<unsigned>(full_packets_ - sent), 0);
+        stats_.syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Nobody listening (ECONNREFUSED) or a full queue: the packets are
+            // lost, and receivers see a sequence gap
+            stats_.send_errors++;
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+
+    uint64_t now = clock_.now_ns();
+    stats_.messages += pending_;
+    stats_.packets += full_packets_;
+    stats_.total_latency_ns += now * pending_ - pending_ts_sum_;
+    if (now - oldest_ns_ > stats_.max_latency_ns) {
+        stats_.max_latency_ns = now - oldest_ns_;
+    }
+    full_packets_ = 0;
+    pending_ = 0;
+    pending_ts_sum_ = 0;
+}
+
+MarketDataReceiver::~MarketDataReceiver() {
+    close();
+}
+
+bool MarketDataReceiver::open(uint16_t port) {
+    if (fd_ >= 0) {
+        std::cerr << "Error: Receiver already open\n";
+        return false;
+    }
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+        std::cerr << "Error: Cannot create UDP socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::cerr << "Error: Cannot bind UDP port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    buffer_.assign(BATCH * PACKET_BYTES, 0);
+    next_sequence_ = 1;
+    return true;
+}
+
+void MarketDataReceiver::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+size_t MarketDataReceiver::receive(std::vector<DeltaMessage>& out) {
+    iovec iov[BATCH];
+    mmsghdr headers[BATCH] = {};
+    for (size_t i = 0; i < BATCH; ++i) {
+        iov[i].iov_base = buffer_.data() + i * PACKET_BYTES;
+        iov[i].iov_len = PACKET_BYTES;
+        headers[i].msg_hdr.msg_iov = &iov[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t total = 0;
+    while (true) {
+        int n = recvmmsg(fd_, headers, BATCH, MSG_DONTWAIT, nullptr);
+        if (n <= 0) {
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            const char* packet = buffer_.data() + i * PACKET_BYTES;
+            PacketHeader header;
+            if (headers[i].msg_len < sizeof(header)) {
+                continue;
+            }
+            std::memcpy(&header, packet, sizeof(header));
+            if (headers[i].msg_len != sizeof(header) + header.message_count * sizeof(DeltaMessage)) {
+                continue;
+            }
+            if (header.first_sequence != next_sequence_) {
+                gaps_++;
+            }
+            next_sequence_ = header.first_sequence + header.message_count;
+            size_t base = out.size();
+            out.resize(base + header.message_count);
+            std::memcpy(&out[base], packet + sizeof(header), header.message_count * sizeof(DeltaMessage));
+            packets_++;
+        }
+        total += static_cast<size_t>(n);
+        if (static_cast<size_t>(n) < BATCH) {
+            break;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "order_book.hpp"
+#include "clock_service.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+
+// Wire format: a PacketHeader followed by message_count DeltaMessages, host
+// byte order. Sequences are per publisher and contiguous across packets.
+struct PacketHeader {
+    uint64_t packet_sequence;
+    uint64_t first_sequence;   // sequence of the first message in the packet
+    uint32_t message_count;
+    uint32_t reserved;
+};
+
+struct DeltaMessage {
+    uint64_t sequence;
+    double price;
+    uint64_t total_quantity;   // 0 = level removed
+    uint8_t is_buy;
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(PacketHeader) == 24 && sizeof(DeltaMessage) == 32, "wire format changed");
+
+struct PublisherConfig {
+    size_t max_payload = 1472;          // UDP payload that fits a 1500-byte MTU
+    size_t max_packets = 16;            // packets handed to one sendmmsg
+    uint64_t flush_interval_ns = 20000; // oldest message may wait this long
+};
+
+struct PublisherStats {
+    uint64_t messages{0};
+    uint64_t packets{0};
+    uint64_t syscalls{0};
+    uint64_t total_latency_ns{0};   // sum over messages of send time minus enqueue time
+    uint64_t max_latency_ns{0};
+    uint64_t send_errors{0};
+};
+
+// Publishes one OrderBook's level deltas over UDP loopback, packing as many
+// messages as fit into each packet. Packets go out together in one sendmmsg
+// when max_packets are full, or when the oldest pending message reaches
+// flush_interval_ns; the deadline is checked after every book operation and
+// in poll(), which an idle event loop should keep calling.
+class MarketDataPublisher {
+public:
+    MarketDataPublisher() = default;
+    ~MarketDataPublisher();
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    bool open(OrderBook& book, uint16_t port, const PublisherConfig& config = PublisherConfig());
+    void close();
+
+    // Flush if the deadline has passed
+    void poll();
+    // Send everything pending now
+    void flush();
+
+    const PublisherStats& stats() const { return stats_; }
+
+private:
+    class Listener;
+    void append(bool is_buy, double price, uint64_t total_quantity);
+    void close_packet();
+
+    int fd_{-1};
+    OrderBook* book_{nullptr};
+    std::unique_ptr<BookListener> listener_;
+    PublisherConfig config_;
+    ClockService clock_;
+    size_t messages_per_packet_{0};
+
+    std::vector<char> buffer_;          // max_packets slots of max_payload bytes
+    std::vector<iovec> iov_;
+    std::vector<mmsghdr> headers_;
+    size_t full_packets_{0};            // closed packets waiting to be sent
+    uint32_t open_count_{0};            // messages in the packet being filled
+    uint64_t sequence_{0};
+    uint64_t packet_sequence_{0};
+
+    uint64_t pending_{0};               // messages not yet sent
+    uint64_t pending_ts_sum_{0};
+    uint64_t oldest_ns_{0};
+    PublisherStats stats_;
+};
+
+// Receiving side, for consumers and tests: drains whole packets with
+// recvmmsg and checks sequence continuity
+class MarketDataReceiver {
+public:
+    MarketDataReceiver() = default;
+    ~MarketDataReceiver();
+    MarketDataReceiver(const MarketDataReceiver&) = delete;
+    MarketDataReceiver& operator=(const MarketDataReceiver&) = delete;
+
+    // Bind to loopback; port 0 picks a free one, see port()
+    bool open(uint16_t port = 0);
+    void close();
+    uint16_t port() const { return port_; }
+
+    // Append every message currently queued on the socket without blocking;
+    // returns the number of packets read
+    size_t receive(std::vector<DeltaMessage>& out);
+
+    uint64_t packets() const { return packets_; }
+    uint64_t gaps() const { return gaps_; }
+
+private:
+    static constexpr size_t BATCH = 32;
+    static constexpr size_t PACKET_BYTES = 65536;
+
+    int fd_{-1};
+    uint16_t port_{0};
+    std::vector<char> buffer_;
+    uint64_t next_sequence_{1};
+    uint64_t packets_{0};
+    uint64_t gaps_{0};
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "../SPSC_QUEUES/spsc_q3.cpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Zero-copy handoff of large messages between two pipeline threads. Messages
+// live in a fixed slab of slots; the producer fills a slot in place and
+// pushes only its 32-bit index through a Fifo3, and the consumer reads it in
+// place and hands the index back through a second Fifo3. Each payload is
+// written once and never copied, whatever its size.
+//
+// One producer thread and one consumer thread per slab. Both queues hold as
+// many entries as there are slots, so publish() and release() never fail;
+// allocate() fails only when every slot is in flight.
+template<typename T>
+class MessageSlab {
+public:
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    explicit MessageSlab(uint32_t capacity)
+        : slots_(std::make_unique<Slot[]>(capacity)), handoff_(capacity), returns_(capacity) {
+        free_.reserve(capacity);
+        for (uint32_t i = capacity; i > 0; --i) {
+            free_.push_back(i - 1);
+        }
+    }
+
+    MessageSlab(const MessageSlab&) = delete;
+    MessageSlab& operator=(const MessageSlab&) = delete;
+
+    uint32_t capacity() const { return static_cast<uint32_t>(handoff_.capacity()); }
+
+    T& operator[](uint32_t slot) { return slots_[slot].value; }
+    const T& operator[](uint32_t slot) const { return slots_[slot].value; }
+
+    // Producer side: take a free slot, reclaiming released ones in a batch
+    // when the local free list runs dry
+    uint32_t allocate() {
+        if (free_.empty()) {
+            uint32_t slot;
+            while (returns_.pop(slot)) {
+                free_.push_back(slot);
+            }
+            if (free_.empty()) {
+                return INVALID_SLOT;
+            }
+        }
+        uint32_t slot = free_.back();
+        free_.pop_back();
+        return slot;
+    }
+
+    // Producer side: hand a filled slot to the consumer
+    void publish(uint32_t slot) { handoff_.push(slot); }
+
+    // Consumer side: next published slot, false when none is waiting
+    bool receive(uint32_t& slot) { return handoff_.pop(slot); }
+
+    // Consumer side: give a slot back once done with its contents
+    void release(uint32_t slot) { returns_.push(slot); }
+
+private:
+    // Slots on their own cache lines so that neighbours filled and read by
+    // different threads do not false-share
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    Fifo3<uint32_t> handoff_;   // producer -> consumer
+    Fifo3<uint32_t> returns_;   // consumer -> producer
+    std::vector<uint32_t> free_; // producer-owned
+};
@@ -1,20 +1,43 @@
 #include "order_book.hpp"
+#include "bplus_tree.hpp"
+#include "decimal.hpp"
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <algorithm>
 #include <iostream>
-#include <iomanip>
 #include <limits>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 using Price = double;
 
 constexpr size_t MEMORY_POOL_BLOCK_SIZE = 1024;
-constexpr size_t MAX_ORDER_QUANTITY = 1000000;
-constexpr double MIN_PRICE = 0.01;
-constexpr double MAX_PRICE = 1000000.0;
+
+// Binary snapshot layout: SnapshotHeader, order_count records, then the
+// slot count of each registered quoter (uint32_t) so that restored quote
+// orders get their slots back
+constexpr uint32_t SNAPSHOT_MAGIC = 0x3253424F; // "OBS2"
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t record_size;
+    uint64_t version;
+    uint64_t order_count;
+    uint64_t quoter_count;
+};
+
+struct SnapshotRecord {
+    uint64_t order_id;
+    double price;
+    uint64_t quantity;
+    uint64_t timestamp_ns;
+    uint8_t is_buy;
+    uint8_t peg_type;      // 0 = limit order, otherwise PegType + 1
+    uint8_t padding[6];
+    double peg_offset;
+};
 
 template<typename T>
 class SimpleMemoryPool {
@@ -76,46 +99,71 @@ private:
     }
 };
 
+// FIFO queue of one price level. The queue is either an intrusive doubly
+// linked list through Order::next/prev, or with ORDER_BOOK_CONTIGUOUS_LEVELS a
+// vector of (order, quantity) entries where removal leaves a tombstone that
+// is compacted away on a later append. Everything outside this struct goes
+// through front(), for_each() and the mutators below, never the raw links.
 struct InternalPriceLevel {
-    double price;
+    double price; // must stay first: SimpleMemoryPool keeps its free list here
     uint64_t total_quantity{0};
-    Order* first_order{nullptr};
-    Order* last_order{nullptr};
     size_t order_count{0};
+    size_t cancelled_count{0}; // lazily cancelled orders still linked into the queue
     bool is_active{true};
+    ConcurrentLevelNode* depth_node{nullptr};
+
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+    struct QueueEntry {
+        Order* order;      // nullptr = tombstone
+        uint64_t quantity; // 0 for lazily cancelled orders
+    };
+    std::vector<QueueEntry> queue;
+    size_t head{0};       // first non-tombstone entry
+    size_t tombstones{0}; // tombstones at or after head
+#else
+    Order* first_order{nullptr};
+    Order* last_order{nullptr};
+#endif
 
     InternalPriceLevel() : price(0.0) {}
     InternalPriceLevel(double p) : price(p) {}
 
     InternalPriceLevel(const InternalPriceLevel& other)
-        : price(other.price), total_quantity(other.total_quantity),
-          first_order(nullptr), last_order(nullptr), order_count(other.order_count),
-          is_active(other.is_active) {}
+        : price(other.price), total_quantity(other.total_quantity), order_count(other.order_count),
+          cancelled_count(other.cancelled_count), is_active(other.is_active), depth_node(nullptr) {}
 
     InternalPriceLevel& operator=(const InternalPriceLevel& other) {
         if (this != &other) {
-            price = other.price;
+            reset(other.price);
             total_quantity = other.total_quantity;
-            first_order = nullptr;
-            last_order = nullptr;
             order_count = other.order_count;
+            cancelled_count = other.cancelled_count;
             is_active = other.is_active;
         }
         return *this;
     }
 
-    void add_order(Order* order) {
-        if (first_order == nullptr) {
-            first_order = order;
-            last_order = order;
-        } else {
-            order->prev = last_order;
-            if (last_order) {
-                last_order->next = order;
-            }
-            last_order = order;
-        }
+    // Reinitialise a pooled level; the contiguous queue keeps its capacity
+    void reset(double p) {
+        price = p;
+        total_quantity = 0;
+        order_count = 0;
+        cancelled_count = 0;
+        is_active = true;
+        depth_node = nullptr;
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        queue.clear();
+        head = 0;
+        tombstones = 0;
+#else
+        first_order = nullptr;
+        last_order = nullptr;
+#endif
+    }
 
+    void add_order(Order* order) {
+        order->level = this;
+        append(order);
         total_quantity += order->quantity;
         order_count++;
     }
@@ -126,7 +174,151 @@ struct InternalPriceLevel {
         }
 
         order->is_active = false;
+        detach(order);
+
+        total_quantity -= order->quantity;
+        order_count--;
+    }
+
+    // Lazy cancel: the order leaves the level's totals now but stays linked
+    // until matching reaches it or a sweep runs
+    void mark_cancelled(Order* order) {
+        order->is_active = false;
+        total_quantity -= order->quantity;
+        order_count--;
+        cancelled_count++;
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        queue[order->queue_slot].quantity = 0;
+#endif
+    }
+
+    // Physically unlink an order previously passed to mark_cancelled
+    void drop_cancelled(Order* order) {
+        detach(order);
+        cancelled_count--;
+    }
 
+    // Change a live order's remaining quantity without touching its position
+    void set_quantity(Order* order, uint64_t quantity) {
+        total_quantity = total_quantity - order->quantity + quantity;
+        order->quantity = quantity;
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        queue[order->queue_slot].quantity = quantity;
+#endif
+    }
+
+    // Relink an order behind every other order of this level
+    void move_to_tail(Order* order) {
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        if (order->queue_slot + 1 == queue.size()) {
+            return;
+        }
+#else
+        if (order == last_order) {
+            return;
+        }
+#endif
+        detach(order);
+        append(order);
+    }
+
+    Order* front() const {
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        return head < queue.size() ? queue[head].order : nullptr;
+#else
+        return first_order;
+#endif
+    }
+
+    // Visit every linked order in FIFO order, lazily cancelled ones included.
+    // The callback may drop the order it is given.
+    template<typename F>
+    void for_each(F&& f) const {
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        for (size_t i = head; i < queue.size(); ++i) {
+            if (queue[i].order) {
+                f(queue[i].order);
+            }
+        }
+#else
+        for (Order* order = first_order; order;) {
+            Order* next = order->next;
+            f(order);
+            order = next;
+        }
+#endif
+    }
+
+    // Live quantity queued ahead of an order of this level
+    uint64_t quantity_ahead(const Order* order) const {
+        uint64_t ahead = 0;
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+        for (size_t i = head; i < order->queue_slot; ++i) {
+            ahead += queue[i].quantity;
+        }
+#else
+        for (const Order* o = first_order; o != order; o = o->next) {
+            ahead += o->is_active ? o->quantity : 0;
+        }
+#endif
+        return ahead;
+    }
+
+    bool is_empty() const {
+        return order_count == 0;
+    }
+
+private:
+#if ORDER_BOOK_CONTIGUOUS_LEVELS
+    void append(Order* order) {
+        // Compact once tombstones and the consumed prefix are half the queue;
+        // amortised O(1) per append
+        if (queue.size() >= 32 && (head + tombstones) * 2 > queue.size()) {
+            compact();
+        }
+        order->queue_slot = static_cast<uint32_t>(queue.size());
+        queue.push_back({order, order->is_active ? order->quantity : 0});
+    }
+
+    void detach(Order* order) {
+        queue[order->queue_slot] = {nullptr, 0};
+        tombstones++;
+        while (head < queue.size() && !queue[head].order) {
+            head++;
+            tombstones--;
+        }
+        if (head == queue.size()) {
+            queue.clear();
+            head = 0;
+        }
+    }
+
+    void compact() {
+        size_t out = 0;
+        for (size_t i = head; i < queue.size(); ++i) {
+            if (queue[i].order) {
+                queue[out] = queue[i];
+                queue[out].order->queue_slot = static_cast<uint32_t>(out);
+                out++;
+            }
+        }
+        queue.resize(out);
+        head = 0;
+        tombstones = 0;
+    }
+#else
+    void append(Order* order) {
+        order->next = nullptr;
+        order->prev = last_order;
+        if (last_order) {
+            last_order->next = order;
+        } else {
+            first_order = order;
+        }
+        last_order = order;
+    }
+
+    void detach(Order* order) {
         Order* prev = order->prev;
         Order* next = order->next;
 
@@ -141,32 +333,104 @@ struct InternalPriceLevel {
         } else {
             last_order = prev;
         }
-
-        total_quantity -= order->quantity;
-        order_count--;
     }
+#endif
+};
 
-    bool is_empty() const {
-        return order_count == 0;
-    }
+#if ORDER_BOOK_BTREE_LEVELS
+using BidLevelMap = BPlusTree<InternalPriceLevel*, true>;
+using AskLevelMap = BPlusTree<InternalPriceLevel*, false>;
+#else
+using BidLevelMap = std::map<Price, InternalPriceLevel*, std::greater<Price>>;
+using AskLevelMap = std::map<Price, InternalPriceLevel*>;
+#endif
+
+// The internals below are templated on the side of the book so that level
+// lookup, matching and removal compile to one branch-free path per side.
+// Public entry points look at is_buy once and dispatch.
+enum class Side { Buy, Sell };
+
+template<Side S>
+struct SideTraits;
+
+template<>
+struct SideTraits<Side::Buy> {
+    static constexpr bool is_buy = true;
+    static bool better(double a, double b) { return a > b; }
+};
+
+template<>
+struct SideTraits<Side::Sell> {
+    static constexpr bool is_buy = false;
+    static bool better(double a, double b) { return a < b; }
 };
 
 // Implementation class using PIMPL idiom
 class OrderBook::Impl {
 public:
-    std::map<Price, InternalPriceLevel*, std::greater<Price>> bids_;
-    std::map<Price, InternalPriceLevel*> asks_;
+    BidLevelMap bids_;
+    AskLevelMap asks_;
     std::unordered_map<uint64_t, Order*> order_lookup_;
     SimpleMemoryPool<Order> order_pool_;
     SimpleMemoryPool<InternalPriceLevel> level_pool_;
 
+    std::vector<BookListener*> listeners_;
+    TopOfBook last_top_;
+
+    // Optional lock-free mirrors of bids_/asks_ for concurrent depth readers
+    std::unique_ptr<ConcurrentBidIndex> concurrent_bids_;
+    std::unique_ptr<ConcurrentAskIndex> concurrent_asks_;
+
+    // Non-displayed pegged orders, one group per (type, side, offset). The
+    // limit cap stays on each order (Order::price, 0 = none); within a group
+    // orders with the same cap share a FIFO, kept best cap first, whose price
+    // field holds the cap. Effective prices are derived from the lit BBO
+    // whenever matching looks at a group. Emptied queues and groups are freed
+    // and group slots reused, so only live groups are ever visited.
+    struct PegGroup {
+        PegType type;
+        bool is_buy;
+        double offset;
+        std::map<double, InternalPriceLevel> queues;   // by cap_key()
+        size_t order_count{0};
+    };
+    std::vector<std::unique_ptr<PegGroup>> peg_groups_;   // Order::peg_group - 1; null when free
+    std::vector<uint32_t> free_peg_groups_;
+    std::map<std::pair<int, double>, uint32_t> live_peg_groups_[2];   // [is_buy]: (type, offset) -> peg_group
+    size_t peg_order_count_{0};
+
+    // Market maker quote slots: O(1) access to each resting quote order
+    struct Quoter {
+        std::vector<Order*> bids;
+        std::vector<Order*> asks;
+    };
+    std::vector<Quoter> quoters_;
+
+    // Emptied levels kept in the maps (is_active = false) so that a touch
+    // which empties and refills does not erase and re-insert its node
+    size_t level_retention_{0};
+    std::vector<InternalPriceLevel*> retained_bids_;
+    std::vector<InternalPriceLevel*> retained_asks_;
+
+    // Lazy cancel mode: cancelled orders stay linked, and in order_lookup_,
+    // until reclaimed. A level left with only cancelled orders is hidden
+    // (is_active = false, cancelled_count > 0) until the sweep drops it.
+    bool lazy_cancel_{false};
+    size_t cancelled_pending_{0};
+    size_t cancelled_lookups_{0};   // order_lookup_ entries that are lazily cancelled orders
+    size_t hidden_levels_[2]{0, 0}; // [is_buy]
+    std::vector<InternalPriceLevel*> swept_levels_;
+
+    InstrumentParams instrument_;
+
     bool matching_in_progress_{false};
     uint64_t version_{0};
+    uint64_t latest_timestamp_ns_{0};
 
     ~Impl() {
-        // Clean up orders
+        // Clean up orders; lazily cancelled ones go with their levels below
         for (auto& [id, order] : order_lookup_) {
-            if (order) {
+            if (order && order->is_active) {
                 order_pool_.deallocate(order);
             }
         }
@@ -175,6 +439,7 @@ public:
         // Clean up bid levels
         for (auto& [price, level] : bids_) {
             if (level) {
+                release_cancelled(level, SIZE_MAX);
                 level_pool_.deallocate(level);
             }
         }
@@ -183,70 +448,522 @@ public:
         // Clean up ask levels
         for (auto& [price, level] : asks_) {
             if (level) {
+                release_cancelled(level, SIZE_MAX);
                 level_pool_.deallocate(level);
             }
         }
         asks_.clear();
     }
 
-    InternalPriceLevel* get_or_create_level(Price price, bool is_buy) {
-        if (is_buy) {
-            auto it = bids_.find(price);
-            if (it != bids_.end()) {
-                return it->second;
-            }
+    template<Side S>
+    auto& levels() {
+        if constexpr (S == Side::Buy) {
+            return bids_;
+        } else {
+            return asks_;
+        }
+    }
 
-            InternalPriceLevel* level = level_pool_.allocate();
-            *level = InternalPriceLevel(price);
-            level->total_quantity = 0;
-            level->order_count = 0;
-            level->is_active = true;
-            level->first_order = nullptr;
-            level->last_order = nullptr;
-            bids_[price] = level;
-            return level;
+    template<Side S>
+    const auto& levels() const {
+        if constexpr (S == Side::Buy) {
+            return bids_;
+        } else {
+            return asks_;
+        }
+    }
+
+    template<Side S>
+    auto* concurrent_levels() {
+        if constexpr (S == Side::Buy) {
+            return concurrent_bids_.get();
         } else {
-            auto it = asks_.find(price);
-            if (it != asks_.end()) {
-                return it->second;
-            }
-
-            InternalPriceLevel* level = level_pool_.allocate();
-            *level = InternalPriceLevel(price);
-            level->total_quantity = 0;
-            level->order_count = 0;
-            level->is_active = true;
-            level->first_order = nullptr;
-            level->last_order = nullptr;
-            asks_[price] = level;
+            return concurrent_asks_.get();
+        }
+    }
+
+    template<Side S>
+    auto& retained_levels() {
+        if constexpr (S == Side::Buy) {
+            return retained_bids_;
+        } else {
+            return retained_asks_;
+        }
+    }
+
+    // Best displayed level; retained empty levels are skipped
+    template<Side S>
+    InternalPriceLevel* best_level() const {
+        for (const auto& [price, level] : levels<S>()) {
+            if (level->is_active) {
+                return level;
+            }
+        }
+        return nullptr;
+    }
+
+    template<Side S>
+    InternalPriceLevel* get_or_create_level(Price price) {
+        auto& side = levels<S>();
+        auto it = side.find(price);
+        if (it != side.end()) {
+            InternalPriceLevel* level = it->second;
+            if (!level->is_active) {
+                if (level->cancelled_count) {
+                    unhide_level<S>(level);
+                } else {
+                    revive_level<S>(level);
+                }
+            }
             return level;
         }
+
+        InternalPriceLevel* level = level_pool_.allocate();
+        level->reset(price);
+        if (auto* index = concurrent_levels<S>()) {
+            level->depth_node = index->insert(price);
+        }
+        side[price] = level;
+        return level;
+    }
+
+    template<Side S>
+    InternalPriceLevel* get_level(Price price) const {
+        const auto& side = levels<S>();
+        auto it = side.find(price);
+        return (it != side.end()) ? it->second : nullptr;
     }
 
     InternalPriceLevel* get_level(Price price, bool is_buy) const {
-        if (is_buy) {
-            auto it = bids_.find(price);
-            return (it != bids_.end()) ? it->second : nullptr;
+        return is_buy ? get_level<Side::Buy>(price) : get_level<Side::Sell>(price);
+    }
+
+    template<Side S>
+    void remove_price_level(Price price) {
+        auto& side = levels<S>();
+        auto it = side.find(price);
+        if (it != side.end()) {
+            unpublish_level<S>(it->second);
+            release_cancelled(it->second, SIZE_MAX);
+            if (level_retention_) {
+                retain_level<S>(it->second);
+                return;
+            }
+            level_pool_.deallocate(it->second);
+            side.erase(it);
+        }
+    }
+
+    // Hide an emptied level instead of erasing it. Past the retention limit
+    // the retained level farthest from the touch is reclaimed.
+    template<Side S>
+    void retain_level(InternalPriceLevel* level) {
+        level->is_active = false;
+        auto& retained = retained_levels<S>();
+        retained.push_back(level);
+        if (retained.size() > level_retention_) {
+            reclaim_retained<S>(level_retention_);
+        }
+    }
+
+    template<Side S>
+    void reclaim_retained(size_t keep) {
+        auto& retained = retained_levels<S>();
+        while (retained.size() > keep) {
+            InternalPriceLevel* best = best_level<S>();
+            auto farthest = std::max_element(retained.begin(), retained.end(),
+                [best](const InternalPriceLevel* a, const InternalPriceLevel* b) {
+                    return best ? std::fabs(a->price - best->price) < std::fabs(b->price - best->price)
+                                : SideTraits<S>::better(a->price, b->price);
+                });
+            InternalPriceLevel* level = *farthest;
+            *farthest = retained.back();
+            retained.pop_back();
+            levels<S>().erase(levels<S>().find(level->price));
+            level_pool_.deallocate(level);
+        }
+    }
+
+    template<Side S>
+    void revive_level(InternalPriceLevel* level) {
+        auto& retained = retained_levels<S>();
+        *std::find(retained.begin(), retained.end(), level) = retained.back();
+        retained.pop_back();
+        level->is_active = true;
+        if (auto* index = concurrent_levels<S>()) {
+            level->depth_node = index->insert(level->price);
+        }
+    }
+
+    // A level whose live orders were all lazily cancelled leaves the book's
+    // view at once but stays in the map until the sweep reclaims its orders
+    template<Side S>
+    void hide_level(InternalPriceLevel* level) {
+        unpublish_level<S>(level);
+        level->is_active = false;
+        hidden_levels_[SideTraits<S>::is_buy]++;
+    }
+
+    template<Side S>
+    void unhide_level(InternalPriceLevel* level) {
+        level->is_active = true;
+        hidden_levels_[SideTraits<S>::is_buy]--;
+        if (auto* index = concurrent_levels<S>()) {
+            level->depth_node = index->insert(level->price);
+        }
+    }
+
+    // Every change to a level's aggregate quantity flows through here: the
+    // concurrent mirror and any listeners see the same level deltas
+    template<Side S>
+    void publish_level(InternalPriceLevel* level) {
+        if (level->depth_node) {
+            ConcurrentBidIndex::update(level->depth_node, level->total_quantity, level->order_count);
+        }
+        for (BookListener* listener : listeners_) {
+            listener->on_level_update(SideTraits<S>::is_buy, level->price, level->total_quantity);
+        }
+    }
+
+    template<Side S>
+    void unpublish_level(InternalPriceLevel* level) {
+        if (level->depth_node) {
+            concurrent_levels<S>()->erase(level->price);
+            level->depth_node = nullptr;
+        }
+        for (BookListener* listener : listeners_) {
+            listener->on_level_update(SideTraits<S>::is_buy, level->price, 0);
+        }
+    }
+
+    // Take an order out of its level, dropping the level if it empties
+    template<Side S>
+    void unlink_order(Order* order) {
+        if (order->peg_group) {
+            unlink_pegged(order);
+            return;
+        }
+        InternalPriceLevel* level = get_level<S>(order->price);
+        if (!level) {
+            return;
+        }
+        level->remove_order(order);
+        if (level->is_empty()) {
+            remove_price_level<S>(level->price);
         } else {
-            auto it = asks_.find(price);
-            return (it != asks_.end()) ? it->second : nullptr;
+            publish_level<S>(level);
         }
     }
 
-    void remove_price_level(Price price, bool is_buy) {
-        if (is_buy) {
-            auto it = bids_.find(price);
-            if (it != bids_.end()) {
-                level_pool_.deallocate(it->second);
-                bids_.erase(it);
+    // Return up to `budget` lazily cancelled orders of a level to the pool
+    size_t release_cancelled(InternalPriceLevel* level, size_t budget) {
+        size_t released = 0;
+        if (level->cancelled_count == 0) {
+            return 0;
+        }
+        level->for_each([&](Order* order) {
+            if (!order->is_active && released < budget) {
+                level->drop_cancelled(order);
+                reclaim_cancelled(order);
+                released++;
             }
+        });
+        return released;
+    }
+
+    // Return an unlinked, lazily cancelled order to the pool. Its id may have
+    // been reused since, in which case the lookup entry is no longer its own.
+    void reclaim_cancelled(Order* order) {
+        auto it = order_lookup_.find(order->order_id);
+        if (it != order_lookup_.end() && it->second == order) {
+            order_lookup_.erase(it);
+            cancelled_lookups_--;
+        }
+        order_pool_.deallocate(order);
+        cancelled_pending_--;
+    }
+
+    // Matching only ever looks at the head of a queue, so dead orders there
+    // are reclaimed on the way
+    void drop_cancelled_head(InternalPriceLevel* level) {
+        while (level->front() && !level->front()->is_active) {
+            Order* order = level->front();
+            level->drop_cancelled(order);
+            reclaim_cancelled(order);
+        }
+    }
+
+    // Flag an order as cancelled without unlinking it: no level lookup, no
+    // hash erase, no map erase. The order is reached through its cached level
+    // and keeps its lookup entry; a level left with no live orders is hidden
+    // so the BBO and snapshots stay exact. The sweep does the rest.
+    template<Side S>
+    void cancel_lazily(Order* order) {
+        InternalPriceLevel* level = order->level;
+        level->mark_cancelled(order);
+        cancelled_pending_++;
+        cancelled_lookups_++;
+        if (level->is_empty()) {
+            hide_level<S>(level);
         } else {
-            auto it = asks_.find(price);
-            if (it != asks_.end()) {
-                level_pool_.deallocate(it->second);
-                asks_.erase(it);
+            publish_level<S>(level);
+        }
+    }
+
+    // Reclaim up to `budget` lazily cancelled orders, then drop the hidden
+    // levels that no longer hold any
+    template<Side S>
+    size_t sweep_cancelled(size_t budget) {
+        size_t released = 0;
+        for (auto& [price, level] : levels<S>()) {
+            if (released == budget || cancelled_pending_ == 0) {
+                break;
+            }
+            if (level->cancelled_count) {
+                released += release_cancelled(level, budget - released);
+                if (!level->is_active && !level->cancelled_count) {
+                    swept_levels_.push_back(level);
+                }
             }
         }
+        // Erased after the walk: a B+tree erase invalidates its iterators
+        for (InternalPriceLevel* level : swept_levels_) {
+            hidden_levels_[SideTraits<S>::is_buy]--;
+            if (level_retention_) {
+                retain_level<S>(level);
+            } else {
+                levels<S>().erase(levels<S>().find(level->price));
+                level_pool_.deallocate(level);
+            }
+        }
+        swept_levels_.clear();
+        return released;
+    }
+
+    // Queue an order at the tail of its price level
+    template<Side S>
+    void link_order(Order* order) {
+        order->is_active = true;
+        InternalPriceLevel* level = get_or_create_level<S>(order->price);
+        level->add_order(order);
+        publish_level<S>(level);
+    }
+
+    static uint64_t quote_order_id(uint32_t quoter, bool is_buy, size_t slot) {
+        return QUOTE_ORDER_ID_FLAG | (static_cast<uint64_t>(quoter) << 32) |
+               (is_buy ? 0 : 1ull << 31) | static_cast<uint64_t>(slot);
+    }
+
+    // The quoter slot a generated quote order ID names, nullptr if none
+    Order** quote_slot(uint64_t id) {
+        uint32_t quoter = quote_order_quoter(id);
+        size_t slot = id & 0x7FFFFFFF;
+        if (quoter >= quoters_.size()) {
+            return nullptr;
+        }
+        auto& slots = (id & (1ull << 31)) ? quoters_[quoter].asks : quoters_[quoter].bids;
+        return slot < slots.size() ? &slots[slot] : nullptr;
+    }
+
+    // Forget a quote order's slot once it leaves the book by fill or cancel
+    void release_quote_slot(const Order* order) {
+        if (!(order->order_id & QUOTE_ORDER_ID_FLAG)) {
+            return;
+        }
+        Order** slot = quote_slot(order->order_id);
+        if (slot && *slot == order) {
+            *slot = nullptr;
+        }
+    }
+
+    // Bring one quote slot to the requested price/size with the cheapest change
+    template<Side S>
+    void apply_quote(Order*& slot, uint64_t id, double price, uint64_t quantity, uint64_t timestamp_ns) {
+        Order* order = slot;
+        if (!order) {
+            if (quantity == 0) {
+                return;
+            }
+            order = order_pool_.allocate();
+            *order = Order(id, SideTraits<S>::is_buy, price, quantity, timestamp_ns);
+            order_lookup_[id] = order;
+            latest_timestamp_ns_ = std::max(latest_timestamp_ns_, timestamp_ns);
+            link_order<S>(order);
+            slot = order;
+        } else if (quantity == 0) {
+            unlink_order<S>(order);
+            order_lookup_.erase(order->order_id);
+            order_pool_.deallocate(order);
+            slot = nullptr;
+        } else if (order->price != price) {
+            unlink_order<S>(order);
+            order->price = price;
+            order->quantity = quantity;
+            requeue_timestamp(order);
+            link_order<S>(order);
+        } else if (order->quantity != quantity) {
+            InternalPriceLevel* level = get_level<S>(price);
+            if (quantity > order->quantity) {
+                level->move_to_tail(order);
+                requeue_timestamp(order);
+            }
+            level->set_quantity(order, quantity);
+            publish_level<S>(level);
+        }
+    }
+
+    // An order that loses priority is stamped as the newest order in the book,
+    // so that if it crosses on requeue it trades as the aggressor
+    void requeue_timestamp(Order* order) {
+        latest_timestamp_ns_ = std::max(latest_timestamp_ns_ + 1, order->timestamp_ns);
+        order->timestamp_ns = latest_timestamp_ns_;
+    }
+
+    TopOfBook top_of_book() const {
+        TopOfBook top;
+        if (const InternalPriceLevel* bid = best_level<Side::Buy>()) {
+            top.bid_price = bid->price;
+            top.bid_quantity = bid->total_quantity;
+        }
+        if (const InternalPriceLevel* ask = best_level<Side::Sell>()) {
+            top.ask_price = ask->price;
+            top.ask_quantity = ask->total_quantity;
+        }
+        return top;
+    }
+
+    // Top `depth` displayed levels of one side
+    template<Side S>
+    void displayed_levels(size_t depth, std::vector<PriceLevel>& out) const {
+        for (const auto& [price, level] : levels<S>()) {
+            if (out.size() == depth) {
+                break;
+            }
+            if (level->is_active) {
+                out.emplace_back(level->price, level->total_quantity);
+            }
+        }
+    }
+
+    // Called once per public operation, after matching has settled
+    void notify_top_of_book() {
+        if (listeners_.empty()) {
+            return;
+        }
+        for (BookListener* listener : listeners_) {
+            listener->on_operation_complete();
+        }
+        TopOfBook top = top_of_book();
+        if (top == last_top_) {
+            return;
+        }
+        last_top_ = top;
+        for (BookListener* listener : listeners_) {
+            listener->on_top_of_book(top);
+        }
+    }
+
+    template<typename Index, typename Levels>
+    void mirror_levels(Index& index, Levels& levels) {
+        for (auto& [price, level] : levels) {
+            if (!level->is_active) {
+                continue;
+            }
+            level->depth_node = index.insert(price);
+            ConcurrentBidIndex::update(level->depth_node, level->total_quantity, level->order_count);
+        }
+    }
+
+    struct MatchCandidate {
+        InternalPriceLevel* level{nullptr};
+        double price{0.0};
+        bool pegged{false};
+    };
+
+    // Orders caps best-first: buys by highest cap, sells by lowest, uncapped first
+    static double cap_key(bool is_buy, double limit) {
+        if (!is_buy) {
+            return limit;
+        }
+        return limit == 0.0 ? -std::numeric_limits<double>::infinity() : -limit;
+    }
+
+    // Uncapped price of a peg group under the current lit BBO, on the
+    // instrument's tick grid; false when its reference side is empty
+    bool peg_price(const PegGroup& group, double& price) const {
+        const InternalPriceLevel* best_bid = best_level<Side::Buy>();
+        const InternalPriceLevel* best_ask = best_level<Side::Sell>();
+        bool has_bid = best_bid != nullptr;
+        bool has_ask = best_ask != nullptr;
+        double bid = has_bid ? best_bid->price : 0.0;
+        double ask = has_ask ? best_ask->price : 0.0;
+
+        double reference;
+        switch (group.type) {
+        case PegType::Primary:
+            if (group.is_buy ? !has_bid : !has_ask) return false;
+            reference = group.is_buy ? bid : ask;
+            break;
+        case PegType::Market:
+            if (group.is_buy ? !has_ask : !has_bid) return false;
+            reference = group.is_buy ? ask : bid;
+            break;
+        case PegType::Midpoint:
+        default:
+            if (!has_bid || !has_ask) return false;
+            reference = (bid + ask) / 2.0;
+            break;
+        }
+
+        price = group.is_buy ? reference - group.offset : reference + group.offset;
+        if (instrument_.tick_size > 0.0) {
+            // Off-grid references (a midpoint, say) round away from the
+            // other side, then snap to the decimal the tick denotes
+            double ticks = price / instrument_.tick_size;
+            ticks = group.is_buy ? std::floor(ticks + 1e-9) : std::ceil(ticks - 1e-9);
+            price = decimal::from_units(decimal::to_units(ticks * instrument_.tick_size, decimal::MAX_SCALE),
+                                        decimal::MAX_SCALE);
+        }
+        return true;
+    }
+
+    // Best resting queue on one side: the lit touch, or a peg queue whose
+    // derived price is strictly better (lit wins ties, earlier pegs win ties
+    // among pegs). Visits each live group of the side, and within a group
+    // only the caps that do not bind plus the first one that does.
+    template<Side S>
+    MatchCandidate best_candidate() const {
+        MatchCandidate best;
+        if (InternalPriceLevel* level = best_level<S>()) {
+            best = {level, level->price, false};
+        }
+        if (peg_order_count_ == 0) {
+            return best;
+        }
+
+        for (const auto& [key, index] : live_peg_groups_[SideTraits<S>::is_buy]) {
+            PegGroup& group = *peg_groups_[index - 1];
+            double reference;
+            if (!peg_price(group, reference)) {
+                continue;
+            }
+            for (auto& [cap, queue] : group.queues) {
+                bool binding = queue.price > 0.0 && SideTraits<S>::better(reference, queue.price);
+                double price = binding ? queue.price : reference;
+                if (price >= MIN_PRICE) {
+                    bool better = !best.level || SideTraits<S>::better(price, best.price);
+                    bool earlier = best.pegged && price == best.price &&
+                                   queue.front()->timestamp_ns < best.level->front()->timestamp_ns;
+                    if (better || earlier) {
+                        best = {&queue, price, true};
+                    }
+                }
+                if (binding) {
+                    break;   // later caps bind tighter still
+                }
+            }
+        }
+        return best;
     }
 
     void match_orders() {
@@ -256,26 +973,28 @@ public:
 
         matching_in_progress_ = true;
 
-        bool matched = true;
-        while (matched && !bids_.empty() && !asks_.empty()) {
-            matched = false;
-
-            auto best_bid = bids_.begin();
-            auto best_ask = asks_.begin();
+        while (true) {
+            MatchCandidate bid = best_candidate<Side::Buy>();
+            MatchCandidate ask = best_candidate<Side::Sell>();
 
-            if (best_bid->first < best_ask->first) {
+            if (!bid.level || !ask.level || bid.price < ask.price) {
                 break;
             }
 
-            InternalPriceLevel* bid_level = best_bid->second;
-            InternalPriceLevel* ask_level = best_ask->second;
+            InternalPriceLevel* bid_level = bid.level;
+            InternalPriceLevel* ask_level = ask.level;
 
             if (!bid_level->is_active || !ask_level->is_active) {
                 break;
             }
 
-            Order* bid_order = bid_level->first_order;
-            Order* ask_order = ask_level->first_order;
+            if (cancelled_pending_) {
+                drop_cancelled_head(bid_level);
+                drop_cancelled_head(ask_level);
+            }
+
+            Order* bid_order = bid_level->front();
+            Order* ask_order = ask_level->front();
 
             if (!bid_order || !ask_order || !bid_order->is_active || !ask_order->is_active) {
                 break;
@@ -286,52 +1005,306 @@ public:
             uint64_t match_quantity = std::min(bid_qty, ask_qty);
 
             double match_price = (bid_order->timestamp_ns <= ask_order->timestamp_ns) 
-                                ? bid_order->price : ask_order->price;
-
-            std::cout << "MATCH: " << match_quantity << " @ " << match_price 
-                      << " (Bid: " << bid_order->order_id << ", Ask: " << ask_order->order_id << ")\n";
-
-            bid_order->quantity -= match_quantity;
-            ask_order->quantity -= match_quantity;
+                                ? bid.price : ask.price;
 
-            bool bid_removed = remove_filled_order(bid_order, bid_level, best_bid, true);
-            bool ask_removed = remove_filled_order(ask_order, ask_level, best_ask, false);
+            char line[MATCH_LINE_MAX];
+            size_t len = format_match_line(match_quantity, match_price, bid_order->order_id, ask_order->order_id, line);
+            std::cout.write(line, static_cast<std::streamsize>(len));
 
-            matched = true;
+            bid_level->set_quantity(bid_order, bid_qty - match_quantity);
+            ask_level->set_quantity(ask_order, ask_qty - match_quantity);
 
-            if (bid_removed || ask_removed) {
-                continue;
+            if (!listeners_.empty()) {
+                Trade trade{bid_order->order_id, ask_order->order_id, match_price, match_quantity,
+                            bid_qty - match_quantity, ask_qty - match_quantity};
+                for (BookListener* listener : listeners_) {
+                    listener->on_trade(trade);
+                }
             }
+
+            remove_filled_order<Side::Buy>(bid_order, bid);
+            remove_filled_order<Side::Sell>(ask_order, ask);
         }
 
         matching_in_progress_ = false;
     }
 
-    bool remove_filled_order(Order* order, InternalPriceLevel* level, 
-                           const std::map<Price, InternalPriceLevel*>::iterator& map_it, bool is_buy) {
+    // Drop a fully filled order; a lit level it empties is always the touch
+    template<Side S>
+    void remove_filled_order(Order* order, const MatchCandidate& from) {
+        InternalPriceLevel* level = from.level;
+        if (from.pegged) {
+            if (order->quantity == 0) {
+                unlink_pegged(order);
+                order_lookup_.erase(order->order_id);
+                order_pool_.deallocate(order);
+            }
+            return;
+        }
+
         if (order->quantity == 0) {
             level->remove_order(order);
 
             order_lookup_.erase(order->order_id);
+            release_quote_slot(order);
             order_pool_.deallocate(order);
 
             if (level->is_empty()) {
-                if (is_buy) {
-                    bids_.erase(map_it);
-                } else {
-                    asks_.erase(map_it);
+                unpublish_level<S>(level);
+                release_cancelled(level, SIZE_MAX);
+                if (level_retention_) {
+                    retain_level<S>(level);
+                    return;
+                }
+                // The touch is the first entry unless hidden levels precede it
+                auto it = levels<S>().begin();
+                if (it->second != level) {
+                    it = levels<S>().find(level->price);
                 }
+                levels<S>().erase(it);
                 level_pool_.deallocate(level);
-                return true;
+                return;
             }
         }
-        return false;
+        publish_level<S>(level);
+    }
+
+    // Live group for (type, side, offset), reusing a freed slot if it has to
+    // create one; returns its Order::peg_group number
+    uint32_t peg_group_for(PegType type, bool is_buy, double offset) {
+        auto& live = live_peg_groups_[is_buy];
+        auto key = std::make_pair(static_cast<int>(type), offset);
+        auto it = live.find(key);
+        if (it != live.end()) {
+            return it->second;
+        }
+        uint32_t index;
+        if (!free_peg_groups_.empty()) {
+            index = free_peg_groups_.back();
+            free_peg_groups_.pop_back();
+        } else {
+            peg_groups_.emplace_back();
+            index = static_cast<uint32_t>(peg_groups_.size());
+        }
+        peg_groups_[index - 1] = std::make_unique<PegGroup>(PegGroup{type, is_buy, offset, {}, 0});
+        live.emplace(key, index);
+        return index;
+    }
+
+    // Queue an order at the tail of its group's queue for its cap
+    void link_pegged(Order* order, PegType type, double offset) {
+        order->is_active = true;
+        order->peg_group = peg_group_for(type, order->is_buy, offset);
+        PegGroup& group = peg_group_of(order);
+        group.queues.try_emplace(cap_key(order->is_buy, order->price), order->price).first->second.add_order(order);
+        group.order_count++;
+        peg_order_count_++;
+    }
+
+    void unlink_pegged(Order* order) {
+        PegGroup& group = peg_group_of(order);
+        auto it = group.queues.find(cap_key(order->is_buy, order->price));
+        it->second.remove_order(order);
+        if (it->second.is_empty()) {
+            group.queues.erase(it);
+        }
+        peg_order_count_--;
+        if (--group.order_count == 0) {
+            live_peg_groups_[group.is_buy].erase(std::make_pair(static_cast<int>(group.type), group.offset));
+            peg_groups_[order->peg_group - 1].reset();
+            free_peg_groups_.push_back(order->peg_group);
+        }
+    }
+
+    PegGroup& peg_group_of(const Order* order) const {
+        return *peg_groups_[order->peg_group - 1];
+    }
+
+    InternalPriceLevel& peg_queue_of(const Order* order) const {
+        return peg_group_of(order).queues.find(cap_key(order->is_buy, order->price))->second;
+    }
+
+    template<typename Levels>
+    void append_snapshot_records(const Levels& levels, std::vector<char>& out) const {
+        for (const auto& [price, level] : levels) {
+            level->for_each([&](const Order* o) {
+                if (!o->is_active) {
+                    return;
+                }
+                SnapshotRecord rec{};
+                rec.order_id = o->order_id;
+                rec.price = o->price;
+                rec.quantity = o->quantity;
+                rec.timestamp_ns = o->timestamp_ns;
+                rec.is_buy = o->is_buy ? 1 : 0;
+                size_t offset = out.size();
+                out.resize(offset + sizeof(rec));
+                std::memcpy(out.data() + offset, &rec, sizeof(rec));
+            });
+        }
+    }
+
+    void append_peg_snapshot_records(std::vector<char>& out) const {
+        for (const auto& group : peg_groups_) {
+            if (!group) {
+                continue;
+            }
+            for (const auto& [cap, queue] : group->queues) {
+                queue.for_each([&](const Order* o) {
+                    SnapshotRecord rec{};
+                    rec.order_id = o->order_id;
+                    rec.price = o->price;
+                    rec.quantity = o->quantity;
+                    rec.timestamp_ns = o->timestamp_ns;
+                    rec.is_buy = o->is_buy ? 1 : 0;
+                    rec.peg_type = static_cast<uint8_t>(group->type) + 1;
+                    rec.peg_offset = group->offset;
+                    size_t offset = out.size();
+                    out.resize(offset + sizeof(rec));
+                    std::memcpy(out.data() + offset, &rec, sizeof(rec));
+                });
+            }
+        }
+    }
+
+    // Place an order at the tail of its level without matching
+    template<Side S>
+    bool insert_resting(const Order& o) {
+        if (order_lookup_.count(o.order_id)) {
+            return false;
+        }
+        Order* order = order_pool_.allocate();
+        *order = o;
+        order->peg_group = 0;
+        order_lookup_[o.order_id] = order;
+        latest_timestamp_ns_ = std::max(latest_timestamp_ns_, o.timestamp_ns);
+        link_order<S>(order);
+        return true;
+    }
+
+    // Drop every resting order and any level it leaves behind
+    void clear_orders() {
+        sweep_cancelled<Side::Buy>(SIZE_MAX);
+        sweep_cancelled<Side::Sell>(SIZE_MAX);
+        for (auto& [id, order] : order_lookup_) {
+            if (order->is_buy) {
+                unlink_order<Side::Buy>(order);
+            } else {
+                unlink_order<Side::Sell>(order);
+            }
+            order_pool_.deallocate(order);
+        }
+        order_lookup_.clear();
+        for (Quoter& quoter : quoters_) {
+            std::fill(quoter.bids.begin(), quoter.bids.end(), nullptr);
+            std::fill(quoter.asks.begin(), quoter.asks.end(), nullptr);
+        }
+    }
+
+    bool cancels_lazily(const Order* order) const {
+        return lazy_cancel_ && !order->peg_group && !(order->order_id & QUOTE_ORDER_ID_FLAG);
+    }
+
+    template<Side S>
+    void cancel(Order* order) {
+        if (cancels_lazily(order)) {
+            cancel_lazily<S>(order);
+        } else {
+            unlink_order<S>(order);
+            order_pool_.deallocate(order);
+        }
+    }
+
+    // Price change loses priority: cancel + add at the tail of the new level.
+    // Quantity increase loses priority: requeue at the tail of the same level
+    // without touching the level map. A reduction keeps its queue position
+    // and is a pure in-place update.
+    template<Side S>
+    bool amend(Order* order, double new_price, uint64_t new_quantity) {
+        if (order->price != new_price) {
+            unlink_order<S>(order);
+            order->price = new_price;
+            order->quantity = new_quantity;
+            requeue_timestamp(order);
+            link_order<S>(order);
+            version_++;
+            match_orders();
+            notify_top_of_book();
+            return true;
+        }
+
+        InternalPriceLevel* level = get_level<S>(order->price);
+        if (!level) {
+            std::cerr << "Error: Price level not found for order " << order->order_id << "\n";
+            return false;
+        }
+
+        if (new_quantity > order->quantity) {
+            level->move_to_tail(order);
+            requeue_timestamp(order);
+        }
+        level->set_quantity(order, new_quantity);
+        publish_level<S>(level);
+
+        version_++;
+        notify_top_of_book();
+        return true;
+    }
+
+    bool insert_resting_pegged(const Order& o, PegType type, double offset) {
+        if (order_lookup_.count(o.order_id)) {
+            return false;
+        }
+        Order* order = order_pool_.allocate();
+        *order = o;
+        order_lookup_[o.order_id] = order;
+        latest_timestamp_ns_ = std::max(latest_timestamp_ns_, o.timestamp_ns);
+        link_pegged(order, type, offset);
+        return true;
     }
 };
 
 // OrderBook implementation
 OrderBook::OrderBook() : pImpl(std::make_unique<Impl>()) {}
 
+bool valid_instrument_params(const InstrumentParams& params) {
+    if (!(params.tick_size >= 0.0) || std::isinf(params.tick_size) || params.lot_size == 0 ||
+        !(params.min_price >= MIN_PRICE) || !(params.max_price <= MAX_PRICE) || params.min_price > params.max_price ||
+        params.max_quantity == 0 || params.max_quantity > MAX_ORDER_QUANTITY) {
+        std::cerr << "Error: Invalid instrument parameters\n";
+        return false;
+    }
+    return true;
+}
+
+bool valid_order_price(const InstrumentParams& params, double price) {
+    if (price < params.min_price || price > params.max_price || std::isnan(price) || std::isinf(price)) {
+        std::cerr << "Error: Invalid price: " << price << " (must be between " << params.min_price
+                  << " and " << params.max_price << ")\n";
+        return false;
+    }
+    if (params.tick_size > 0.0) {
+        double ticks = price / params.tick_size;
+        if (std::fabs(ticks - std::round(ticks)) > 1e-6) {
+            std::cerr << "Error: Price " << price << " is not a multiple of tick size " << params.tick_size << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool valid_order_quantity(const InstrumentParams& params, uint64_t quantity) {
+    if (quantity == 0 || quantity > params.max_quantity) {
+        std::cerr << "Error: Invalid quantity: " << quantity << " (must be between 1 and " << params.max_quantity << ")\n";
+        return false;
+    }
+    if (quantity % params.lot_size != 0) {
+        std::cerr << "Error: Quantity " << quantity << " is not a multiple of lot size " << params.lot_size << "\n";
+        return false;
+    }
+    return true;
+}
+
 OrderBook::~OrderBook() = default;
 
 void OrderBook::add_order(const Order& o) {
@@ -340,19 +1313,24 @@ void OrderBook::add_order(const Order& o) {
         return;
     }
 
-    if (o.price < MIN_PRICE || o.price > MAX_PRICE || std::isnan(o.price) || std::isinf(o.price)) {
-        std::cerr << "Error: Invalid price: " << o.price << " (must be between " << MIN_PRICE << " and " << MAX_PRICE << ")\n";
+    if (o.order_id & QUOTE_ORDER_ID_FLAG) {
+        std::cerr << "Error: Order ID " << o.order_id << " is reserved for quotes\n";
         return;
     }
 
-    if (o.quantity == 0 || o.quantity > MAX_ORDER_QUANTITY) {
-        std::cerr << "Error: Invalid quantity: " << o.quantity << " (must be between 1 and " << MAX_ORDER_QUANTITY << ")\n";
+    if (!valid_order_price(pImpl->instrument_, o.price) || !valid_order_quantity(pImpl->instrument_, o.quantity)) {
         return;
     }
 
-    if (pImpl->order_lookup_.find(o.order_id) != pImpl->order_lookup_.end()) {
-        std::cerr << "Error: Duplicate order ID: " << o.order_id << "\n";
-        return;
+    auto existing = pImpl->order_lookup_.find(o.order_id);
+    if (existing != pImpl->order_lookup_.end()) {
+        if (existing->second->is_active) {
+            std::cerr << "Error: Duplicate order ID: " << o.order_id << "\n";
+            return;
+        }
+        // Reusing the id of a lazily cancelled order; the sweep still frees it
+        pImpl->order_lookup_.erase(existing);
+        pImpl->cancelled_lookups_--;
     }
 
     Order* new_order = pImpl->order_pool_.allocate();
@@ -365,20 +1343,50 @@ void OrderBook::add_order(const Order& o) {
     new_order->next = nullptr;
     new_order->prev = nullptr;
     new_order->is_active = true;
+    new_order->peg_group = 0;
 
     pImpl->order_lookup_[o.order_id] = new_order;
+    pImpl->latest_timestamp_ns_ = std::max(pImpl->latest_timestamp_ns_, o.timestamp_ns);
 
-    InternalPriceLevel* level = pImpl->get_or_create_level(o.price, o.is_buy);
-    if (!level) {
-        pImpl->order_lookup_.erase(o.order_id);
-        pImpl->order_pool_.deallocate(new_order);
+    if (o.is_buy) {
+        pImpl->link_order<Side::Buy>(new_order);
+    } else {
+        pImpl->link_order<Side::Sell>(new_order);
+    }
+    pImpl->version_++;
+
+    pImpl->match_orders();
+    pImpl->notify_top_of_book();
+}
+
+void OrderBook::add_pegged_order(const Order& o, PegType type, double offset) {
+    if (o.order_id == 0 || (o.order_id & QUOTE_ORDER_ID_FLAG)) {
+        std::cerr << "Error: Invalid order ID: " << o.order_id << "\n";
         return;
     }
 
-    level->add_order(new_order);
-    pImpl->version_++;
+    if (o.price != 0.0 && !valid_order_price(pImpl->instrument_, o.price)) {
+        std::cerr << "Error: Invalid peg limit: " << o.price << "\n";
+        return;
+    }
+
+    if (offset < 0.0 || std::isnan(offset) || std::isinf(offset)) {
+        std::cerr << "Error: Invalid peg offset: " << offset << "\n";
+        return;
+    }
+
+    if (!valid_order_quantity(pImpl->instrument_, o.quantity)) {
+        return;
+    }
 
+    if (!pImpl->insert_resting_pegged(o, type, offset)) {
+        std::cerr << "Error: Duplicate order ID: " << o.order_id << "\n";
+        return;
+    }
+
+    pImpl->version_++;
     pImpl->match_orders();
+    pImpl->notify_top_of_book();
 }
 
 bool OrderBook::cancel_order(uint64_t id) {
@@ -388,33 +1396,29 @@ bool OrderBook::cancel_order(uint64_t id) {
     }
 
     auto it = pImpl->order_lookup_.find(id);
-    if (it == pImpl->order_lookup_.end()) {
+    if (it == pImpl->order_lookup_.end() || !it->second->is_active) {
+        // An inactive entry is an order already cancelled lazily
         std::cerr << "Error: Order not found: " << id << "\n";
         return false;
     }
 
     Order* order = it->second;
-    pImpl->order_lookup_.erase(it);
-
-    if (!order || !order->is_active) {
-        if (order) {
-            pImpl->order_pool_.deallocate(order);
-        }
-        return false;
+    if (!pImpl->cancels_lazily(order)) {
+        pImpl->order_lookup_.erase(it);
     }
 
-    InternalPriceLevel* level = pImpl->get_level(order->price, order->is_buy);
-
-    if (level) {
-        level->remove_order(order);
-
-        if (level->is_empty()) {
-            pImpl->remove_price_level(level->price, order->is_buy);
-        }
+    pImpl->release_quote_slot(order);
+    if (order->is_buy) {
+        pImpl->cancel<Side::Buy>(order);
+    } else {
+        pImpl->cancel<Side::Sell>(order);
     }
-
-    pImpl->order_pool_.deallocate(order);
     pImpl->version_++;
+    if (pImpl->peg_order_count_) {
+        // Pegged prices follow the BBO this cancel may have moved
+        pImpl->match_orders();
+    }
+    pImpl->notify_top_of_book();
     return true;
 }
 
@@ -424,13 +1428,7 @@ bool OrderBook::amend_order(uint64_t order_id, double new_price, uint64_t new_qu
         return false;
     }
 
-    if (new_price < MIN_PRICE || new_price > MAX_PRICE || std::isnan(new_price) || std::isinf(new_price)) {
-        std::cerr << "Error: Invalid price: " << new_price << " (must be between " << MIN_PRICE << " and " << MAX_PRICE << ")\n";
-        return false;
-    }
-
-    if (new_quantity == 0 || new_quantity > MAX_ORDER_QUANTITY) {
-        std::cerr << "Error: Invalid quantity: " << new_quantity << " (must be between 1 and " << MAX_ORDER_QUANTITY << ")\n";
+    if (!valid_order_quantity(pImpl->instrument_, new_quantity)) {
         return false;
     }
 
@@ -446,60 +1444,138 @@ bool OrderBook::amend_order(uint64_t order_id, double new_price, uint64_t new_qu
         return false;
     }
 
-    if (order->price != new_price) {
-        // Price change - treat as cancel + add
-        InternalPriceLevel* old_level = pImpl->get_level(order->price, order->is_buy);
-        if (old_level) {
-            old_level->remove_order(order);
-            if (old_level->is_empty()) {
-                pImpl->remove_price_level(old_level->price, order->is_buy);
-            }
-        }
-
-        order->price = new_price;
-        order->quantity = new_quantity;
+    // A pegged order's price is its cap, and 0 removes it
+    if (!(order->peg_group && new_price == 0.0) && !valid_order_price(pImpl->instrument_, new_price)) {
+        return false;
+    }
 
-        InternalPriceLevel* new_level = pImpl->get_or_create_level(new_price, order->is_buy);
-        if (!new_level) {
-            std::cerr << "Error: Failed to create price level for " << new_price << "\n";
-            return false;
-        }
-        new_level->add_order(order);
-    } else {
-        // Only quantity change - update in place
-        InternalPriceLevel* level = pImpl->get_level(order->price, order->is_buy);
-        if (level) {
-            level->total_quantity = level->total_quantity - order->quantity + new_quantity;
+    if (order->peg_group) {
+        if (order->price != new_price) {
+            // New limit cap - requeue at the tail of the queue for that cap
+            PegType type = pImpl->peg_group_of(order).type;
+            double offset = pImpl->peg_group_of(order).offset;
+            pImpl->unlink_pegged(order);
+            order->price = new_price;
             order->quantity = new_quantity;
+            pImpl->requeue_timestamp(order);
+            pImpl->link_pegged(order, type, offset);
         } else {
-            std::cerr << "Error: Price level not found for order " << order_id << "\n";
-            return false;
+            InternalPriceLevel& queue = pImpl->peg_queue_of(order);
+            if (new_quantity > order->quantity) {
+                queue.move_to_tail(order);
+                pImpl->requeue_timestamp(order);
+            }
+            queue.set_quantity(order, new_quantity);
         }
+        pImpl->version_++;
+        pImpl->match_orders();
+        pImpl->notify_top_of_book();
+        return true;
     }
 
-    pImpl->version_++;
+    return order->is_buy ? pImpl->amend<Side::Buy>(order, new_price, new_quantity)
+                         : pImpl->amend<Side::Sell>(order, new_price, new_quantity);
+}
+
+void OrderBook::set_level_retention(size_t levels_per_side) {
+    pImpl->level_retention_ = levels_per_side;
+    pImpl->reclaim_retained<Side::Buy>(levels_per_side);
+    pImpl->reclaim_retained<Side::Sell>(levels_per_side);
+}
+
+bool OrderBook::set_instrument(const InstrumentParams& params) {
+    if (!valid_instrument_params(params)) {
+        return false;
+    }
+    pImpl->instrument_ = params;
+    return true;
+}
+
+const InstrumentParams& OrderBook::get_instrument() const {
+    return pImpl->instrument_;
+}
+
+void OrderBook::set_lazy_cancel(bool enabled) {
+    pImpl->lazy_cancel_ = enabled;
+    if (!enabled) {
+        sweep_cancelled_orders();
+    }
+}
+
+size_t OrderBook::sweep_cancelled_orders(size_t max_orders) {
+    if (pImpl->cancelled_pending_ == 0) {
+        return 0;
+    }
+    size_t released = pImpl->sweep_cancelled<Side::Buy>(max_orders);
+    return released + pImpl->sweep_cancelled<Side::Sell>(max_orders - released);
+}
+
+size_t OrderBook::get_pending_cancel_count() const {
+    return pImpl->cancelled_pending_;
+}
+
+bool OrderBook::get_queue_position(uint64_t order_id, uint64_t& quantity_ahead) const {
+    auto it = pImpl->order_lookup_.find(order_id);
+    if (it == pImpl->order_lookup_.end() || !it->second->is_active) {
+        std::cerr << "Error: Order not found: " << order_id << "\n";
+        return false;
+    }
+
+    const Order* order = it->second;
+    const InternalPriceLevel* level = order->peg_group
+        ? &pImpl->peg_queue_of(order)
+        : pImpl->get_level(order->price, order->is_buy);
+    if (!level) {
+        std::cerr << "Error: Price level not found for order " << order_id << "\n";
+        return false;
+    }
+    quantity_ahead = level->quantity_ahead(order);
     return true;
 }
 
 void OrderBook::get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const {
     bids.clear();
     asks.clear();
+    pImpl->displayed_levels<Side::Buy>(depth, bids);
+    pImpl->displayed_levels<Side::Sell>(depth, asks);
+}
 
-    auto bid_it = pImpl->bids_.begin();
-    for (size_t i = 0; i < depth && bid_it != pImpl->bids_.end(); ++i, ++bid_it) {
-        PriceLevel level;
-        level.price = bid_it->second->price;
-        level.total_quantity = bid_it->second->total_quantity;
-        bids.push_back(level);
+static size_t format_book_cell(const PriceLevel* level, char* out) {
+    if (!level) {
+        std::memcpy(out, "         |          ", 20);
+        return 20;
     }
+    size_t len = decimal::format_padded(decimal::to_units(level->price, PRICE_DISPLAY_SCALE), PRICE_DISPLAY_SCALE, 8, out);
+    std::memcpy(out + len, " | ", 3);
+    len += 3;
+    return len + decimal::format_padded(static_cast<int64_t>(level->total_quantity), 0, 8, out + len);
+}
 
-    auto ask_it = pImpl->asks_.begin();
-    for (size_t i = 0; i < depth && ask_it != pImpl->asks_.end(); ++i, ++ask_it) {
-        PriceLevel level;
-        level.price = ask_it->second->price;
-        level.total_quantity = ask_it->second->total_quantity;
-        asks.push_back(level);
-    }
+size_t format_book_row(const PriceLevel* bid, const PriceLevel* ask, char* out) {
+    size_t len = format_book_cell(bid, out);
+    std::memcpy(out + len, " | ", 3);
+    len += 3;
+    len += format_book_cell(ask, out + len);
+    out[len++] = '\n';
+    return len;
+}
+
+size_t format_match_line(uint64_t quantity, double price, uint64_t bid_id, uint64_t ask_id, char* out) {
+    char* o = out;
+    auto text = [&o](const char* s, size_t n) {
+        std::memcpy(o, s, n);
+        o += n;
+    };
+    text("MATCH: ", 7);
+    o += decimal::format_unsigned(quantity, o);
+    text(" @ ", 3);
+    o += decimal::format(decimal::to_units(price, PRICE_DISPLAY_SCALE), PRICE_DISPLAY_SCALE, o);
+    text(" (Bid: ", 7);
+    o += decimal::format_unsigned(bid_id, o);
+    text(", Ask: ", 7);
+    o += decimal::format_unsigned(ask_id, o);
+    text(")\n", 2);
+    return static_cast<size_t>(o - out);
 }
 
 void OrderBook::print_book(size_t depth) const {
@@ -508,48 +1584,43 @@ void OrderBook::print_book(size_t depth) const {
     std::cout << "Price    | Quantity | Price    | Quantity\n";
     std::cout << "---------|----------|----------|----------\n";
 
-    auto bid_it = pImpl->bids_.begin();
-    auto ask_it = pImpl->asks_.begin();
-
-    for (size_t i = 0; i < depth && (bid_it != pImpl->bids_.end() || ask_it != pImpl->asks_.end()); ++i) {
-        std::cout << std::fixed << std::setprecision(2);
-
-        if (bid_it != pImpl->bids_.end()) {
-            double price = bid_it->second->price;
-            uint64_t qty = bid_it->second->total_quantity;
-            std::cout << std::setw(8) << price << " | " << std::setw(8) << qty;
-            ++bid_it;
-        } else {
-            std::cout << "         |          ";
-        }
-
-        std::cout << " | ";
-
-        if (ask_it != pImpl->asks_.end()) {
-            double price = ask_it->second->price;
-            uint64_t qty = ask_it->second->total_quantity;
-            std::cout << std::setw(8) << price << " | " << std::setw(8) << qty;
-            ++ask_it;
-        } else {
-            std::cout << "         |          ";
-        }
+    std::vector<PriceLevel> bids, asks;
+    get_snapshot(depth, bids, asks);
 
-        std::cout << "\n";
+    // Rows are formatted into a buffer with fixed-point conversion and written
+    // in one call, leaving std::cout's formatting state alone
+    char line[BOOK_ROW_MAX];
+    for (size_t i = 0; i < bids.size() || i < asks.size(); ++i) {
+        size_t len = format_book_row(i < bids.size() ? &bids[i] : nullptr, i < asks.size() ? &asks[i] : nullptr, line);
+        std::cout.write(line, static_cast<std::streamsize>(len));
     }
 
-    std::cout << "\nBest Bid: " << get_best_bid() << "\n";
-    std::cout << "Best Ask: " << get_best_ask() << "\n";
-    std::cout << "Spread: " << get_spread() << "\n";
+    auto write_price = [](double price) {
+        char value[decimal::FORMAT_MAX];
+        size_t len = decimal::format(decimal::to_units(price, PRICE_DISPLAY_SCALE), PRICE_DISPLAY_SCALE, value);
+        std::cout.write(value, static_cast<std::streamsize>(len));
+    };
+    std::cout << "\nBest Bid: ";
+    write_price(get_best_bid());
+    std::cout << "\nBest Ask: ";
+    if (pImpl->best_level<Side::Sell>()) {
+        write_price(get_best_ask());
+    } else {
+        std::cout << "none";
+    }
+    std::cout << "\nSpread: ";
+    write_price(get_spread());
+    std::cout << "\n";
 }
 
 double OrderBook::get_best_bid() const {
-    if (pImpl->bids_.empty()) return 0.0;
-    return pImpl->bids_.begin()->second->price;
+    const InternalPriceLevel* level = pImpl->best_level<Side::Buy>();
+    return level ? level->price : 0.0;
 }
 
 double OrderBook::get_best_ask() const {
-    if (pImpl->asks_.empty()) return std::numeric_limits<double>::max();
-    return pImpl->asks_.begin()->second->price;
+    const InternalPriceLevel* level = pImpl->best_level<Side::Sell>();
+    return level ? level->price : std::numeric_limits<double>::max();
 }
 
 double OrderBook::get_spread() const {
@@ -557,18 +1628,260 @@ double OrderBook::get_spread() const {
     return best_ask_price == std::numeric_limits<double>::max() ? 0.0 : best_ask_price - get_best_bid();
 }
 
+TopOfBook OrderBook::get_top_of_book() const {
+    return pImpl->top_of_book();
+}
+
 uint64_t OrderBook::get_version() const {
     return pImpl->version_;
 }
 
 size_t OrderBook::get_order_count() const {
-    return pImpl->order_lookup_.size();
+    return pImpl->order_lookup_.size() - pImpl->cancelled_lookups_;
 }
 
 size_t OrderBook::get_bid_levels() const {
-    return pImpl->bids_.size();
+    return pImpl->bids_.size() - pImpl->retained_bids_.size() - pImpl->hidden_levels_[true];
 }
 
 size_t OrderBook::get_ask_levels() const {
-    return pImpl->asks_.size();
+    return pImpl->asks_.size() - pImpl->retained_asks_.size() - pImpl->hidden_levels_[false];
+}
+
+void OrderBook::enable_concurrent_depth() {
+    if (pImpl->concurrent_bids_) {
+        return;
+    }
+    pImpl->concurrent_bids_ = std::make_unique<ConcurrentBidIndex>();
+    pImpl->concurrent_asks_ = std::make_unique<ConcurrentAskIndex>();
+    pImpl->mirror_levels(*pImpl->concurrent_bids_, pImpl->bids_);
+    pImpl->mirror_levels(*pImpl->concurrent_asks_, pImpl->asks_);
+}
+
+const ConcurrentBidIndex* OrderBook::concurrent_bids() const {
+    return pImpl->concurrent_bids_.get();
+}
+
+const ConcurrentAskIndex* OrderBook::concurrent_asks() const {
+    return pImpl->concurrent_asks_.get();
+}
+
+void OrderBook::save_snapshot(std::vector<char>& out) const {
+    SnapshotHeader header{};
+    header.magic = SNAPSHOT_MAGIC;
+    header.record_size = sizeof(SnapshotRecord);
+    header.version = pImpl->version_;
+    header.order_count = get_order_count();
+    header.quoter_count = pImpl->quoters_.size();
+
+    out.clear();
+    out.reserve(snapshot_size());
+    out.resize(sizeof(header));
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    pImpl->append_snapshot_records(pImpl->bids_, out);
+    pImpl->append_snapshot_records(pImpl->asks_, out);
+    pImpl->append_peg_snapshot_records(out);
+    for (const Impl::Quoter& quoter : pImpl->quoters_) {
+        uint32_t slots = static_cast<uint32_t>(quoter.bids.size());
+        size_t offset = out.size();
+        out.resize(offset + sizeof(slots));
+        std::memcpy(out.data() + offset, &slots, sizeof(slots));
+    }
+}
+
+size_t OrderBook::snapshot_size() const {
+    return sizeof(SnapshotHeader) + get_order_count() * sizeof(SnapshotRecord) +
+           pImpl->quoters_.size() * sizeof(uint32_t);
+}
+
+static bool read_snapshot_header(const char* data, size_t size, SnapshotHeader& header) {
+    if (size < sizeof(header)) {
+        std::cerr << "Error: Snapshot truncated\n";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    size_t body = size - sizeof(header);
+    bool sized = header.order_count <= body / sizeof(SnapshotRecord) &&
+                 header.quoter_count <= body / sizeof(uint32_t) &&
+                 header.quoter_count * sizeof(uint32_t) == body - header.order_count * sizeof(SnapshotRecord);
+    if (header.magic != SNAPSHOT_MAGIC || header.record_size != sizeof(SnapshotRecord) || !sized) {
+        std::cerr << "Error: Invalid snapshot header\n";
+        return false;
+    }
+    return true;
+}
+
+bool OrderBook::load_snapshot(const char* data, size_t size) {
+    if (get_order_count() != 0) {
+        std::cerr << "Error: Snapshot can only be loaded into an empty book\n";
+        return false;
+    }
+    sweep_cancelled_orders();
+
+    SnapshotHeader header;
+    if (!read_snapshot_header(data, size, header)) {
+        return false;
+    }
+
+    // Quoters first, so restored quote orders can take their slots back
+    std::vector<Impl::Quoter> previous_quoters = std::move(pImpl->quoters_);
+    uint64_t previous_timestamp_ns = pImpl->latest_timestamp_ns_;
+    const char* quoter_cursor = data + sizeof(header) + header.order_count * sizeof(SnapshotRecord);
+    pImpl->quoters_.assign(header.quoter_count, Impl::Quoter{});
+    for (Impl::Quoter& quoter : pImpl->quoters_) {
+        uint32_t slots;
+        std::memcpy(&slots, quoter_cursor, sizeof(slots));
+        quoter_cursor += sizeof(slots);
+        if (slots > 0x80000000u) {   // slot numbers have 31 bits in a quote order ID
+            std::cerr << "Error: Invalid quoter slot count in snapshot: " << slots << "\n";
+            pImpl->quoters_ = std::move(previous_quoters);
+            return false;
+        }
+        quoter.bids.assign(slots, nullptr);
+        quoter.asks.assign(slots, nullptr);
+    }
+
+    // Any bad record leaves the book exactly as empty as it was
+    auto fail = [&]() {
+        pImpl->clear_orders();
+        pImpl->quoters_ = std::move(previous_quoters);
+        pImpl->latest_timestamp_ns_ = previous_timestamp_ns;
+        return false;
+    };
+
+    const char* cursor = data + sizeof(header);
+    for (uint64_t i = 0; i < header.order_count; ++i, cursor += sizeof(SnapshotRecord)) {
+        SnapshotRecord rec;
+        std::memcpy(&rec, cursor, sizeof(rec));
+        bool pegged = rec.peg_type != 0;
+        if (rec.order_id == 0 || rec.is_buy > 1 || rec.peg_type > static_cast<uint8_t>(PegType::Midpoint) + 1 ||
+            (pegged && !(rec.peg_offset >= 0.0 && std::isfinite(rec.peg_offset))) ||
+            (pegged && (rec.order_id & QUOTE_ORDER_ID_FLAG))) {
+            std::cerr << "Error: Invalid snapshot record for order " << rec.order_id << "\n";
+            return fail();
+        }
+        if (((!pegged || rec.price != 0.0) && !valid_order_price(pImpl->instrument_, rec.price)) ||
+            !valid_order_quantity(pImpl->instrument_, rec.quantity)) {
+            return fail();
+        }
+
+        Order o(rec.order_id, rec.is_buy != 0, rec.price, rec.quantity, rec.timestamp_ns);
+        bool inserted = pegged
+            ? pImpl->insert_resting_pegged(o, static_cast<PegType>(rec.peg_type - 1), rec.peg_offset)
+            : o.is_buy ? pImpl->insert_resting<Side::Buy>(o) : pImpl->insert_resting<Side::Sell>(o);
+        if (!inserted) {
+            std::cerr << "Error: Duplicate order ID in snapshot: " << rec.order_id << "\n";
+            return fail();
+        }
+        if (rec.order_id & QUOTE_ORDER_ID_FLAG) {
+            Order** slot = pImpl->quote_slot(rec.order_id);
+            bool side_matches = ((rec.order_id >> 31) & 1) == (o.is_buy ? 0u : 1u);
+            if (!slot || *slot || !side_matches) {
+                std::cerr << "Error: Quote order without a quoter slot in snapshot: " << rec.order_id << "\n";
+                return fail();
+            }
+            *slot = pImpl->order_lookup_[rec.order_id];
+        }
+    }
+
+    pImpl->version_ = header.version;
+    pImpl->notify_top_of_book();
+    return true;
+}
+
+bool OrderBook::snapshot_levels(const char* data, size_t size, std::vector<PriceLevel>& bids,
+                                std::vector<PriceLevel>& asks) {
+    bids.clear();
+    asks.clear();
+    SnapshotHeader header;
+    if (!read_snapshot_header(data, size, header)) {
+        return false;
+    }
+
+    // Lit records come level by level, best first, so equal prices are adjacent
+    const char* cursor = data + sizeof(header);
+    for (uint64_t i = 0; i < header.order_count; ++i, cursor += sizeof(SnapshotRecord)) {
+        SnapshotRecord rec;
+        std::memcpy(&rec, cursor, sizeof(rec));
+        if (rec.peg_type != 0) {
+            continue;   // pegged orders are not displayed
+        }
+        std::vector<PriceLevel>& side = rec.is_buy ? bids : asks;
+        if (rec.is_buy > 1 || rec.quantity == 0 || !std::isfinite(rec.price)) {
+            std::cerr << "Error: Invalid snapshot record for order " << rec.order_id << "\n";
+            return false;
+        }
+        if (!side.empty() && side.back().price == rec.price) {
+            side.back().total_quantity += rec.quantity;
+        } else if (side.empty() || (rec.is_buy ? rec.price < side.back().price : rec.price > side.back().price)) {
+            side.emplace_back(rec.price, rec.quantity);
+        } else {
+            std::cerr << "Error: Snapshot levels out of order at " << rec.price << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void OrderBook::add_listener(BookListener* listener) {
+    if (listener && std::find(pImpl->listeners_.begin(), pImpl->listeners_.end(), listener) == pImpl->listeners_.end()) {
+        pImpl->listeners_.push_back(listener);
+        pImpl->last_top_ = pImpl->top_of_book();
+    }
+}
+
+void OrderBook::remove_listener(BookListener* listener) {
+    auto& listeners = pImpl->listeners_;
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+uint32_t OrderBook::register_quoter(size_t max_levels) {
+    Impl::Quoter quoter;
+    quoter.bids.assign(max_levels, nullptr);
+    quoter.asks.assign(max_levels, nullptr);
+    pImpl->quoters_.push_back(std::move(quoter));
+    return static_cast<uint32_t>(pImpl->quoters_.size() - 1);
+}
+
+bool OrderBook::mass_quote(uint32_t quoter_id, const std::vector<QuoteEntry>& quotes, uint64_t timestamp_ns) {
+    if (quoter_id >= pImpl->quoters_.size()) {
+        std::cerr << "Error: Unknown quoter: " << quoter_id << "\n";
+        return false;
+    }
+
+    Impl::Quoter& quoter = pImpl->quoters_[quoter_id];
+    if (quotes.size() > quoter.bids.size()) {
+        std::cerr << "Error: Too many quote levels: " << quotes.size() << " (max " << quoter.bids.size() << ")\n";
+        return false;
+    }
+
+    // Validate the whole set first so that a rejected quote changes nothing
+    for (const QuoteEntry& q : quotes) {
+        for (auto [price, qty] : {std::make_pair(q.bid_price, q.bid_quantity), std::make_pair(q.ask_price, q.ask_quantity)}) {
+            if (qty == 0) {
+                continue;
+            }
+            if (!valid_order_price(pImpl->instrument_, price) || !valid_order_quantity(pImpl->instrument_, qty)) {
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < quoter.bids.size(); ++i) {
+        const QuoteEntry q = i < quotes.size() ? quotes[i] : QuoteEntry{};
+        pImpl->apply_quote<Side::Buy>(quoter.bids[i], Impl::quote_order_id(quoter_id, true, i),
+                                      q.bid_price, q.bid_quantity, timestamp_ns);
+        pImpl->apply_quote<Side::Sell>(quoter.asks[i], Impl::quote_order_id(quoter_id, false, i),
+                                       q.ask_price, q.ask_quantity, timestamp_ns);
+    }
+
+    pImpl->version_++;
+    pImpl->match_orders();
+    pImpl->notify_top_of_book();
+    return true;
+}
+
+bool OrderBook::cancel_quotes(uint32_t quoter_id) {
+    return mass_quote(quoter_id, {}, 0);
 }
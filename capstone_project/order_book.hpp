@@ -3,6 +3,27 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <limits>
+#include "concurrent_level_index.hpp"
+
+// Price level queue representation: 0 = intrusive doubly-linked list through
+// Order::next/prev, 1 = contiguous per-level vector of (order, quantity)
+// entries with tombstones (build with `make contiguous`)
+#ifndef ORDER_BOOK_CONTIGUOUS_LEVELS
+#define ORDER_BOOK_CONTIGUOUS_LEVELS 0
+#endif
+
+// Price level index: 0 = std::map, 1 = B+tree with 16-key nodes and linked
+// leaves (bplus_tree.hpp, build with `make btree`)
+#ifndef ORDER_BOOK_BTREE_LEVELS
+#define ORDER_BOOK_BTREE_LEVELS 0
+#endif
+
+constexpr size_t MAX_ORDER_QUANTITY = 1000000;
+constexpr double MIN_PRICE = 0.01;
+constexpr double MAX_PRICE = 1000000.0;
+
+struct InternalPriceLevel;
 
 struct Order {
     uint64_t order_id;     // Unique order identifier
@@ -15,6 +36,9 @@ struct Order {
     Order* next{nullptr};
     Order* prev{nullptr};
     bool is_active{true};
+    uint32_t peg_group{0}; // 1-based peg group index, 0 for plain limit orders
+    uint32_t queue_slot{0}; // entry index in a contiguous level queue
+    InternalPriceLevel* level{nullptr}; // queue the order is linked into
 
     Order() = default;
     Order(uint64_t id, bool buy, double p, uint64_t qty, uint64_t ts)
@@ -24,7 +48,7 @@ struct Order {
         : order_id(other.order_id), is_buy(other.is_buy),
           price(other.price), quantity(other.quantity),
           timestamp_ns(other.timestamp_ns), next(nullptr), prev(nullptr),
-          is_active(other.is_active) {}
+          is_active(other.is_active), peg_group(other.peg_group), queue_slot(0), level(nullptr) {}
 
     Order& operator=(const Order& other) {
         if (this != &other) {
@@ -36,11 +60,52 @@ struct Order {
             next = nullptr;
             prev = nullptr;
             is_active = other.is_active;
+            peg_group = other.peg_group;
+            queue_slot = 0;
+            level = nullptr;
         }
         return *this;
     }
 };
 
+// Reference price a pegged order tracks
+enum class PegType : uint8_t {
+    Primary,  // Same-side touch: buys track the best bid, sells the best ask
+    Market,   // Opposite touch: buys track the best ask, sells the best bid
+    Midpoint  // Midpoint of the best bid and ask
+};
+
+// Order IDs with this bit set are generated for mass quotes
+constexpr uint64_t QUOTE_ORDER_ID_FLAG = 1ull << 63;
+
+// The register_quoter() id a generated quote order ID belongs to
+inline uint32_t quote_order_quoter(uint64_t order_id) {
+    return static_cast<uint32_t>((order_id & ~QUOTE_ORDER_ID_FLAG) >> 32);
+}
+
+// One level of a market maker's two-sided quote; zero quantity = no quote on that side
+struct QuoteEntry {
+    double bid_price{0.0};
+    uint64_t bid_quantity{0};
+    double ask_price{0.0};
+    uint64_t ask_quantity{0};
+};
+
+// Trading parameters of the instrument a book trades (see
+// instrument_master.hpp). The defaults accept whatever the global limits do.
+struct InstrumentParams {
+    double tick_size{0.0};                      // prices must be whole ticks; 0 = any price
+    uint64_t lot_size{1};                       // quantities must be whole lots
+    double min_price{MIN_PRICE};                // price band
+    double max_price{MAX_PRICE};
+    uint64_t max_quantity{MAX_ORDER_QUANTITY};
+};
+
+// Checks shared by OrderBook and SmallOrderBook; each logs why it failed
+bool valid_instrument_params(const InstrumentParams& params);
+bool valid_order_price(const InstrumentParams& params, double price);
+bool valid_order_quantity(const InstrumentParams& params, uint64_t quantity);
+
 struct PriceLevel {
     double price;
     uint64_t total_quantity;
@@ -49,17 +114,114 @@ struct PriceLevel {
     PriceLevel(double p, uint64_t qty) : price(p), total_quantity(qty) {}
 };
 
+// print_book prices are shown in hundredths
+constexpr int PRICE_DISPLAY_SCALE = 2;
+constexpr size_t BOOK_ROW_MAX = 96;
+constexpr size_t MATCH_LINE_MAX = 128;
+
+// One print_book row: bid and ask columns (null for an empty cell) and a
+// newline, without iostreams. `out` needs BOOK_ROW_MAX bytes.
+size_t format_book_row(const PriceLevel* bid, const PriceLevel* ask, char* out);
+
+// The "MATCH: ..." trade log line; `out` needs MATCH_LINE_MAX bytes
+size_t format_match_line(uint64_t quantity, double price, uint64_t bid_id, uint64_t ask_id, char* out);
+
+struct TopOfBook {
+    double bid_price{0.0};
+    uint64_t bid_quantity{0};
+    double ask_price{std::numeric_limits<double>::max()};
+    uint64_t ask_quantity{0};
+
+    bool operator==(const TopOfBook& other) const {
+        return bid_price == other.bid_price && bid_quantity == other.bid_quantity &&
+               ask_price == other.ask_price && ask_quantity == other.ask_quantity;
+    }
+    bool operator!=(const TopOfBook& other) const { return !(*this == other); }
+};
+
+// One fill between the best bid and ask orders, with what each has left
+struct Trade {
+    uint64_t bid_order_id;
+    uint64_t ask_order_id;
+    double price;
+    uint64_t quantity;
+    uint64_t bid_remaining;
+    uint64_t ask_remaining;
+};
+
+// Receives book events synchronously on the thread that mutates the book.
+// Callbacks must not modify the book they are attached to.
+class BookListener {
+public:
+    virtual ~BookListener() = default;
+
+    // Aggregate quantity at a price level changed; 0 means the level is gone
+    virtual void on_level_update(bool /*is_buy*/, double /*price*/, uint64_t /*total_quantity*/) {}
+
+    // Two orders traded; reported before the level updates the fill causes
+    virtual void on_trade(const Trade& /*trade*/) {}
+
+    // Best bid/ask price or quantity changed, reported once per operation
+    virtual void on_top_of_book(const TopOfBook& /*top*/) {}
+
+    // Every delta of one book operation has been reported; the book is
+    // consistent again (never crossed) until the next operation starts
+    virtual void on_operation_complete() {}
+};
+
 class OrderBook {
 public:
     // Insert a new order into the book
     void add_order(const Order& order);
 
+    // Insert a non-displayed order whose price follows the lit BBO. The offset
+    // (>= 0) moves it away from the reference; order.price is an optional
+    // limit cap (0 = none). Amending a pegged order's price changes that cap;
+    // amending it to 0 removes the cap.
+    // With a tick size set, derived prices round to the tick away from the
+    // contra side.
+    void add_pegged_order(const Order& order, PegType type, double offset = 0.0);
+
     // Cancel an existing order by its ID
     bool cancel_order(uint64_t order_id);
 
+    // Keep up to levels_per_side emptied price levels per side in the level
+    // index, hidden from snapshots and the BBO, so a touch that empties and
+    // refills reuses its node. 0 (the default) erases levels immediately.
+    void set_level_retention(size_t levels_per_side);
+
+    // Check new orders, amends and quotes against an instrument's tick size,
+    // lot size, price band and maximum order size. Orders already resting
+    // are kept. Fails if the parameters are inconsistent.
+    bool set_instrument(const InstrumentParams& params);
+    const InstrumentParams& get_instrument() const;
+
+    // Lazy cancel: cancel_order only flags the order and adjusts the totals of
+    // the level it points to; unlinking, the id lookup erase and dropping an
+    // emptied level happen when matching reaches it or in
+    // sweep_cancelled_orders(). Pegged and mass quote orders always cancel
+    // eagerly. Disabling the mode sweeps everything still pending.
+    void set_lazy_cancel(bool enabled);
+
+    // Reclaim up to max_orders lazily cancelled orders, e.g. from idle time in
+    // the event loop; returns how many were reclaimed
+    size_t sweep_cancelled_orders(size_t max_orders = SIZE_MAX);
+    size_t get_pending_cancel_count() const;
+
     // Amend an existing order's price or quantity
     bool amend_order(uint64_t order_id, double new_price, uint64_t new_quantity);
 
+    // Register a market maker with up to max_levels quote slots per side
+    uint32_t register_quoter(size_t max_levels);
+
+    // Replace a quoter's entire quote set: entry i goes to slot i, slots past
+    // the end are pulled. Only slots whose price or size changed are touched.
+    bool mass_quote(uint32_t quoter_id, const std::vector<QuoteEntry>& quotes, uint64_t timestamp_ns);
+    bool cancel_quotes(uint32_t quoter_id);
+
+    // Quantity queued ahead of an order at its price (or in its peg queue)
+    bool get_queue_position(uint64_t order_id, uint64_t& quantity_ahead) const;
+
     // Get a snapshot of top N bid and ask levels (aggregated quantities)
     void get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const;
 
@@ -70,19 +232,40 @@ public:
     double get_best_bid() const;
     double get_best_ask() const;
     double get_spread() const;
+    TopOfBook get_top_of_book() const;
     uint64_t get_version() const;
     size_t get_order_count() const;
     size_t get_bid_levels() const;
     size_t get_ask_levels() const;
 
+    // Subscribe to incremental book events (level deltas)
+    void add_listener(BookListener* listener);
+    void remove_listener(BookListener* listener);
+
+    // Binary snapshot of every resting order, levels best-first and FIFO within
+    // a level, so that loading it restores queue priority exactly. Registered
+    // quoters are saved too: loading replaces the book's quoters with them, so
+    // a restored quoter id keeps requoting its own resting quote orders.
+    void save_snapshot(std::vector<char>& out) const;
+    // Exact size of the next save_snapshot() image; a buffer with this much
+    // capacity lets save_snapshot() run without allocating
+    size_t snapshot_size() const;
+    bool load_snapshot(const char* data, size_t size);
+    // Aggregated lit levels of a save_snapshot() image, best first, read
+    // straight from its records without building a book
+    static bool snapshot_levels(const char* data, size_t size, std::vector<PriceLevel>& bids,
+                                std::vector<PriceLevel>& asks);
+
+    // Mirror level quantities into lock-free skiplists that other threads can
+    // walk at full depth while matching runs (see ConcurrentLevelIndex::Reader)
+    void enable_concurrent_depth();
+    const ConcurrentBidIndex* concurrent_bids() const;
+    const ConcurrentAskIndex* concurrent_asks() const;
+
     // Destructor
     ~OrderBook();
 
 private:
-    // Forward declarations for internal implementation
-    struct InternalPriceLevel;
-    template<typename T> class SimpleMemoryPool;
-    
     // Internal implementation details
     class Impl;
     std::unique_ptr<Impl> pImpl;
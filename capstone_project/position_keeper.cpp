@@ -0,0 +1,200 @@
+#include "position_keeper.hpp"
+#include "decimal.hpp"
+#include <algorithm>
+#include <iostream>
+
+double PositionView::average_price() const {
+    return position ? decimal::from_units(cost / position, PNL_PRICE_SCALE) : 0.0;
+}
+
+double PositionView::realized_pnl() const {
+    return decimal::from_units(realized, PNL_PRICE_SCALE);
+}
+
+double PositionView::unrealized_pnl() const {
+    return decimal::from_units(unrealized(), PNL_PRICE_SCALE);
+}
+
+// Per-book listener that tags the book's events with its instrument id
+class PositionKeeper::Feed : public BookListener {
+public:
+    Feed(PositionKeeper& keeper, OrderBook& book, uint32_t instrument)
+        : keeper_(keeper), book_(book), instrument_(instrument) {}
+
+    OrderBook& book() const { return book_; }
+
+    void on_trade(const Trade& trade) override {
+        keeper_.on_trade(instrument_, trade);
+    }
+
+    void on_top_of_book(const TopOfBook& top) override {
+        // Keep the last two-sided mid while one side is empty
+        if (top.bid_quantity && top.ask_quantity) {
+            int64_t mid = (decimal::to_units(top.bid_price, PNL_PRICE_SCALE) +
+                           decimal::to_units(top.ask_price, PNL_PRICE_SCALE)) / 2;
+            keeper_.marks_[instrument_].mid.store(mid, std::memory_order_release);
+        }
+    }
+
+private:
+    PositionKeeper& keeper_;
+    OrderBook& book_;
+    uint32_t instrument_;
+};
+
+PositionKeeper::PositionKeeper(uint32_t max_owners, uint32_t max_instruments)
+    : max_owners_(max_owners), max_instruments_(max_instruments),
+      slots_(std::make_unique<Slot[]>(static_cast<size_t>(max_owners) * max_instruments)),
+      marks_(std::make_unique<Mark[]>(max_instruments)) {}
+
+PositionKeeper::~PositionKeeper() {
+    for (auto& feed : feeds_) {
+        feed->book().remove_listener(feed.get());
+    }
+}
+
+bool PositionKeeper::attach(OrderBook& book, uint32_t instrument) {
+    if (instrument >= max_instruments_) {
+        std::cerr << "Error: Instrument " << instrument << " out of range (max " << max_instruments_ << ")\n";
+        return false;
+    }
+    for (auto& feed : feeds_) {
+        if (&feed->book() == &book) {
+            std::cerr << "Error: Book already attached to the position keeper\n";
+            return false;
+        }
+    }
+    feeds_.push_back(std::make_unique<Feed>(*this, book, instrument));
+    book.add_listener(feeds_.back().get());
+    TopOfBook top = book.get_top_of_book();
+    feeds_.back()->on_top_of_book(top);
+    return true;
+}
+
+void PositionKeeper::detach(OrderBook& book) {
+    for (auto it = feeds_.begin(); it != feeds_.end(); ++it) {
+        if (&(*it)->book() == &book) {
+            book.remove_listener(it->get());
+            feeds_.erase(it);
+            return;
+        }
+    }
+}
+
+bool PositionKeeper::assign(uint64_t order_id, uint32_t owner) {
+    if (owner >= max_owners_) {
+        std::cerr << "Error: Owner " << owner << " out of range (max " << max_owners_ << ")\n";
+        return false;
+    }
+    owners_[order_id] = owner;
+    return true;
+}
+
+void PositionKeeper::forget(uint64_t order_id) {
+    owners_.erase(order_id);
+}
+
+bool PositionKeeper::assign_quoter(uint32_t instrument, uint32_t quoter_id, uint32_t owner) {
+    if (owner >= max_owners_ || instrument >= max_instruments_) {
+        std::cerr << "Error: Owner " << owner << " or instrument " << instrument << " out of range\n";
+        return false;
+    }
+    quoter_owners_[static_cast<uint64_t>(instrument) << 32 | quoter_id] = owner;
+    return true;
+}
+
+void PositionKeeper::owner_done(uint32_t instrument, uint64_t order_id, uint64_t remaining, uint32_t& owner) {
+    if (order_id & QUOTE_ORDER_ID_FLAG) {
+        // Quote slots are reused, so the quoter's entry stays
+        auto it = quoter_owners_.find(static_cast<uint64_t>(instrument) << 32 | quote_order_quoter(order_id));
+        owner = it == quoter_owners_.end() ? max_owners_ : it->second;
+        unowned_fills_ += owner == max_owners_;
+        return;
+    }
+    auto it = owners_.find(order_id);
+    if (it == owners_.end()) {
+        owner = max_owners_;
+        unowned_fills_++;
+        return;
+    }
+    owner = it->second;
+    if (remaining == 0) {
+        owners_.erase(it);
+    }
+}
+
+void PositionKeeper::on_trade(uint32_t instrument, const Trade& trade) {
+    int64_t price = decimal::to_units(trade.price, PNL_PRICE_SCALE);
+    uint32_t buyer, seller;
+    owner_done(instrument, trade.bid_order_id, trade.bid_remaining, buyer);
+    owner_done(instrument, trade.ask_order_id, trade.ask_remaining, seller);
+    if (buyer < max_owners_) {
+        apply_fill(buyer, instrument, true, price, trade.quantity);
+    }
+    if (seller < max_owners_) {
+        apply_fill(seller, instrument, false, price, trade.quantity);
+    }
+}
+
+void PositionKeeper::apply_fill(uint32_t owner, uint32_t instrument, bool is_buy, int64_t price, uint64_t quantity) {
+    Slot& slot = slots_[static_cast<size_t>(owner) * max_instruments_ + instrument];
+    // Single writer: its own relaxed loads see its last stores
+    int64_t position = slot.position.load(std::memory_order_relaxed);
+    int64_t cost = slot.cost.load(std::memory_order_relaxed);
+    int64_t realized = slot.realized.load(std::memory_order_relaxed);
+    int64_t fill = is_buy ? static_cast<int64_t>(quantity) : -static_cast<int64_t>(quantity);
+
+    if (position != 0 && (position > 0) != (fill > 0)) {
+        // Close against the open position at its average cost. The cost
+        // removed is proportional, so rounding stays in the remaining cost
+        // and a flat position always has exactly zero cost.
+        int64_t open = position > 0 ? position : -position;
+        int64_t closing = std::min(open, fill > 0 ? fill : -fill);
+        int64_t closed = position > 0 ? closing : -closing;
+        __extension__ typedef __int128 i128;   // quiet under -pedantic
+        int64_t removed = static_cast<int64_t>(static_cast<i128>(cost) * closing / open);
+        realized += price * closed - removed;
+        cost -= removed;
+        position -= closed;
+        fill += closed;
+    }
+    // Whatever is left opens or extends the position
+    position += fill;
+    cost += price * fill;
+
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.position.store(position, std::memory_order_relaxed);
+    slot.cost.store(cost, std::memory_order_relaxed);
+    slot.realized.store(realized, std::memory_order_relaxed);
+    slot.fills.store(slot.fills.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool PositionKeeper::read(uint32_t owner, uint32_t instrument, PositionView& view) const {
+    if (owner >= max_owners_ || instrument >= max_instruments_) {
+        return false;
+    }
+    const Slot& slot = slots_[static_cast<size_t>(owner) * max_instruments_ + instrument];
+    for (;;) {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        view.position = slot.position.load(std::memory_order_relaxed);
+        view.cost = slot.cost.load(std::memory_order_relaxed);
+        view.realized = slot.realized.load(std::memory_order_relaxed);
+        view.fills = slot.fills.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    view.mark = mark(instrument);
+    return true;
+}
+
+int64_t PositionKeeper::mark(uint32_t instrument) const {
+    return instrument < max_instruments_ ? marks_[instrument].mid.load(std::memory_order_acquire) : 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "order_book.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Prices are kept as integer units of 10^-PNL_PRICE_SCALE
+constexpr int PNL_PRICE_SCALE = 4;
+
+// A consistent read of one owner's position in one instrument. Money
+// amounts are price units times quantity.
+struct PositionView {
+    int64_t position{0};     // signed quantity, positive = long
+    int64_t cost{0};         // cost basis of the open position, same sign as position
+    int64_t realized{0};
+    int64_t mark{0};         // instrument mid in price units, 0 until both sides have quoted
+    uint64_t fills{0};
+
+    int64_t unrealized() const { return mark ? mark * position - cost : 0; }
+    double average_price() const;
+    double realized_pnl() const;
+    double unrealized_pnl() const;
+};
+
+// Keeps per-owner, per-instrument position, cost basis and realized P&L up
+// to date from the trades of the books it is attached to, and marks open
+// positions to each book's mid as the top of book moves. A fill costs a hash
+// lookup per side and a few integer operations; nothing is recomputed from
+// trade history.
+//
+// Positions live in a fixed owners x instruments table. Each slot is written
+// under its own sequence number, so risk threads read any slot lock-free at
+// any time while the matching thread keeps updating. The book does not know
+// who owns an order: call assign() before the order reaches the book. Mass
+// quote orders get generated ids, so their fills are attributed per quoter
+// instead: call assign_quoter() once after register_quoter().
+class PositionKeeper {
+public:
+    PositionKeeper(uint32_t max_owners, uint32_t max_instruments);
+    ~PositionKeeper();
+    PositionKeeper(const PositionKeeper&) = delete;
+    PositionKeeper& operator=(const PositionKeeper&) = delete;
+
+    // Matching thread: follow a book's trades and mid as `instrument`
+    bool attach(OrderBook& book, uint32_t instrument);
+    void detach(OrderBook& book);
+
+    // Matching thread: record whose order this is; the entry is dropped once
+    // the order fills completely, or by forget() when it is cancelled
+    bool assign(uint64_t order_id, uint32_t owner);
+    void forget(uint64_t order_id);
+
+    // Matching thread: fills of every quote order of `quoter_id` on the book
+    // attached as `instrument` go to `owner`
+    bool assign_quoter(uint32_t instrument, uint32_t quoter_id, uint32_t owner);
+
+    // Any thread
+    bool read(uint32_t owner, uint32_t instrument, PositionView& view) const;
+    int64_t mark(uint32_t instrument) const;
+
+    uint64_t unowned_fills() const { return unowned_fills_; }
+
+private:
+    class Feed;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0};   // odd while the writer is updating
+        std::atomic<int64_t> position{0};
+        std::atomic<int64_t> cost{0};
+        std::atomic<int64_t> realized{0};
+        std::atomic<uint64_t> fills{0};
+    };
+
+    struct alignas(64) Mark {
+        std::atomic<int64_t> mid{0};
+    };
+
+    void on_trade(uint32_t instrument, const Trade& trade);
+    void apply_fill(uint32_t owner, uint32_t instrument, bool is_buy, int64_t price, uint64_t quantity);
+    void owner_done(uint32_t instrument, uint64_t order_id, uint64_t remaining, uint32_t& owner);
+
+    uint32_t max_owners_;
+    uint32_t max_instruments_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<Mark[]> marks_;
+    std::unordered_map<uint64_t, uint32_t> owners_;
+    std::unordered_map<uint64_t, uint32_t> quoter_owners_;   // instrument << 32 | quoter id
+    std::vector<std::unique_ptr<Feed>> feeds_;
+    uint64_t unowned_fills_{0};
+};
@@ -0,0 +1,331 @@
+#include "recovery.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+constexpr uint32_t RECOVERY_MAGIC = 0x3152424F; // "OBR1"
+constexpr uint64_t DELTA_WRITING = 1ull << 63;
+
+// One ring entry, written under its own sequence number: readers accept it
+// only if the sequence matches before and after copying the fields
+struct RecoveryDelta {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> price_bits;
+    std::atomic<uint64_t> total_quantity;
+    std::atomic<uint64_t> is_buy;
+};
+
+// Segment layout: this header, ring_capacity deltas, then the snapshot area
+struct RecoveryShm {
+    std::atomic<uint32_t> magic;                         // stored last, with release
+    uint32_t reserved;
+    uint64_t ring_capacity;
+    uint64_t snapshot_capacity;
+    alignas(64) std::atomic<uint64_t> delta_sequence;    // last delta written
+    alignas(64) std::atomic<uint64_t> snapshot_requests; // bumped by clients
+    alignas(64) std::atomic<uint64_t> snapshot_version;  // seqlock, odd while writing
+    std::atomic<uint64_t> snapshot_sequence;             // last delta the snapshot reflects
+    std::atomic<uint64_t> snapshot_size;
+
+    RecoveryDelta* ring() {
+        return reinterpret_cast<RecoveryDelta*>(reinterpret_cast<char*>(this) + sizeof(RecoveryShm));
+    }
+    char* snapshot() {
+        return reinterpret_cast<char*>(ring() + ring_capacity);
+    }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared memory needs address-free atomics");
+
+static size_t segment_size(size_t ring_capacity, size_t snapshot_capacity) {
+    return sizeof(RecoveryShm) + ring_capacity * sizeof(RecoveryDelta) + snapshot_capacity;
+}
+
+class RecoveryServer::Listener : public BookListener {
+public:
+    explicit Listener(RecoveryServer& server) : server_(server) {}
+
+    void on_level_update(bool is_buy, double price, uint64_t total_quantity) override {
+        server_.append(is_buy, price, total_quantity);
+    }
+
+private:
+    RecoveryServer& server_;
+};
+
+RecoveryServer::~RecoveryServer() {
+    close();
+}
+
+bool RecoveryServer::open(const std::string& name, OrderBook& book, size_t ring_capacity, size_t snapshot_capacity) {
+    if (shm_) {
+        std::cerr << "Error: Recovery server already open\n";
+        return false;
+    }
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create shared memory " << name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    size_t size = segment_size(ring_capacity, snapshot_capacity);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Error: Cannot size shared memory " << name << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: Cannot map shared memory " << name << ": " << std::strerror(errno) << "\n";
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // ftruncate zero-fills, which is a valid initial state for every atomic
+    shm_ = static_cast<RecoveryShm*>(addr);
+    shm_->ring_capacity = ring_capacity;
+    shm_->snapshot_capacity = snapshot_capacity;
+    mapped_size_ = size;
+    name_ = name;
+    sequence_ = 0;
+    requests_served_ = 0;
+
+    book_ = &book;
+    listener_ = std::make_unique<Listener>(*this);
+    book.add_listener(listener_.get());
+    publish_snapshot();
+
+    shm_->magic.store(RECOVERY_MAGIC, std::memory_order_release);
+    return true;
+}
+
+void RecoveryServer::close() {
+    if (!shm_) {
+        return;
+    }
+    book_->remove_listener(listener_.get());
+    listener_.reset();
+    munmap(shm_, mapped_size_);
+    shm_unlink(name_.c_str());
+    shm_ = nullptr;
+}
+
+void RecoveryServer::append(bool is_buy, double price, uint64_t total_quantity) {
+    uint64_t seq = ++sequence_;
+    RecoveryDelta& delta = shm_->ring()[seq % shm_->ring_capacity];
+
+    uint64_t price_bits;
+    std::memcpy(&price_bits, &price, sizeof(price_bits));
+    delta.sequence.store(seq | DELTA_WRITING, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    delta.price_bits.store(price_bits, std::memory_order_relaxed);
+    delta.total_quantity.store(total_quantity, std::memory_order_relaxed);
+    delta.is_buy.store(is_buy ? 1 : 0, std::memory_order_relaxed);
+    delta.sequence.store(seq, std::memory_order_release);
+    shm_->delta_sequence.store(seq, std::memory_order_release);
+}
+
+void RecoveryServer::poll() {
+    if (!shm_) {
+        return;
+    }
+    uint64_t requests = shm_->snapshot_requests.load(std::memory_order_acquire);
+    if (requests != requests_served_) {
+        requests_served_ = requests;
+        publish_snapshot();
+    }
+}
+
+bool RecoveryServer::publish_snapshot() {
+    book_->save_snapshot(buffer_);
+    if (buffer_.size() > shm_->snapshot_capacity) {
+        std::cerr << "Error: Snapshot of " << buffer_.size() << " bytes exceeds recovery capacity "
+                  << shm_->snapshot_capacity << "\n";
+        return false;
+    }
+
+    uint64_t version = shm_->snapshot_version.load(std::memory_order_relaxed);
+    shm_->snapshot_version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(shm_->snapshot(), buffer_.data(), buffer_.size());
+    shm_->snapshot_size.store(buffer_.size(), std::memory_order_relaxed);
+    shm_->snapshot_sequence.store(sequence_, std::memory_order_relaxed);
+    shm_->snapshot_version.store(version + 2, std::memory_order_release);
+    snapshots_served_++;
+    return true;
+}
+
+RecoveryClient::~RecoveryClient() {
+    close();
+}
+
+bool RecoveryClient::open(const std::string& name) {
+    if (shm_) {
+        std::cerr << "Error: Recovery client already open\n";
+        return false;
+    }
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open shared memory " << name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RecoveryShm)) {
+        std::cerr << "Error: Shared memory " << name << " is not a recovery segment\n";
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: Cannot map shared memory " << name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    shm_ = static_cast<RecoveryShm*>(addr);
+    mapped_size_ = static_cast<size_t>(st.st_size);
+    // The acquire load orders the capacity reads after the server's setup
+    if (shm_->magic.load(std::memory_order_acquire) != RECOVERY_MAGIC ||
+        mapped_size_ != segment_size(shm_->ring_capacity, shm_->snapshot_capacity)) {
+        std::cerr << "Error: Shared memory " << name << " is not a recovery segment\n";
+        close();
+        return false;
+    }
+
+    start_recovery();
+    return true;
+}
+
+void RecoveryClient::close() {
+    if (shm_) {
+        munmap(shm_, mapped_size_);
+        shm_ = nullptr;
+    }
+}
+
+void RecoveryClient::start_recovery() {
+    live_ = false;
+    buffered_.clear();
+    bids_.clear();
+    asks_.clear();
+    next_sequence_ = shm_->delta_sequence.load(std::memory_order_acquire) + 1;
+    shm_->snapshot_requests.fetch_add(1, std::memory_order_acq_rel);
+    recoveries_++;
+}
+
+bool RecoveryClient::read_delta(uint64_t sequence, Delta& delta) const {
+    const RecoveryDelta& entry = shm_->ring()[sequence % shm_->ring_capacity];
+    if (entry.sequence.load(std::memory_order_acquire) != sequence) {
+        return false;
+    }
+    uint64_t price_bits = entry.price_bits.load(std::memory_order_relaxed);
+    delta.total_quantity = entry.total_quantity.load(std::memory_order_relaxed);
+    delta.is_buy = entry.is_buy.load(std::memory_order_relaxed) != 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+        return false;
+    }
+    std::memcpy(&delta.price, &price_bits, sizeof(price_bits));
+    delta.sequence = sequence;
+    return true;
+}
+
+size_t RecoveryClient::poll() {
+    if (!shm_) {
+        return 0;
+    }
+
+    size_t applied = 0;
+    uint64_t last = shm_->delta_sequence.load(std::memory_order_acquire);
+    while (next_sequence_ <= last) {
+        Delta delta;
+        if (!read_delta(next_sequence_, delta)) {
+            // Overwritten before we got to it: the view can no longer be trusted
+            gaps_++;
+            start_recovery();
+            return applied;
+        }
+        next_sequence_++;
+        if (!live_) {
+            buffered_.push_back(delta);
+        } else if (delta.sequence > applied_sequence_) {
+            // Deltas already covered by the snapshot are skipped
+            apply(delta);
+            applied++;
+        }
+    }
+
+    if (!live_ && try_snapshot()) {
+        for (const Delta& delta : buffered_) {
+            if (delta.sequence > applied_sequence_) {
+                apply(delta);
+                applied++;
+            }
+        }
+        buffered_.clear();
+        live_ = true;
+    }
+    return applied;
+}
+
+bool RecoveryClient::try_snapshot() {
+    uint64_t version = shm_->snapshot_version.load(std::memory_order_acquire);
+    if (version == 0 || (version & 1)) {
+        return false;
+    }
+    uint64_t sequence = shm_->snapshot_sequence.load(std::memory_order_relaxed);
+    uint64_t size = shm_->snapshot_size.load(std::memory_order_relaxed);
+    // Deltas up to the snapshot must not have been missed before buffering began
+    if (sequence + 1 < next_sequence_ - buffered_.size() || size > shm_->snapshot_capacity) {
+        return false;
+    }
+    // Plain copy under the seqlock: a torn copy is discarded by the version check
+    snapshot_.resize(size);
+    std::memcpy(snapshot_.data(), shm_->snapshot(), size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shm_->snapshot_version.load(std::memory_order_relaxed) != version) {
+        return false;
+    }
+
+    std::vector<PriceLevel> bids, asks;
+    if (!OrderBook::snapshot_levels(snapshot_.data(), snapshot_.size(), bids, asks)) {
+        return false;
+    }
+    bids_.clear();
+    asks_.clear();
+    for (const PriceLevel& level : bids) bids_[level.price] = level.total_quantity;
+    for (const PriceLevel& level : asks) asks_[level.price] = level.total_quantity;
+    applied_sequence_ = sequence;
+    return true;
+}
+
+void RecoveryClient::apply(const Delta& delta) {
+    if (delta.is_buy) {
+        if (delta.total_quantity) bids_[delta.price] = delta.total_quantity;
+        else bids_.erase(delta.price);
+    } else {
+        if (delta.total_quantity) asks_[delta.price] = delta.total_quantity;
+        else asks_.erase(delta.price);
+    }
+    applied_sequence_ = delta.sequence;
+}
+
+void RecoveryClient::get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const {
+    bids.clear();
+    asks.clear();
+    for (auto it = bids_.begin(); it != bids_.end() && bids.size() < depth; ++it) {
+        bids.emplace_back(it->first, it->second);
+    }
+    for (auto it = asks_.begin(); it != asks_.end() && asks.size() < depth; ++it) {
+        asks.emplace_back(it->first, it->second);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "order_book.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Snapshot-plus-incremental recovery over POSIX shared memory. The server
+// side numbers every level delta of one OrderBook and appends it to a ring in
+// the segment; on request it writes a binary snapshot (save_snapshot) tagged
+// with the last delta sequence it reflects. A late-joining client buffers
+// deltas from the moment it attaches, takes a snapshot at or after that
+// point, replays the buffered deltas newer than the snapshot and then follows
+// the live stream. Deltas carry absolute level quantities, so replay is
+// idempotent. A client that falls a full ring behind detects the gap and
+// recovers again.
+struct RecoveryShm;
+
+class RecoveryServer {
+public:
+    RecoveryServer() = default;
+    ~RecoveryServer();
+    RecoveryServer(const RecoveryServer&) = delete;
+    RecoveryServer& operator=(const RecoveryServer&) = delete;
+
+    // Create the segment (replacing a stale one of the same name) and start
+    // publishing the book's deltas
+    bool open(const std::string& name, OrderBook& book, size_t ring_capacity = 1 << 16,
+              size_t snapshot_capacity = 16 << 20);
+    void close();
+
+    // Serve pending snapshot requests. Call on the book's thread between
+    // operations, when the book is consistent.
+    void poll();
+    bool publish_snapshot();
+
+    uint64_t sequence() const { return sequence_; }
+    uint64_t snapshots_served() const { return snapshots_served_; }
+
+private:
+    class Listener;
+    void append(bool is_buy, double price, uint64_t total_quantity);
+
+    std::string name_;
+    RecoveryShm* shm_{nullptr};
+    size_t mapped_size_{0};
+    OrderBook* book_{nullptr};
+    std::unique_ptr<BookListener> listener_;
+    std::vector<char> buffer_;
+    uint64_t sequence_{0};
+    uint64_t requests_served_{0};
+    uint64_t snapshots_served_{0};
+};
+
+class RecoveryClient {
+public:
+    RecoveryClient() = default;
+    ~RecoveryClient();
+    RecoveryClient(const RecoveryClient&) = delete;
+    RecoveryClient& operator=(const RecoveryClient&) = delete;
+
+    // Attach to a server's segment and start recovering
+    bool open(const std::string& name);
+    void close();
+
+    // Consume available deltas and, while recovering, try to complete with a
+    // snapshot. Returns the number of deltas applied to the live view.
+    size_t poll();
+
+    bool is_live() const { return live_; }
+    uint64_t sequence() const { return applied_sequence_; }
+    uint64_t recoveries() const { return recoveries_; }
+    uint64_t gaps() const { return gaps_; }
+
+    // Recovered depth, same shape as OrderBook::get_snapshot
+    void get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const;
+
+private:
+    struct Delta {
+        uint64_t sequence;
+        bool is_buy;
+        double price;
+        uint64_t total_quantity;
+    };
+
+    void start_recovery();
+    bool read_delta(uint64_t sequence, Delta& delta) const;
+    bool try_snapshot();
+    void apply(const Delta& delta);
+
+    RecoveryShm* shm_{nullptr};
+    size_t mapped_size_{0};
+    bool live_{false};
+    uint64_t next_sequence_{1};      // next delta to read from the ring
+    uint64_t applied_sequence_{0};   // last delta reflected in the view
+    std::vector<Delta> buffered_;    // deltas read while waiting for a snapshot
+    std::vector<char> snapshot_;
+    std::map<double, uint64_t, std::greater<double>> bids_;
+    std::map<double, uint64_t> asks_;
+    uint64_t recoveries_{0};
+    uint64_t gaps_{0};
+};
@@ -0,0 +1,439 @@
+#include "session_gateway.hpp"
+#include "decimal.hpp"
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int PRICE_SCALE = 4;           // price digits accepted on the wire
+constexpr size_t SESSION_BUFFER = 4096;
+
+// Coroutine frames by 256-byte size class. A finished session's frame goes on
+// its class's free list and is handed to the next session of the same shape,
+// so steady-state accept/close churn never reaches the heap.
+class FramePool {
+public:
+    static constexpr size_t CLASS_SIZE = 256;
+    static constexpr size_t CLASSES = 64;   // up to 16 KB frames
+
+    ~FramePool() {
+        for (FreeFrame*& head : free_) {
+            while (head) {
+                FreeFrame* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    }
+
+    void* allocate(size_t size) {
+        size_t cls = class_of(size);
+        if (cls < CLASSES && free_[cls]) {
+            FreeFrame* frame = free_[cls];
+            free_[cls] = frame->next;
+            reused++;
+            return frame;
+        }
+        allocated++;
+        return ::operator new(cls < CLASSES ? (cls + 1) * CLASS_SIZE : size);
+    }
+
+    void deallocate(void* ptr, size_t size) {
+        size_t cls = class_of(size);
+        if (cls >= CLASSES) {
+            ::operator delete(ptr);
+            return;
+        }
+        FreeFrame* frame = static_cast<FreeFrame*>(ptr);
+        frame->next = free_[cls];
+        free_[cls] = frame;
+    }
+
+    uint64_t allocated{0};
+    uint64_t reused{0};
+
+private:
+    struct FreeFrame {
+        FreeFrame* next;
+    };
+
+    static size_t class_of(size_t size) { return (size + CLASS_SIZE - 1) / CLASS_SIZE - 1; }
+
+    FreeFrame* free_[CLASSES] = {};
+};
+
+thread_local FramePool frame_pool;
+
+bool would_block(ssize_t result) {
+    return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+bool next_token(const char*& p, const char* end, const char*& token, size_t& length) {
+    while (p < end && *p == ' ') ++p;
+    token = p;
+    while (p < end && *p != ' ') ++p;
+    length = static_cast<size_t>(p - token);
+    return length > 0;
+}
+
+bool parse_field(const char*& p, const char* end, int scale, int64_t& value) {
+    const char* token;
+    size_t length;
+    return next_token(p, end, token, length) && decimal::parse(token, length, scale, value) == length && value > 0;
+}
+
+// Decode one request line; returns null on success or the reject reason
+const char* parse_command(const char* line, size_t length, uint32_t session, BookCommand& cmd) {
+    const char* p = line;
+    const char* end = line + length;
+    if (p < end && end[-1] == '\r') --end;
+
+    const char* verb;
+    size_t verb_length;
+    if (!next_token(p, end, verb, verb_length) || verb_length != 1) {
+        return "unknown command";
+    }
+    cmd = BookCommand{};
+    cmd.session = session;
+
+    int64_t id, price = 0, quantity = 0;
+    if (!parse_field(p, end, 0, id)) {
+        return "bad order id";
+    }
+    cmd.order_id = static_cast<uint64_t>(id);
+
+    switch (*verb) {
+    case 'N': {
+        const char* side;
+        size_t side_length;
+        if (!next_token(p, end, side, side_length) || side_length != 1 || (*side != 'B' && *side != 'S')) {
+            return "bad side";
+        }
+        cmd.type = BookCommand::Add;
+        cmd.is_buy = *side == 'B';
+        break;
+    }
+    case 'A':
+        cmd.type = BookCommand::Amend;
+        break;
+    case 'C':
+        cmd.type = BookCommand::Cancel;
+        break;
+    default:
+        return "unknown command";
+    }
+
+    if (cmd.type != BookCommand::Cancel) {
+        if (!parse_field(p, end, PRICE_SCALE, price)) return "bad price";
+        if (!parse_field(p, end, 0, quantity)) return "bad quantity";
+        cmd.price = decimal::from_units(price, PRICE_SCALE);
+        cmd.quantity = static_cast<uint64_t>(quantity);
+    }
+    const char* extra;
+    size_t extra_length;
+    return next_token(p, end, extra, extra_length) ? "trailing fields" : nullptr;
+}
+
+} // namespace
+
+struct SessionGateway::Impl {
+    // Detached coroutine: starts immediately, frees its frame on completion.
+    // Every live frame is linked into the gateway so close() can destroy
+    // sessions suspended mid-conversation.
+    struct Detached {
+        struct promise_type {
+            template<typename... Args>
+            explicit promise_type(Impl& impl, const Args&...) : owner(&impl) {
+                next = impl.tasks_;
+                if (next) next->prev = this;
+                impl.tasks_ = this;
+            }
+
+            ~promise_type() {
+                (prev ? prev->next : owner->tasks_) = next;
+                if (next) next->prev = prev;
+            }
+
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+
+            static void* operator new(size_t size) { return frame_pool.allocate(size); }
+            static void operator delete(void* ptr, size_t size) { frame_pool.deallocate(ptr, size); }
+
+            Impl* owner;
+            promise_type* prev{nullptr};
+            promise_type* next{nullptr};
+        };
+    };
+
+    // Non-blocking socket registered edge-triggered with epoll; at most one
+    // coroutine waits on each direction
+    struct Socket {
+        Socket(Impl& impl, int fd, bool session) : impl(impl), fd(fd), session(session) {
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = fd;
+            epoll_ctl(impl.epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            if (impl.sockets_.size() <= static_cast<size_t>(fd)) {
+                impl.sockets_.resize(static_cast<size_t>(fd) + 1, nullptr);
+            }
+            impl.sockets_[fd] = this;
+            if (session) impl.stats_.sessions_active++;
+        }
+
+        ~Socket() {
+            epoll_ctl(impl.epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            impl.sockets_[fd] = nullptr;
+            ::close(fd);
+            if (session) impl.stats_.sessions_active--;
+        }
+
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        Impl& impl;
+        int fd;
+        bool session;
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+    };
+
+    // Suspend until epoll reports the socket readable (or writable)
+    struct Readiness {
+        Socket& socket;
+        bool write;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) noexcept {
+            (write ? socket.writer : socket.reader) = handle;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // Suspend until the next poll(), giving the matching thread time to drain
+    struct QueueSpace {
+        Impl& impl;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            impl.stats_.queue_waits++;
+            impl.ready_.push_back(handle);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    Detached accept_loop(int listen_fd) {
+        Socket listener(*this, listen_fd, false);
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    co_await Readiness{listener, false};
+                } else if (errno != EINTR && errno != ECONNABORTED) {
+                    std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+                    co_await Readiness{listener, false};
+                }
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            stats_.sessions_accepted++;
+            session(fd, next_session_++);
+        }
+    }
+
+    // One connection: parse complete lines, queue commands, and answer each;
+    // responses are batched and flushed when the input runs dry
+    Detached session(int fd, uint32_t id) {
+        Socket socket(*this, fd, true);
+        char in[SESSION_BUFFER];
+        char out[SESSION_BUFFER];
+        size_t in_start = 0, in_end = 0, out_len = 0;
+
+        while (true) {
+            const char* newline = static_cast<const char*>(std::memchr(in + in_start, '\n', in_end - in_start));
+            if (out_len > 0 && (!newline || out_len > SESSION_BUFFER - 128)) {
+                ssize_t n = ::send(fd, out, out_len, MSG_NOSIGNAL);
+                if (would_block(n)) {
+                    co_await Readiness{socket, true};
+                    continue;
+                }
+                if (n < 0) break;
+                std::memmove(out, out + n, out_len - static_cast<size_t>(n));
+                out_len -= static_cast<size_t>(n);
+                continue;
+            }
+
+            if (newline) {
+                BookCommand cmd;
+                const char* reason = parse_command(in + in_start, static_cast<size_t>(newline - (in + in_start)), id, cmd);
+                if (reason) {
+                    stats_.rejects++;
+                    out_len += append(out + out_len, "REJ ", reason);
+                } else {
+                    while (commands_->full()) {
+                        co_await QueueSpace{*this};
+                    }
+                    commands_->push(cmd);
+                    stats_.commands++;
+                    char number[decimal::FORMAT_MAX];
+                    number[decimal::format_unsigned(cmd.order_id, number)] = '\0';
+                    out_len += append(out + out_len, "OK ", number);
+                }
+                in_start = static_cast<size_t>(newline - in) + 1;
+                continue;
+            }
+
+            std::memmove(in, in + in_start, in_end - in_start);
+            in_end -= in_start;
+            in_start = 0;
+            if (in_end == SESSION_BUFFER) {
+                break;   // line longer than the buffer: drop the connection
+            }
+            ssize_t n = ::read(fd, in + in_end, SESSION_BUFFER - in_end);
+            if (would_block(n)) {
+                co_await Readiness{socket, false};
+                continue;
+            }
+            if (n <= 0) break;
+            in_end += static_cast<size_t>(n);
+        }
+    }
+
+    static size_t append(char* out, const char* a, const char* b) {
+        size_t la = std::strlen(a), lb = std::strlen(b);
+        std::memcpy(out, a, la);
+        std::memcpy(out + la, b, lb);
+        out[la + lb] = '\n';
+        return la + lb + 1;
+    }
+
+    void resume(std::coroutine_handle<>& waiter, size_t& resumed) {
+        if (waiter) {
+            std::coroutine_handle<> handle = waiter;
+            waiter = nullptr;
+            handle.resume();
+            resumed++;
+        }
+    }
+
+    Socket* socket_for(int fd) const {
+        return static_cast<size_t>(fd) < sockets_.size() ? sockets_[fd] : nullptr;
+    }
+
+    int epoll_fd_{-1};
+    uint16_t port_{0};
+    Fifo3<BookCommand>* commands_{nullptr};
+    std::vector<Socket*> sockets_;                 // by fd, for epoll dispatch
+    std::vector<std::coroutine_handle<>> ready_;   // waiting for queue space
+    std::vector<std::coroutine_handle<>> running_;
+    Detached::promise_type* tasks_{nullptr};
+    uint32_t next_session_{1};
+    GatewayStats stats_;
+};
+
+SessionGateway::SessionGateway() : impl_(std::make_unique<Impl>()) {}
+
+SessionGateway::~SessionGateway() {
+    close();
+}
+
+bool SessionGateway::open(uint16_t port, Fifo3<BookCommand>& commands) {
+    if (impl_->epoll_fd_ >= 0) {
+        std::cerr << "Error: Gateway already open\n";
+        return false;
+    }
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Error: Cannot create listen socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 1024) != 0 ||
+        getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::cerr << "Error: Cannot listen on port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(listen_fd);
+        return false;
+    }
+
+    impl_->epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (impl_->epoll_fd_ < 0) {
+        std::cerr << "Error: epoll_create1 failed: " << std::strerror(errno) << "\n";
+        ::close(listen_fd);
+        return false;
+    }
+    impl_->port_ = ntohs(addr.sin_port);
+    impl_->commands_ = &commands;
+    impl_->accept_loop(listen_fd);
+    return true;
+}
+
+void SessionGateway::close() {
+    if (impl_->epoll_fd_ < 0) {
+        return;
+    }
+    impl_->ready_.clear();
+    while (impl_->tasks_) {
+        std::coroutine_handle<Impl::Detached::promise_type>::from_promise(*impl_->tasks_).destroy();
+    }
+    ::close(impl_->epoll_fd_);
+    impl_->epoll_fd_ = -1;
+}
+
+uint16_t SessionGateway::port() const {
+    return impl_->port_;
+}
+
+size_t SessionGateway::poll(int timeout_ms) {
+    if (impl_->epoll_fd_ < 0) {
+        return 0;
+    }
+
+    size_t resumed = 0;
+    impl_->running_.swap(impl_->ready_);
+    for (std::coroutine_handle<>& handle : impl_->running_) {
+        impl_->resume(handle, resumed);
+    }
+    impl_->running_.clear();
+
+    epoll_event events[64];
+    int n = epoll_wait(impl_->epoll_fd_, events, 64, impl_->ready_.empty() ? timeout_ms : 0);
+    for (int i = 0; i < n; ++i) {
+        // Look the socket up again after each resume: the session may have ended
+        int fd = events[i].data.fd;
+        uint32_t ev = events[i].events;
+        if (Impl::Socket* socket = impl_->socket_for(fd); socket && (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+            impl_->resume(socket->reader, resumed);
+        }
+        if (Impl::Socket* socket = impl_->socket_for(fd); socket && (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+            impl_->resume(socket->writer, resumed);
+        }
+    }
+    return resumed;
+}
+
+GatewayStats SessionGateway::stats() const {
+    GatewayStats stats = impl_->stats_;
+    stats.frames_allocated = frame_pool.allocated;
+    stats.frames_reused = frame_pool.reused;
+    return stats;
+}
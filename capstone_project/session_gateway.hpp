@@ -0,0 +1,63 @@
+#pragma once
+#include "order_book.hpp"
+#include "../SPSC_QUEUES/spsc_q3.cpp"
+#include <cstdint>
+#include <memory>
+
+// A client request decoded by a gateway session, for the matching thread
+struct BookCommand {
+    enum Type : uint8_t { Add, Cancel, Amend };
+    Type type;
+    bool is_buy;
+    uint32_t session;
+    uint64_t order_id;
+    double price;
+    uint64_t quantity;
+};
+
+struct GatewayStats {
+    uint64_t sessions_accepted{0};
+    uint64_t sessions_active{0};
+    uint64_t commands{0};
+    uint64_t rejects{0};
+    uint64_t queue_waits{0};      // times a session waited for room in the command queue
+    uint64_t frames_allocated{0}; // coroutine frames carved fresh for the pool
+    uint64_t frames_reused{0};    // coroutine frames served from the pool's free lists
+};
+
+// TCP order-entry gateway. Each connection is a coroutine that reads lines
+// of a small text protocol and pushes BookCommands into a Fifo3 drained by
+// the matching thread:
+//
+//   N <id> <B|S> <price> <qty>    add       -> "OK <id>"
+//   C <id>                        cancel    -> "OK <id>"
+//   A <id> <price> <qty>          amend     -> "OK <id>"
+//   anything else                           -> "REJ <reason>"
+//
+// The runtime behind it is single-threaded and built on epoll: reads and
+// writes are awaitables that try the syscall first and suspend only on
+// EAGAIN, coroutine frames come from a size-class pool, and no await
+// allocates. A full command queue suspends the session until the next poll.
+// The implementation is C++20; this interface stays C++17.
+class SessionGateway {
+public:
+    SessionGateway();
+    ~SessionGateway();
+    SessionGateway(const SessionGateway&) = delete;
+    SessionGateway& operator=(const SessionGateway&) = delete;
+
+    // Listen on loopback (port 0 picks a free one, see port())
+    bool open(uint16_t port, Fifo3<BookCommand>& commands);
+    void close();
+    uint16_t port() const;
+
+    // Run ready sessions and wait up to timeout_ms for socket events;
+    // returns the number of sessions resumed
+    size_t poll(int timeout_ms = 0);
+
+    GatewayStats stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
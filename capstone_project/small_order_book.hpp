@@ -0,0 +1,370 @@
+#pragma once
+#include "order_book.hpp"
+#include "decimal.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Compact order book for thin instruments (options chains and the like).
+// Levels and orders live in small inline arrays kept sorted by priority, so a
+// book is one flat object with no heap allocation. When an add would exceed
+// either capacity the book spills into a full OrderBook and forwards to it.
+// The interface mirrors OrderBook so the representation can be chosen per
+// instrument.
+template<size_t MaxLevels = 4, size_t MaxOrders = 16>
+class SmallOrderBook {
+public:
+    void add_order(const Order& o) {
+        if (full_) {
+            full_->add_order(o);
+            return;
+        }
+        if (o.order_id & QUOTE_ORDER_ID_FLAG) {
+            std::cerr << "Error: Order ID " << o.order_id << " is reserved for quotes\n";
+            return;
+        }
+        if (!validate(o.order_id, o.price, o.quantity)) {
+            return;
+        }
+        if (find(o.order_id)) {
+            std::cerr << "Error: Duplicate order ID: " << o.order_id << "\n";
+            return;
+        }
+
+        Side& side = o.is_buy ? bids_ : asks_;
+        bool new_level = find_level(side, o.price) == side.level_count;
+        if (total_orders() == MaxOrders || (new_level && side.level_count == MaxLevels)) {
+            spill();
+            full_->add_order(o);
+            return;
+        }
+
+        insert(side, Slot{o.order_id, o.price, o.quantity, o.timestamp_ns}, o.is_buy);
+        latest_timestamp_ns_ = std::max(latest_timestamp_ns_, o.timestamp_ns);
+        version_++;
+        match_orders();
+    }
+
+    bool cancel_order(uint64_t id) {
+        if (full_) {
+            return full_->cancel_order(id);
+        }
+        if (id == 0) {
+            std::cerr << "Error: Invalid order ID (0)\n";
+            return false;
+        }
+
+        bool is_buy = false;
+        size_t index = 0;
+        if (!locate(id, is_buy, index)) {
+            std::cerr << "Error: Order not found: " << id << "\n";
+            return false;
+        }
+
+        erase(is_buy ? bids_ : asks_, index);
+        version_++;
+        return true;
+    }
+
+    bool amend_order(uint64_t order_id, double new_price, uint64_t new_quantity) {
+        if (full_) {
+            return full_->amend_order(order_id, new_price, new_quantity);
+        }
+        if (!validate(order_id, new_price, new_quantity)) {
+            return false;
+        }
+
+        bool is_buy = false;
+        size_t index = 0;
+        if (!locate(order_id, is_buy, index)) {
+            std::cerr << "Error: Order not found: " << order_id << "\n";
+            return false;
+        }
+
+        Side& side = is_buy ? bids_ : asks_;
+        Slot slot = side.orders[index];
+        if (slot.price != new_price) {
+            // Price change loses priority and may cross
+            bool new_level = find_level(side, new_price) == side.level_count;
+            size_t old_level = find_level(side, slot.price);
+            bool frees_level = side.level_order_count[old_level] == 1;
+            if (new_level && !frees_level && side.level_count == MaxLevels) {
+                spill();
+                return full_->amend_order(order_id, new_price, new_quantity);
+            }
+            erase(side, index);
+            slot.price = new_price;
+            slot.quantity = new_quantity;
+            slot.timestamp_ns = next_timestamp(slot.timestamp_ns);
+            insert(side, slot, is_buy);
+            version_++;
+            match_orders();
+            return true;
+        }
+
+        if (new_quantity > slot.quantity) {
+            // Increase loses priority: requeue behind the rest of the level
+            erase(side, index);
+            slot.quantity = new_quantity;
+            slot.timestamp_ns = next_timestamp(slot.timestamp_ns);
+            insert(side, slot, is_buy);
+        } else {
+            // Reduction keeps its queue position
+            PriceLevel& level = side.levels[find_level(side, slot.price)];
+            level.total_quantity = level.total_quantity - slot.quantity + new_quantity;
+            side.orders[index].quantity = new_quantity;
+        }
+
+        version_++;
+        return true;
+    }
+
+    void get_snapshot(size_t depth, std::vector<PriceLevel>& bids, std::vector<PriceLevel>& asks) const {
+        if (full_) {
+            full_->get_snapshot(depth, bids, asks);
+            return;
+        }
+        bids.assign(bids_.levels, bids_.levels + std::min<size_t>(depth, bids_.level_count));
+        asks.assign(asks_.levels, asks_.levels + std::min<size_t>(depth, asks_.level_count));
+    }
+
+    void print_book(size_t depth = 10) const {
+        if (full_) {
+            full_->print_book(depth);
+            return;
+        }
+        std::vector<PriceLevel> bids, asks;
+        get_snapshot(depth, bids, asks);
+
+        std::cout << "\n=== ORDER BOOK ===\n";
+        std::cout << "Bids (Buy)          | Asks (Sell)\n";
+        std::cout << "Price    | Quantity | Price    | Quantity\n";
+        std::cout << "---------|----------|----------|----------\n";
+        char line[BOOK_ROW_MAX];
+        for (size_t i = 0; i < std::max(bids.size(), asks.size()); ++i) {
+            size_t len = format_book_row(i < bids.size() ? &bids[i] : nullptr, i < asks.size() ? &asks[i] : nullptr, line);
+            std::cout.write(line, static_cast<std::streamsize>(len));
+        }
+
+        auto write_price = [](double price) {
+            char value[decimal::FORMAT_MAX];
+            size_t len = decimal::format(decimal::to_units(price, PRICE_DISPLAY_SCALE), PRICE_DISPLAY_SCALE, value);
+            std::cout.write(value, static_cast<std::streamsize>(len));
+        };
+        std::cout << "\nBest Bid: ";
+        write_price(get_best_bid());
+        std::cout << "\nBest Ask: ";
+        if (asks_.level_count) {
+            write_price(get_best_ask());
+        } else {
+            std::cout << "none";
+        }
+        std::cout << "\nSpread: ";
+        write_price(get_spread());
+        std::cout << "\n";
+    }
+
+    double get_best_bid() const {
+        if (full_) return full_->get_best_bid();
+        return bids_.level_count ? bids_.levels[0].price : 0.0;
+    }
+
+    double get_best_ask() const {
+        if (full_) return full_->get_best_ask();
+        return asks_.level_count ? asks_.levels[0].price : std::numeric_limits<double>::max();
+    }
+
+    double get_spread() const {
+        double best_ask_price = get_best_ask();
+        return best_ask_price == std::numeric_limits<double>::max() ? 0.0 : best_ask_price - get_best_bid();
+    }
+
+    uint64_t get_version() const {
+        return full_ ? version_ + (full_->get_version() - spill_version_) : version_;
+    }
+
+    size_t get_order_count() const { return full_ ? full_->get_order_count() : total_orders(); }
+    size_t get_bid_levels() const { return full_ ? full_->get_bid_levels() : bids_.level_count; }
+    size_t get_ask_levels() const { return full_ ? full_->get_ask_levels() : asks_.level_count; }
+
+    // True once the book has outgrown its inline capacity
+    bool is_spilled() const { return full_ != nullptr; }
+
+    // Same checks as OrderBook::set_instrument, forwarded after a spill
+    bool set_instrument(const InstrumentParams& params) {
+        if (full_) {
+            return full_->set_instrument(params);
+        }
+        if (!valid_instrument_params(params)) {
+            return false;
+        }
+        instrument_ = params;
+        return true;
+    }
+    const InstrumentParams& get_instrument() const { return full_ ? full_->get_instrument() : instrument_; }
+
+private:
+    struct Slot {
+        uint64_t order_id;
+        double price;
+        uint64_t quantity;
+        uint64_t timestamp_ns;
+    };
+
+    // Orders sorted by (price priority, arrival); levels sorted best-first
+    struct Side {
+        PriceLevel levels[MaxLevels];
+        uint32_t level_order_count[MaxLevels];
+        Slot orders[MaxOrders];
+        uint8_t level_count{0};
+        uint8_t order_count{0};
+    };
+
+    static_assert(MaxLevels <= 255 && MaxOrders <= 255, "counts are stored in uint8_t");
+
+    static bool better(double a, double b, bool is_buy) {
+        return is_buy ? a > b : a < b;
+    }
+
+    // The checks OrderBook applies, so an order is treated the same before
+    // and after spill()
+    bool validate(uint64_t id, double price, uint64_t quantity) const {
+        if (id == 0) {
+            std::cerr << "Error: Invalid order ID (0)\n";
+            return false;
+        }
+        return valid_order_price(instrument_, price) && valid_order_quantity(instrument_, quantity);
+    }
+
+    // Same requeue stamping as OrderBook: the order becomes the newest
+    uint64_t next_timestamp(uint64_t timestamp_ns) {
+        latest_timestamp_ns_ = std::max(latest_timestamp_ns_ + 1, timestamp_ns);
+        return latest_timestamp_ns_;
+    }
+
+    size_t total_orders() const { return bids_.order_count + asks_.order_count; }
+
+    static size_t find_level(const Side& side, double price) {
+        for (size_t i = 0; i < side.level_count; ++i) {
+            if (side.levels[i].price == price) return i;
+        }
+        return side.level_count;
+    }
+
+    bool locate(uint64_t id, bool& is_buy, size_t& index) const {
+        for (size_t i = 0; i < bids_.order_count; ++i) {
+            if (bids_.orders[i].order_id == id) { is_buy = true; index = i; return true; }
+        }
+        for (size_t i = 0; i < asks_.order_count; ++i) {
+            if (asks_.orders[i].order_id == id) { is_buy = false; index = i; return true; }
+        }
+        return false;
+    }
+
+    bool find(uint64_t id) const {
+        bool is_buy;
+        size_t index;
+        return locate(id, is_buy, index);
+    }
+
+    // Sorted insert behind every order of equal or better price (FIFO)
+    static void insert(Side& side, const Slot& slot, bool is_buy) {
+        size_t pos = side.order_count;
+        while (pos > 0 && better(slot.price, side.orders[pos - 1].price, is_buy)) {
+            side.orders[pos] = side.orders[pos - 1];
+            --pos;
+        }
+        side.orders[pos] = slot;
+        side.order_count++;
+
+        size_t level = 0;
+        while (level < side.level_count && better(side.levels[level].price, slot.price, is_buy)) {
+            ++level;
+        }
+        if (level == side.level_count || side.levels[level].price != slot.price) {
+            for (size_t i = side.level_count; i > level; --i) {
+                side.levels[i] = side.levels[i - 1];
+                side.level_order_count[i] = side.level_order_count[i - 1];
+            }
+            side.levels[level] = PriceLevel(slot.price, 0);
+            side.level_order_count[level] = 0;
+            side.level_count++;
+        }
+        side.levels[level].total_quantity += slot.quantity;
+        side.level_order_count[level]++;
+    }
+
+    static void erase(Side& side, size_t index) {
+        const Slot slot = side.orders[index];
+        for (size_t i = index + 1; i < side.order_count; ++i) {
+            side.orders[i - 1] = side.orders[i];
+        }
+        side.order_count--;
+
+        size_t level = find_level(side, slot.price);
+        side.levels[level].total_quantity -= slot.quantity;
+        if (--side.level_order_count[level] == 0) {
+            for (size_t i = level + 1; i < side.level_count; ++i) {
+                side.levels[i - 1] = side.levels[i];
+                side.level_order_count[i - 1] = side.level_order_count[i];
+            }
+            side.level_count--;
+        }
+    }
+
+    void match_orders() {
+        while (bids_.order_count && asks_.order_count && bids_.orders[0].price >= asks_.orders[0].price) {
+            Slot& bid = bids_.orders[0];
+            Slot& ask = asks_.orders[0];
+            uint64_t match_quantity = std::min(bid.quantity, ask.quantity);
+            double match_price = (bid.timestamp_ns <= ask.timestamp_ns) ? bid.price : ask.price;
+
+            char line[MATCH_LINE_MAX];
+            size_t len = format_match_line(match_quantity, match_price, bid.order_id, ask.order_id, line);
+            std::cout.write(line, static_cast<std::streamsize>(len));
+
+            fill(bids_, match_quantity);
+            fill(asks_, match_quantity);
+        }
+    }
+
+    static void fill(Side& side, uint64_t quantity) {
+        Slot& front = side.orders[0];
+        if (front.quantity == quantity) {
+            erase(side, 0);
+        } else {
+            front.quantity -= quantity;
+            side.levels[0].total_quantity -= quantity;
+        }
+    }
+
+    // Move every resting order into a full OrderBook, preserving FIFO
+    void spill() {
+        full_ = std::make_unique<OrderBook>();
+        for (const Side* side : {&bids_, &asks_}) {
+            bool is_buy = side == &bids_;
+            for (size_t i = 0; i < side->order_count; ++i) {
+                const Slot& s = side->orders[i];
+                full_->add_order({s.order_id, is_buy, s.price, s.quantity, s.timestamp_ns});
+            }
+        }
+        // Resting orders are kept even if the instrument changed since they
+        // were accepted, as in OrderBook
+        full_->set_instrument(instrument_);
+        bids_ = Side{};
+        asks_ = Side{};
+        spill_version_ = full_->get_version();
+    }
+
+    Side bids_;
+    Side asks_;
+    uint64_t version_{0};
+    uint64_t spill_version_{0};
+    uint64_t latest_timestamp_ns_{0};
+    InstrumentParams instrument_;
+    std::unique_ptr<OrderBook> full_;
+};
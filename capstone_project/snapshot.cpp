@@ -0,0 +1,333 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+constexpr uint32_t SNAPSHOT_FILE_MAGIC = 0x3146424F; // "OBF1"
+
+struct SnapshotFileHeader {
+    uint32_t magic;
+    uint32_t book_count;
+    uint64_t sequence;
+};
+
+static uint64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long minor_faults() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Write the snapshot to `tmp_path` and rename it over `path`. Neither
+// allocates nor logs as long as `buffer` has room for the largest book, so a
+// forked child can run this safely.
+static bool write_snapshot_raw(const char* tmp_path, const char* path, const std::vector<const OrderBook*>& books,
+                               uint64_t sequence, std::vector<char>& buffer) {
+    int fd = ::open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    SnapshotFileHeader header{SNAPSHOT_FILE_MAGIC, static_cast<uint32_t>(books.size()), sequence};
+    bool ok = write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (const OrderBook* book : books) {
+        if (!ok) break;
+        book->save_snapshot(buffer);
+        uint64_t size = buffer.size();
+        ok = write_all(fd, reinterpret_cast<const char*>(&size), sizeof(size)) &&
+             write_all(fd, buffer.data(), buffer.size());
+    }
+
+    ok = ok && ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (ok) {
+        ok = std::rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        ::unlink(tmp_path);
+    }
+    return ok;
+}
+
+bool write_snapshot_file(const std::string& path, const std::vector<const OrderBook*>& books, uint64_t sequence) {
+    std::string tmp_path = path + ".tmp";
+    std::vector<char> buffer;
+    if (!write_snapshot_raw(tmp_path.c_str(), path.c_str(), books, sequence, buffer)) {
+        std::cerr << "Error: Failed to write snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Read a snapshot file and locate each book's image in it
+static bool index_snapshot_file(const std::string& path, std::vector<char>& data,
+                                std::vector<std::pair<size_t, size_t>>& images, uint64_t& sequence) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st{};
+    bool ok = ::fstat(fd, &st) == 0;
+    if (ok) {
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (ok && done < data.size()) {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            done += ok ? static_cast<size_t>(n) : 0;
+        }
+    }
+    ::close(fd);
+
+    SnapshotFileHeader header;
+    if (!ok || data.size() < sizeof(header)) {
+        std::cerr << "Error: Failed to read snapshot file " << path << "\n";
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != SNAPSHOT_FILE_MAGIC) {
+        std::cerr << "Error: Invalid snapshot file " << path << "\n";
+        return false;
+    }
+
+    images.clear();
+    images.reserve(header.book_count);
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.book_count; ++i) {
+        uint64_t size = 0;
+        if (offset + sizeof(size) > data.size()) {
+            std::cerr << "Error: Snapshot file truncated\n";
+            return false;
+        }
+        std::memcpy(&size, data.data() + offset, sizeof(size));
+        offset += sizeof(size);
+        if (offset + size > data.size()) {
+            std::cerr << "Error: Snapshot file truncated\n";
+            return false;
+        }
+        images.emplace_back(offset, static_cast<size_t>(size));
+        offset += size;
+    }
+
+    sequence = header.sequence;
+    return true;
+}
+
+bool read_snapshot_file(const std::string& path, std::vector<std::unique_ptr<OrderBook>>& books, uint64_t& sequence) {
+    std::vector<char> data;
+    std::vector<std::pair<size_t, size_t>> images;
+    uint64_t file_sequence = 0;
+    if (!index_snapshot_file(path, data, images, file_sequence)) {
+        return false;
+    }
+
+    books.clear();
+    for (const auto& image : images) {
+        auto book = std::make_unique<OrderBook>();
+        if (!book->load_snapshot(data.data() + image.first, image.second)) {
+            return false;
+        }
+        books.push_back(std::move(book));
+    }
+
+    sequence = file_sequence;
+    return true;
+}
+
+static bool pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool read_snapshot_file_parallel(const std::string& path, std::vector<std::unique_ptr<OrderBook>>& books,
+                                 uint64_t& sequence, size_t threads, const std::vector<int>& book_cpus) {
+    std::vector<char> data;
+    std::vector<std::pair<size_t, size_t>> images;
+    uint64_t file_sequence = 0;
+    if (!index_snapshot_file(path, data, images, file_sequence)) {
+        return false;
+    }
+    if (!book_cpus.empty() && book_cpus.size() != images.size()) {
+        std::cerr << "Error: " << book_cpus.size() << " CPU assignments for " << images.size() << " books\n";
+        return false;
+    }
+
+    std::vector<std::unique_ptr<OrderBook>> loaded(images.size());
+    std::atomic<bool> failed{false};
+    auto build = [&](size_t i) {
+        auto book = std::make_unique<OrderBook>();
+        if (book->load_snapshot(data.data() + images[i].first, images[i].second)) {
+            loaded[i] = std::move(book);
+        } else {
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<size_t> cursor{0};
+    std::map<int, std::vector<size_t>> by_cpu;
+    std::vector<std::thread> workers;
+    if (book_cpus.empty()) {
+        // Unplaced: workers take books in small chunks from a shared cursor
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const size_t chunk = 16;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&]() {
+                for (size_t begin; (begin = cursor.fetch_add(chunk)) < images.size();) {
+                    for (size_t i = begin; i < std::min(begin + chunk, images.size()); ++i) {
+                        build(i);
+                    }
+                }
+            });
+        }
+    } else {
+        // Placed: one worker per matching CPU builds that CPU's books on it,
+        // so first-touch puts their pools on the CPU's NUMA node
+        for (size_t i = 0; i < book_cpus.size(); ++i) {
+            by_cpu[book_cpus[i]].push_back(i);
+        }
+        for (const auto& entry : by_cpu) {
+            int cpu = entry.first;
+            const std::vector<size_t>& indices = entry.second;
+            workers.emplace_back([&, cpu]() {
+                if (cpu >= 0 && !pin_to_cpu(cpu)) {
+                    std::cerr << "Warning: Cannot pin snapshot loader to CPU " << cpu << "\n";
+                }
+                for (size_t i : indices) {
+                    build(i);
+                }
+            });
+        }
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (failed.load()) {
+        std::cerr << "Error: Failed to rebuild books from " << path << "\n";
+        return false;
+    }
+    books = std::move(loaded);
+    sequence = file_sequence;
+    return true;
+}
+
+ForkSnapshotter::~ForkSnapshotter() {
+    if (in_progress()) {
+        wait();
+    }
+}
+
+bool ForkSnapshotter::start(const std::vector<const OrderBook*>& books, const std::string& path, uint64_t sequence) {
+    if (in_progress()) {
+        std::cerr << "Error: Snapshot already in progress\n";
+        return false;
+    }
+
+    // Everything the child needs is allocated here: after fork() only the
+    // calling thread exists, and a lock held by another thread at that
+    // moment (malloc, iostreams) would never be released in the child
+    size_t largest = 0;
+    for (const OrderBook* book : books) {
+        largest = std::max(largest, book->snapshot_size());
+    }
+    buffer_.clear();
+    buffer_.reserve(largest);
+    path_ = path;
+    tmp_path_ = path + ".tmp";
+
+    stats_ = ForkSnapshotStats{};
+    stats_.sequence = sequence;
+    start_minor_faults_ = minor_faults();
+    start_ns_ = monotonic_ns();
+
+    std::cout.flush();
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        std::cerr << "Error: fork failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    if (pid == 0) {
+        // Child: the books are a frozen COW image of the parent at `sequence`
+        bool ok = write_snapshot_raw(tmp_path_.c_str(), path_.c_str(), books, sequence, buffer_);
+        ::_exit(ok ? 0 : 1);
+    }
+
+    stats_.pause_us = (monotonic_ns() - start_ns_) / 1000.0;
+    child_ = pid;
+    return true;
+}
+
+bool ForkSnapshotter::poll() {
+    if (!in_progress()) {
+        return true;
+    }
+    int status = 0;
+    pid_t r = ::waitpid(child_, &status, WNOHANG);
+    if (r == child_) {
+        finish(status);
+        return true;
+    }
+    return false;
+}
+
+bool ForkSnapshotter::wait() {
+    if (!in_progress()) {
+        return stats_.success;
+    }
+    int status = 0;
+    pid_t r;
+    do {
+        r = ::waitpid(child_, &status, 0);
+    } while (r < 0 && errno == EINTR);
+    finish(r == child_ ? status : -1);
+    return stats_.success;
+}
+
+void ForkSnapshotter::finish(int status) {
+    stats_.child_duration_ms = (monotonic_ns() - start_ns_) / 1e6;
+    stats_.parent_minor_faults = minor_faults() - start_minor_faults_;
+    stats_.success = status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    child_ = -1;
+    if (!stats_.success) {
+        std::cerr << "Error: Snapshot child failed to write " << path_ << "\n";
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "order_book.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sys/types.h>
+
+// Multi-book snapshot file: a small header tagged with the engine sequence
+// number, followed by each book's binary snapshot (OrderBook::save_snapshot).
+bool write_snapshot_file(const std::string& path, const std::vector<const OrderBook*>& books, uint64_t sequence);
+bool read_snapshot_file(const std::string& path, std::vector<std::unique_ptr<OrderBook>>& books, uint64_t& sequence);
+
+// Startup variant that rebuilds the books on worker threads. With book_cpus
+// (one entry per book: the CPU of its future matching thread, -1 = any) each
+// CPU gets a worker pinned to it, so a book's memory is first touched on the
+// NUMA node that will use it; `threads` is then unused. Without it, `threads`
+// unpinned workers (0 = one per core) share the books. The result has the
+// same order as the file and is handed over only if every book loaded.
+bool read_snapshot_file_parallel(const std::string& path, std::vector<std::unique_ptr<OrderBook>>& books,
+                                 uint64_t& sequence, size_t threads = 0, const std::vector<int>& book_cpus = {});
+
+struct ForkSnapshotStats {
+    uint64_t sequence{0};
+    double pause_us{0.0};          // Time the parent spent inside fork()
+    double child_duration_ms{0.0}; // Fork to child exit, as observed by the parent
+    long parent_minor_faults{0};   // Parent page faults while the child was alive (COW copies)
+    bool success{false};
+};
+
+// Copy-on-write snapshots: fork() at a sequence boundary and let the child
+// serialize every book while the parent keeps matching on its own pages.
+class ForkSnapshotter {
+public:
+    ForkSnapshotter() = default;
+    ~ForkSnapshotter();
+    ForkSnapshotter(const ForkSnapshotter&) = delete;
+    ForkSnapshotter& operator=(const ForkSnapshotter&) = delete;
+
+    // Start a snapshot; returns false if one is already running or fork fails.
+    // The child only serializes into a buffer sized here and calls write(),
+    // so other threads may be running when this is called.
+    bool start(const std::vector<const OrderBook*>& books, const std::string& path, uint64_t sequence);
+
+    // Non-blocking check; returns true once the child has been reaped
+    bool poll();
+
+    // Block until the running snapshot completes
+    bool wait();
+
+    bool in_progress() const { return child_ > 0; }
+    const ForkSnapshotStats& stats() const { return stats_; }
+
+private:
+    void finish(int status);
+
+    pid_t child_{-1};
+    std::string path_;
+    std::string tmp_path_;
+    std::vector<char> buffer_;  // reserved in the parent, filled by the child
+    uint64_t start_ns_{0};
+    long start_minor_faults_{0};
+    ForkSnapshotStats stats_;
+};
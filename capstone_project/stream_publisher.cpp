@@ -0,0 +1,280 @@
+#include "stream_publisher.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+constexpr size_t MAX_IOV = IOV_MAX < 1024 ? IOV_MAX : 1024;
+constexpr int COMPLETION_POLL_MS = 100;
+constexpr int CLOSE_COMPLETION_POLLS = 20;   // close() gives up on completions after ~2 s
+
+StreamPublisher::~StreamPublisher() {
+    close();
+}
+
+bool StreamPublisher::open(uint16_t port, const StreamPublisherConfig& config) {
+    if (fd_ >= 0) {
+        std::cerr << "Error: Stream publisher already open\n";
+        return false;
+    }
+    if (config.slots == 0 || (config.slots & (config.slots - 1)) != 0 || config.slot_size == 0 ||
+        config.slot_size > UINT32_MAX) {
+        std::cerr << "Error: Stream publisher needs a power-of-two slot count\n";
+        return false;
+    }
+
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        std::cerr << "Error: Cannot create TCP socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: Cannot connect to port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    config_ = config;
+    zerocopy_ = false;
+    if (config.mode == SendMode::ZeroCopy) {
+        zerocopy_ = setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        if (!zerocopy_) {
+            std::cerr << "Warning: SO_ZEROCOPY unavailable (" << std::strerror(errno) << "), sending by copy\n";
+        }
+    }
+
+    ring_ = std::make_unique<char[]>(config.slots * config.slot_size);
+    lengths_.assign(config.slots, 0);
+    mask_ = config.slots - 1;
+    released_ = sent_ = tail_ = 0;
+    sent_offset_ = 0;
+    pending_.clear();
+    next_zerocopy_id_ = 0;
+    stats_ = StreamPublisherStats();
+    return true;
+}
+
+void StreamPublisher::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    flush();
+    // A peer that stopped reading holds completions back indefinitely
+    for (int polls = 0; !pending_.empty() && polls < CLOSE_COMPLETION_POLLS; ++polls) {
+        reap_completions(true);
+    }
+    if (!pending_.empty()) {
+        std::cerr << "Warning: Closing with " << pending_.size() << " zerocopy sends unacknowledged\n";
+        pending_.clear();
+    }
+    ::close(fd_);
+    fd_ = -1;
+    released_ = sent_ = tail_;
+    ring_.reset();
+    lengths_ = std::vector<uint32_t>();
+}
+
+char* StreamPublisher::claim(uint32_t size) {
+    if (fd_ < 0 || size > config_.slot_size) {
+        std::cerr << "Error: Cannot queue a " << size << "-byte message\n";
+        return nullptr;
+    }
+    if (tail_ - released_ == config_.slots) {
+        if (!send_pending()) {
+            return nullptr;
+        }
+        reap_completions(false);
+        while (tail_ - released_ == config_.slots) {
+            stats_.completion_waits++;
+            reap_completions(true);
+        }
+    }
+    return slot(tail_);
+}
+
+void StreamPublisher::commit(uint32_t size) {
+    lengths_[tail_ & mask_] = size;
+    tail_++;
+    stats_.messages++;
+    stats_.bytes += size;
+}
+
+bool StreamPublisher::publish(const void* data, uint32_t size) {
+    char* dest = claim(size);
+    if (!dest) {
+        return false;
+    }
+    std::memcpy(dest, data, size);
+    commit(size);
+    return true;
+}
+
+bool StreamPublisher::flush() {
+    if (fd_ < 0) {
+        return false;
+    }
+    bool ok = send_pending();
+    if (zerocopy_) {
+        reap_completions(false);
+    }
+    return ok;
+}
+
+bool StreamPublisher::send_pending() {
+    if (config_.mode == SendMode::PerMessage) {
+        while (sent_ < tail_) {
+            uint32_t length = lengths_[sent_ & mask_];
+            ssize_t n = ::send(fd_, slot(sent_) + sent_offset_, length - sent_offset_, MSG_NOSIGNAL);
+            stats_.syscalls++;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Error: send failed: " << std::strerror(errno) << "\n";
+                return false;
+            }
+            sent_offset_ += static_cast<uint32_t>(n);
+            if (sent_offset_ == length) {
+                sent_++;
+                sent_offset_ = 0;
+            }
+        }
+        released_ = sent_;
+        return true;
+    }
+
+    iovec iov[MAX_IOV];
+    while (sent_ < tail_) {
+        size_t count = 0;
+        size_t bytes = 0;
+        for (uint64_t pos = sent_; pos < tail_ && count < MAX_IOV; ++pos, ++count) {
+            uint32_t skip = pos == sent_ ? sent_offset_ : 0;
+            iov[count].iov_base = slot(pos) + skip;
+            iov[count].iov_len = lengths_[pos & mask_] - skip;
+            bytes += iov[count].iov_len;
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        bool zerocopy = zerocopy_ && bytes >= config_.zerocopy_threshold;
+        ssize_t n = sendmsg(fd_, &msg, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+        stats_.syscalls++;
+        if (n < 0 && zerocopy && errno == ENOBUFS) {
+            // Out of pinned-page budget: this burst goes by copy
+            n = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            stats_.syscalls++;
+            zerocopy = false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: sendmsg failed: " << std::strerror(errno) << "\n";
+            return false;
+        }
+
+        // Advance over fully sent slots; a partly sent one stays at sent_
+        size_t remaining = static_cast<size_t>(n);
+        while (remaining > 0) {
+            uint32_t left = lengths_[sent_ & mask_] - sent_offset_;
+            if (remaining < left) {
+                sent_offset_ += static_cast<uint32_t>(remaining);
+                break;
+            }
+            remaining -= left;
+            sent_++;
+            sent_offset_ = 0;
+        }
+
+        if (zerocopy) {
+            stats_.zerocopy_sends++;
+            pending_.push_back({next_zerocopy_id_++, sent_});
+        } else if (pending_.empty()) {
+            released_ = sent_;
+        } else {
+            // Copied data is free at once, but slots before it wait for
+            // earlier zerocopy sends; release in order
+            pending_.push_back({UINT32_MAX, sent_});
+        }
+    }
+    return true;
+}
+
+void StreamPublisher::reap_completions(bool wait) {
+    while (!pending_.empty()) {
+        // Copied sends queued behind zerocopy ones need no notification
+        while (!pending_.empty() && pending_.front().id == UINT32_MAX) {
+            released_ = pending_.front().release_to;
+            pending_.pop_front();
+        }
+        if (pending_.empty()) {
+            return;
+        }
+
+        char control[256];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (!wait || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return;
+            }
+            pollfd pfd{fd_, 0, 0};   // the error queue signals POLLERR
+            ::poll(&pfd, 1, COMPLETION_POLL_MS);
+            return;   // one bounded wait; callers that must block call again
+        }
+
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            sock_extended_err err;
+            std::memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) {
+                continue;
+            }
+            // Notifications cover the id range [ee_info, ee_data] and arrive in order
+            uint32_t count = err.ee_data - err.ee_info + 1;
+            stats_.zerocopy_completions += count;
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                stats_.zerocopy_copied += count;
+            }
+            while (!pending_.empty() && (pending_.front().id == UINT32_MAX ||
+                                         static_cast<int32_t>(pending_.front().id - err.ee_data) <= 0)) {
+                released_ = pending_.front().release_to;
+                pending_.pop_front();
+            }
+        }
+        if (!wait) {
+            continue;   // drain whatever else is queued without blocking
+        }
+        return;
+    }
+}
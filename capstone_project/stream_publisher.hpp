@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+enum class SendMode {
+    PerMessage, // one send() per message, the naive baseline
+    Gather,     // queued messages go out in one sendmsg() of iovecs over the ring
+    ZeroCopy    // Gather, with MSG_ZEROCOPY for flushes of zerocopy_threshold bytes or more
+};
+
+struct StreamPublisherConfig {
+    SendMode mode = SendMode::Gather;
+    size_t slot_size = 256;             // largest message
+    size_t slots = 4096;                // ring capacity in messages
+    size_t zerocopy_threshold = 32768;  // smaller flushes are copied; pinning pages costs more
+};
+
+struct StreamPublisherStats {
+    uint64_t messages{0};
+    uint64_t bytes{0};
+    uint64_t syscalls{0};               // send/sendmsg calls
+    uint64_t zerocopy_sends{0};
+    uint64_t zerocopy_completions{0};
+    uint64_t zerocopy_copied{0};        // completions where the kernel copied anyway (e.g. loopback)
+    uint64_t completion_waits{0};       // times the ring was full of unacknowledged zerocopy data
+};
+
+// TCP market data publisher with an outbound ring of fixed-size message
+// slots. Messages are written into their slot in place (claim/commit) and
+// flush() hands the kernel iovecs that point straight into the ring, so a
+// burst of messages costs one syscall and no gather copy.
+//
+// In ZeroCopy mode large flushes use MSG_ZEROCOPY: the kernel reads the
+// ring's pages directly, and slots stay reserved until their completion
+// arrives on the socket error queue. If the socket refuses SO_ZEROCOPY the
+// publisher falls back to Gather.
+class StreamPublisher {
+public:
+    StreamPublisher() = default;
+    ~StreamPublisher();
+    StreamPublisher(const StreamPublisher&) = delete;
+    StreamPublisher& operator=(const StreamPublisher&) = delete;
+
+    // Connect to a subscriber on loopback
+    bool open(uint16_t port, const StreamPublisherConfig& config = StreamPublisherConfig());
+    // Flush, wait up to ~2 s for outstanding zerocopy completions, then
+    // disconnect and free the ring
+    void close();
+
+    // Reserve the next slot for a message of up to `size` bytes, flushing
+    // (and waiting for completions) when the ring is full; null on error
+    char* claim(uint32_t size);
+    void commit(uint32_t size);
+
+    bool publish(const void* data, uint32_t size);
+    bool flush();
+
+    bool zerocopy_active() const { return zerocopy_; }
+    const StreamPublisherStats& stats() const { return stats_; }
+
+private:
+    bool send_pending();
+    void reap_completions(bool wait);
+    char* slot(uint64_t position) { return ring_.get() + (position & mask_) * config_.slot_size; }
+
+    int fd_{-1};
+    StreamPublisherConfig config_;
+    bool zerocopy_{false};
+    std::unique_ptr<char[]> ring_;
+    std::vector<uint32_t> lengths_;
+    uint64_t mask_{0};
+
+    // released <= sent <= tail; [released, sent) is still referenced by
+    // zerocopy sends, [sent, tail) is queued
+    uint64_t released_{0};
+    uint64_t sent_{0};
+    uint32_t sent_offset_{0};    // bytes of slot `sent_` already sent
+    uint64_t tail_{0};
+
+    // Ring position released by each zerocopy send once it completes
+    struct PendingSend {
+        uint32_t id;
+        uint64_t release_to;
+    };
+    std::deque<PendingSend> pending_;
+    uint32_t next_zerocopy_id_{0};
+
+    StreamPublisherStats stats_;
+};